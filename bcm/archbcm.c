@@ -70,12 +70,6 @@ wdogoff(void)
 	r = (u32int*)POWERREGS;
 	r[Rstc] = Password | (r[Rstc] & ~CfgMask);
 }
-	
-void
-cpuidprint(void)
-{
-	print("cpu%d: %dMHz ARM1176JZF-S\n", m->machno, m->cpumhz);
-}
 
 void
 archbcmlink(void)
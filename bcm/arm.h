@@ -12,6 +12,7 @@
 #define PsrMsvc		0x00000013	/* `protected mode for OS' */
 #define PsrMmon		0x00000016	/* `secure monitor' (trustzone hyper) */
 #define PsrMabt		0x00000017
+#define PsrMhyp		0x0000001A	/* hypervisor (armv7 virtualisation) */
 #define PsrMund		0x0000001B
 #define PsrMsys		0x0000001F	/* `privileged user mode for OS' (trustzone) */
 #define PsrMask		0x0000001F
@@ -52,6 +53,7 @@
 #define CpTLD		10			/* TLB Lockdown, with op2 */
 #define CpVECS		12			/* vector bases, op1==0, Crm==0, op2s (cortex) */
 #define	CpPID		13			/* Process ID */
+#define CpTIMER		14			/* generic timer (cortex) */
 #define CpSPM		15			/* system performance monitor (arm1176) */
 
 /*
@@ -110,6 +112,7 @@
 #define CpCha		(1<<17)		/* HA: hw access flag enable */
 #define CpCdz		(1<<19)		/* DZ: divide by zero fault enable */
 #define CpCfi		(1<<21)		/* FI: fast intrs */
+#define CpCxp		(1<<23)		/* XP: armv6 extended page tables */
 #define CpCve		(1<<24)		/* VE: intr vectors enable */
 #define CpCee		(1<<25)		/* EE: exception endianness */
 #define CpCnmfi		(1<<27)		/* NMFI: non-maskable fast intrs. */
@@ -129,6 +132,7 @@
 #define CpACissue1		(1<<10)	/* force single issue */
 #define CpACnobsm		(1<<7)	/* no branch size mispredicts */
 #define CpACibe			(1<<6)	/* cp15 invalidate & btb enable */
+#define CpACsmp			(1<<6)	/* SMP: coherent with other cpus (cortex-a7) */
 #define CpACl1neon		(1<<5)	/* cache neon (FP) data in L1 cache */
 #define CpACasa			(1<<4)	/* enable speculative accesses */
 #define CpACl1pe		(1<<3)	/* l1 cache parity enable */
@@ -175,6 +179,8 @@
 #define CpTLBinvse	1			/* invalidate single entry */
 #define CpTBLasid	2			/* by ASID (cortex) */
 
+#define CpTLBinvuis	3			/* unified, inner sharable (v7 mp) */
+
 /*
  * CpCLD Secondary (CRm) registers and opcode2 fields for op1==0. (cortex)
  */
@@ -222,6 +228,23 @@
 #define CpVECSnorm	0			/* (non-)secure base addr */
 #define CpVECSmon	1			/* secure monitor base addr */
 
+/*
+ * CpPID Secondary (CRm) registers and opcode2 fields, CRm==0.
+ */
+#define CpPIDtidprw	4			/* privileged thread id (v6k) */
+
+/*
+ * CpTIMER Secondary (CRm) registers and opcode2 fields, op1==0.
+ */
+#define CpTIMERfreq	0			/* CRm 0: frequency (op2 0) */
+#define CpTIMERvirt	3			/* CRm 3: virtual timer */
+
+#define CpTIMERval	0			/* timer value, counts down */
+#define CpTIMERctl	1			/* control */
+
+#define CpTIMERenable	(1<<0)
+#define CpTIMERmask	(1<<1)
+
 /*
  * CpSPM Secondary (CRm) registers and opcode2 fields.
  */
@@ -254,6 +277,10 @@
 #define Tiny		0x00000003		/* L2 1KB: not in v7 */
 #define Buffered	0x00000004		/* L[12]: write-back not -thru */
 #define Cached		0x00000008		/* L[12] */
+#define L1wralloc	(1<<12)			/* L1 TEX: write-allocate */
+#define L1sharable	(1<<16)			/* L1: coherent between cpus */
+#define L2wralloc	(1<<6)			/* L2 TEX */
+#define L2sharable	(1<<10)			/* L2 */
 #define Dom0		0
 
 #define Noaccess	0			/* AP, DAC */
@@ -267,7 +294,7 @@
 #define F(v, o, w)	(((v) & ((1<<(w))-1))<<(o))
 #define AP(n, v)	F((v), ((n)*2)+4, 2)
 #define L1AP(ap)	(AP(3, (ap)))
-#define L2AP(ap) (AP(3, (ap))|AP(2, (ap))|AP(1, (ap))|AP(0, (ap))) /* pre-armv7 */
+#define L2AP(ap)	(AP(0, (ap)))		/* armv7, or armv6 with CpCxp */
 #define DAC(n, v)	F((v), (n)*2, 2)
 
 #define HVECTORS	0xffff0000
@@ -1,5 +1,5 @@
 /*
- * armv6 machine assist, definitions
+ * armv6 and armv7 machine assist, definitions
  *
  * loader uses R11 as scratch.
  */
@@ -27,6 +27,28 @@
 
 #define	BARRIERS	ISB; DSB
 
+/* armv6k and later */
+#define LDREX(fp,t)   WORD $(0xe<<28|0x01900f9f | (fp)<<16 | (t)<<12)
+/* `The order of operands is from left to right in dataflow order' - asm man */
+#define STREX(f,tp,r) WORD $(0xe<<28|0x01800f90 | (tp)<<16 | (r)<<12 | (f)<<0)
+#define CLREX	WORD	$0xf57ff01f
+
+/* also works on armv7, where dmb is an instruction */
+#define DMB \
+	MOVW	$0, R0; \
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEwb), CpCACHEdmbarr
+
+/* return with cpu id in r and condition codes set from "r == 0" */
+#define CPUID(r) \
+	MRC	CpSC, 0, r, C(CpID), C(CpIDidct), CpIDmpid; \
+	AND.S	$(MAXMACH-1), r			/* mask out non-cpu-id bits */
+
+/* m is kept in the privileged thread id register of each cpu */
+#define GETMACH(r) \
+	MRC	CpSC, 0, r, C(CpPID), C(0), CpPIDtidprw
+#define SETMACH(r) \
+	MCR	CpSC, 0, r, C(CpPID), C(0), CpPIDtidprw
+
 #define MCRR(coproc, op, rd, rn, crm) \
 	WORD $(0xec400000|(rn)<<16|(rd)<<12|(coproc)<<8|(op)<<4|(crm))
 
@@ -0,0 +1,274 @@
+/*
+ * cortex-a7 (armv7) processors of the bcm2836:
+ * cache, tlb and start up peculiar to them.
+ * the cpus are coherent with each other once CpACsmp is set,
+ * and the tlb and icache ops here are broadcast to all of them.
+ */
+
+#include "arm.s"
+
+/* arm v7 arch defines these */
+#undef DSB
+#undef DMB
+#undef ISB
+#define DSB	WORD	$0xf57ff04f	/* data synch. barrier; last f = SY */
+#define DMB	WORD	$0xf57ff05f	/* data mem. barrier; last f = SY */
+#define ISB	WORD	$0xf57ff06f	/* instr. sync. barrier; last f = SY */
+
+#define WFI	WORD	$0xe320f003	/* wait for interrupt */
+#define SEV	WORD	$0xe320f004	/* send event */
+#define CLZ(s, d) WORD	$(0xe16f0f10 | (d) << 12 | (s))	/* count leading 0s */
+
+/* virtualisation extensions */
+#define ERET	WORD	$0xe160006e	/* return from hyp mode */
+#define MSR_ELRHYP(r) WORD $(0xe12ef300 | (r))	/* MSR ELR_hyp, r */
+
+/*
+ * SVC mode, interrupts disabled, mmu and L1 caches off,
+ * L1 caches and tlb invalidated, cycle counter on.
+ * newer firmware starts us in hyp mode.
+ * the mmu is off and there's no stack: the return pc is kept
+ * in R9 (up isn't set yet).
+ */
+TEXT armstart(SB), 1, $-4
+	MOVW	R14, R9
+	MOVW	CPSR, R1
+	AND	$PsrMask, R1
+	CMP	$PsrMhyp, R1
+	BNE	_armsvc(SB)
+
+	MOVW	$(PsrDirq|PsrDfiq|PsrMsvc), R1
+	MOVW	R1, SPSR
+	MOVW	$_armsvc(SB), R1
+	BIC	$KSEGM, R1			/* physical address */
+	MSR_ELRHYP(1)
+	ERET
+
+TEXT _armsvc(SB), 1, $-4
+	MOVW	$(PsrDirq|PsrDfiq|PsrMsvc), R1
+	MOVW	R1, CPSR
+
+	MRC	CpSC, 0, R1, C(CpCONTROL), C(0), CpMainctl
+	BIC	$(CpCdcache|CpCicache|CpCpredict|CpCmmu), R1
+	MCR	CpSC, 0, R1, C(CpCONTROL), C(0), CpMainctl
+	ISB
+
+	/*
+	 * join the other cpus' coherency domain before the caches are on
+	 */
+	MRC	CpSC, 0, R1, C(CpCONTROL), C(0), CpAuxctl
+	ORR	$CpACsmp, R1
+	MCR	CpSC, 0, R1, C(CpCONTROL), C(0), CpAuxctl
+	ISB
+
+	/*
+	 * only the L1 caches are this cpu's own; the L2 is shared
+	 * with any that are already running.
+	 */
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvi), CpCACHEall
+	MOVW	$0, R0				/* invalidate */
+	MOVW	$1, R8				/* L1 */
+	BL	wholecache(SB)
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpTLB), C(CpTLBinvu), CpTLBinv
+	DSB
+	ISB
+
+	MOVW	$(1<<2|1<<0), R1		/* reset and enable counters */
+	MCR	CpSC, 0, R1, C(CpCLD), C(CpCLDena), CpCLDenapmnc
+	MOVW	$(1<<31), R1			/* cycle counter */
+	MCR	CpSC, 0, R1, C(CpCLD), C(CpCLDena), CpCLDenacyc
+	MOVW	R9, R14
+	RET
+
+TEXT lcycles(SB), 1, $-4
+	MRC	CpSC, 0, R0, C(CpCLD), C(CpCLDcyc), 0
+	RET
+
+/*
+ * wait for interrupt
+ */
+TEXT wfi(SB), $-4
+	DSB
+	WFI
+	RET
+
+/*
+ * wake cpus waiting for an event
+ */
+TEXT sev(SB), $-4
+	DSB
+	SEV
+	RET
+
+/*
+ * invalidate tlb, on all cpus
+ */
+TEXT mmuinvalidate(SB), 1, $-4
+	DSB
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpTLB), C(CpTLBinvuis), CpTLBinv
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEisi), CpCACHEflushbtc
+	DSB
+	ISB
+	RET
+
+/*
+ * mmuinvalidateaddr(va)
+ *   invalidate tlb entry for virtual page address va, ASID 0, on all cpus
+ */
+TEXT mmuinvalidateaddr(SB), 1, $-4
+	DSB
+	MCR	CpSC, 0, R0, C(CpTLB), C(CpTLBinvuis), CpTLBinvse
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEisi), CpCACHEflushbtc
+	DSB
+	ISB
+	RET
+
+/*
+ * writeback and invalidate L1 data cache
+ */
+TEXT cachedwbinv(SB), 1, $-4
+	MOVW.W	R14, -8(R13)
+	MOVW	$2, R0
+	MOVW	$1, R8
+	BL	wholecache(SB)
+	MOVW.P	8(R13), R15
+
+/*
+ * cachedwbinvse(va, n)
+ *   writeback and invalidate data cache range [va, va+n),
+ *   to the point of coherency
+ */
+TEXT cachedwbinvse(SB), 1, $-4
+	MOVW	n+4(FP), R2
+	ADD	R0, R2
+	BIC	$(CACHELINESZ-1), R0
+	DSB
+dwbinvse:
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEwbi), CpCACHEse
+	ADD	$CACHELINESZ, R0
+	CMP.S	R2, R0
+	BLO	dwbinvse
+	DSB
+	RET
+
+/*
+ * cachedwbse(va, n)
+ *   writeback data cache range [va, va+n), to the point of coherency
+ */
+TEXT cachedwbse(SB), 1, $-4
+	MOVW	n+4(FP), R2
+	ADD	R0, R2
+	BIC	$(CACHELINESZ-1), R0
+	DSB
+dwbse:
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEwb), CpCACHEse
+	ADD	$CACHELINESZ, R0
+	CMP.S	R2, R0
+	BLO	dwbse
+	DSB
+	RET
+
+/*
+ * writeback and invalidate L1 data cache
+ * invalidate instruction cache
+ */
+TEXT cacheuwbinv(SB), 1, $-4
+	MOVW.W	R14, -8(R13)
+	MOVW	$2, R0
+	MOVW	$1, R8
+	BL	wholecache(SB)
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvi), CpCACHEall
+	ISB
+	MOVW.P	8(R13), R15
+
+/*
+ * invalidate instruction cache, on all cpus
+ */
+TEXT cacheiinv(SB), 1, $-4
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEisi), CpCACHEall
+	DSB
+	ISB
+	RET
+
+/*
+ * writeback and invalidate all levels of data cache,
+ * invalidate instruction cache.  for reboot, when the
+ * other cpus have stopped.
+ */
+TEXT l2cacheuwbinv(SB), 1, $-4
+	MOVW.W	R14, -8(R13)
+	MOVW	$2, R0
+	MOVW	$2, R8
+	BL	wholecache(SB)
+	MOVW	$0, R0
+	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvi), CpCACHEall
+	ISB
+	MOVW.P	8(R13), R15
+
+/*
+ * data cache operation by set/way on levels 1 to R8.
+ * R0 is the operation: 0 invalidate, 1 writeback,
+ * 2 writeback and invalidate.
+ * a leaf using only R0-R8 and no stack, so that armstart
+ * can call it with the mmu off.
+ *
+ * R1	set/way operand
+ * R2	set
+ * R3	sets-1
+ * R4	level<<1
+ * R5	log2(line size)
+ * R6	way
+ * R7	way shift
+ * R8	last level<<1
+ */
+TEXT wholecache(SB), 1, $-4
+	DSB
+	SLL	$1, R8
+	MOVW	$0, R4
+level:
+	MCR	CpSC, CpIDcssel, R4, C(CpID), C(CpIDidct), 0
+	ISB
+	MRC	CpSC, CpIDcsize, R1, C(CpID), C(CpIDidct), 0
+	AND	$7, R1, R5
+	ADD	$4, R5
+	MOVW	R1>>13, R3
+	AND	$((1<<15)-1), R3
+	MOVW	R1>>3, R6
+	AND	$((1<<10)-1), R6
+	CLZ(6, 7)
+way:
+	MOVW	R3, R2
+set:
+	MOVW	R6<<R7, R1
+	ORR	R4, R1
+	ORR	R2<<R5, R1
+	CMP	$1, R0
+	BEQ	setwb
+	BGT	setwbinv
+	MCR	CpSC, 0, R1, C(CpCACHE), C(CpCACHEinvd), CpCACHEsi
+	B	setnext
+setwb:
+	MCR	CpSC, 0, R1, C(CpCACHE), C(CpCACHEwb), CpCACHEsi
+	B	setnext
+setwbinv:
+	MCR	CpSC, 0, R1, C(CpCACHE), C(CpCACHEwbi), CpCACHEsi
+setnext:
+	SUB.S	$1, R2
+	BGE	set
+	SUB.S	$1, R6
+	BGE	way
+	ADD	$2, R4
+	CMP	R8, R4
+	BLT	level
+
+	MOVW	$0, R1
+	MCR	CpSC, CpIDcssel, R1, C(CpID), C(CpIDidct), 0
+	DSB
+	ISB
+	RET
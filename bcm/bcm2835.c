@@ -0,0 +1,36 @@
+/*
+ * bcm2835 (raspberry pi 1) specifics: one arm1176jzf-s.
+ */
+
+#include "u.h"
+#include "../port/lib.h"
+#include "mem.h"
+#include "dat.h"
+#include "fns.h"
+
+#include "arm.h"
+
+Soc soc = {
+	.dramsize	= 512*MiB,
+	.physio		= 0x20000000,
+	.busdram	= 0x40000000,
+	.busio		= 0x7E000000,
+	.armlocal	= 0,
+	.l1ptedramattrs	= Cached | Buffered,
+	.l2ptedramattrs	= Cached | Buffered,
+};
+
+void
+cpuidprint(void)
+{
+	print("cpu%d: %dMHz ARM1176JZF-S\n", m->machno, m->cpumhz);
+}
+
+/*
+ * there are no others
+ */
+int
+startcpus(uint)
+{
+	return 1;
+}
@@ -0,0 +1,92 @@
+/*
+ * bcm2836 (raspberry pi 2) specifics: four cortex-a7s,
+ * with per-cpu timers and mailboxes at ARMLOCAL.
+ */
+
+#include "u.h"
+#include "../port/lib.h"
+#include "mem.h"
+#include "dat.h"
+#include "fns.h"
+#include "io.h"
+
+#include "arm.h"
+
+Soc soc = {
+	.dramsize	= 0x3F000000,	/* up to the i/o registers */
+	.physio		= 0x3F000000,
+	.busdram	= 0xC0000000,
+	.busio		= 0x7E000000,
+	.armlocal	= 0x40000000,
+	.l1ptedramattrs	= Cached | Buffered | L1wralloc | L1sharable,
+	.l2ptedramattrs	= Cached | Buffered | L2wralloc | L2sharable,
+};
+
+void
+cpuidprint(void)
+{
+	print("cpu%d: %dMHz ARM Cortex-A7\n", m->machno, m->cpumhz);
+}
+
+/*
+ * the firmware parks the other cpus, each waiting for
+ * a start address in its mailbox 3.
+ */
+static int
+startcpu(uint cpu)
+{
+	u32int *local;
+	int ms;
+	extern void cpureset(void);
+
+	local = (u32int*)ARMLOCAL;
+	if(local[Localmboxclr + 4*cpu + 3] != 0)
+		return -1;		/* not waiting */
+	local[Localmboxset + 4*cpu + 3] = PADDR(cpureset);
+	sev();
+	for(ms = 0; ms < 1000; ms++){
+		if(active.machs & (1<<cpu))
+			return 0;
+		delay(1);
+	}
+	return -1;
+}
+
+/*
+ * give the other cpus a Mach and a copy of cpu0's l1,
+ * with the first MB of ram identity mapped so they can
+ * turn their mmus on, and start them one at a time.
+ * returns the number running.
+ */
+int
+startcpus(uint ncpu)
+{
+	int cpu;
+	Mach *mm;
+	PTE *l1;
+
+	for(cpu = 1; cpu < ncpu; cpu++){
+		mm = mallocalign(MACHSIZE, MACHSIZE, 0, 0);
+		l1 = mallocalign(L1SIZE, L1SIZE, 0, 0);
+		if(mm == nil || l1 == nil){
+			free(mm);
+			free(l1);
+			break;
+		}
+		memset(mm, 0, MACHSIZE);
+		mm->machno = cpu;
+		memmove(l1, m->mmul1, L1SIZE);
+		l1[PHYSDRAM>>20] = PHYSDRAM|Dom0|L1AP(Krw)|Section|soc.l1ptedramattrs;
+		cachedwbse(l1, L1SIZE);
+		mm->mmul1 = l1;
+		cachedwbse(mm, MACHSIZE);
+		machaddr[cpu] = mm;
+		cachedwbse(&machaddr[cpu], sizeof(machaddr[cpu]));
+		if(startcpu(cpu) < 0){
+			print("cpu%d: didn't start\n", cpu);
+			machaddr[cpu] = nil;
+			break;
+		}
+	}
+	return conf.nmach;
+}
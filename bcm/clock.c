@@ -6,6 +6,7 @@
  *    All are free-running up-counters
  *
  * Use system timer 3 (64 bits) for hzclock interrupts and fastticks
+ *   (on the bcm2836, each cpu's generic virtual timer for hzclock)
  * Use ARM timer (32 bits) for perfticks
  * Use ARM timer to force immediate interrupt
  * Use cycle counter for cycles()
@@ -18,6 +19,8 @@
 #include "fns.h"
 #include "io.h"
 
+#include "arm.h"
+
 enum {
 	SYSTIMERS	= VIRTIO+0x3000,
 	ARMTIMER	= VIRTIO+0xB400,
@@ -66,6 +69,8 @@ enum {
 	CntWidth32	= 1<<1,
 };
 
+static u32int cntfreq;		/* of the cortex-a7 generic timer */
+
 static void
 clockintr(Ureg *ureg, void *)
 {
@@ -77,11 +82,26 @@ clockintr(Ureg *ureg, void *)
 	timerintr(ureg, 0);
 }
 
+/*
+ * this cpu's generic timer has expired
+ */
+void
+localclockintr(Ureg *ureg)
+{
+	/* dismiss interrupt until timerset */
+	cntvtvalset(~0U>>1);
+	timerintr(ureg, 0);
+}
+
 void
 clockshutdown(void)
 {
 	Armtimer *tm;
 
+	if(PHYSARMLOCAL != 0)
+		cntvctlset(0);
+	if(m->machno != 0)
+		return;
 	tm = (Armtimer*)ARMTIMER;
 	tm->ctl = 0;
 	wdogoff();
@@ -95,6 +115,14 @@ clockinit(void)
 	u32int t0, t1, tstart, tend;
 
 	tn = (Systimers*)SYSTIMERS;
+	if(PHYSARMLOCAL != 0){
+		cntvtvalset(~0U>>1);
+		cntvctlset(CpTIMERenable);
+		((u32int*)ARMLOCAL)[Localtimerctl + m->machno] = Localcntv;
+	}
+	if(m->machno != 0)
+		return;			/* machinit copied cpu0's speeds */
+
 	tm = (Armtimer*)ARMTIMER;
 	tm->load = 0;
 	tm->ctl = TmrPrescale1|CntEnable|CntWidth32;
@@ -112,6 +140,10 @@ clockinit(void)
 	m->cpumhz = (m->cpuhz + Mhz/2 - 1) / Mhz;
 	m->cyclefreq = m->cpuhz;
 
+	if(PHYSARMLOCAL != 0){
+		cntfreq = cntfrqget();
+		return;
+	}
 	tn->c3 = tn->clo - 1;
 	intrenable(IRQtimer3, clockintr, nil, 0, "clock");
 }
@@ -129,6 +161,11 @@ timerset(uvlong next)
 		next = now + MinPeriod;
 	else if(period > MaxPeriod)
 		next = now + MaxPeriod;
+	if(PHYSARMLOCAL != 0){
+		period = next - now;
+		cntvtvalset(period * cntfreq / SystimerFreq);
+		return;
+	}
 	tn->c3 = (ulong)next;
 }
 
@@ -26,6 +26,7 @@ typedef struct Page	Page;
 typedef struct PhysUart	PhysUart;
 typedef struct PMMU	PMMU;
 typedef struct Proc	Proc;
+typedef struct Soc	Soc;
 typedef u32int		PTE;
 typedef struct Uart	Uart;
 typedef struct Ureg	Ureg;
@@ -226,6 +227,7 @@ struct
 	int	machs;			/* bitmap of active CPUs */
 	int	exiting;		/* shutdown */
 	int	ispanic;		/* shutdown in response to a panic */
+	u32int	wfi;			/* bitmap of CPUs in WFI state */
 }active;
 
 extern register Mach* m;			/* R10 */
@@ -255,6 +257,21 @@ struct ISAConf {
 
 #define	MACHP(n)	(machaddr[n])
 
+/*
+ * what differs between the bcm2835 and bcm2836,
+ * set in bcm2835.c or bcm2836.c
+ */
+struct Soc {
+	uintptr	dramsize;
+	uintptr	physio;
+	uintptr	busdram;
+	uintptr	busio;
+	uintptr	armlocal;		/* per-cpu timers and mailboxes */
+	u32int	l1ptedramattrs;
+	u32int	l2ptedramattrs;
+};
+extern Soc soc;
+
 /*
  * Horrid. But the alternative is 'defined'.
  */
@@ -80,6 +80,7 @@ typedef struct Cb Cb;
 struct Ctlr {
 	u32int	*regs;
 	Cb	*cb;
+	Cb	*sg;		/* chain for dmastartsg */
 	Rendez	r;
 	int	dmadone;
 };
@@ -134,12 +135,10 @@ dmainterrupt(Ureg*, void *a)
 	wakeup(&ctlr->r);
 }
 
-void
-dmastart(int chan, int dev, int dir, void *src, void *dst, int len)
+static Ctlr*
+dmachan(int chan)
 {
 	Ctlr *ctlr;
-	Cb *cb;
-	int ti;
 
 	ctlr = &dma[chan];
 	if(ctlr->regs == nil){
@@ -152,6 +151,36 @@ dmastart(int chan, int dev, int dir, void *src, void *dst, int len)
 			;
 		intrenable(IRQDMA(chan), dmainterrupt, ctlr, 0, "dma");
 	}
+	return ctlr;
+}
+
+static void
+dmago(Ctlr *ctlr, Cb *cb)
+{
+	ctlr->regs[Cs] = 0;
+	microdelay(1);
+	ctlr->regs[Conblkad] = DMAADDR(cb);
+	DBG print("dma start: %ux %ux %ux %ux %ux %ux\n",
+		cb->ti, cb->sourcead, cb->destad, cb->txfrlen,
+		cb->stride, cb->nextconbk);
+	DBG print("intstatus %ux\n", dmaregs[Intstatus]);
+	dmaregs[Intstatus] = 0;
+	ctlr->regs[Cs] = Int;
+	microdelay(1);
+	coherence();
+	DBG dumpdregs("before Active", ctlr->regs);
+	ctlr->regs[Cs] = Active;
+	DBG dumpdregs("after Active", ctlr->regs);
+}
+
+void
+dmastart(int chan, int dev, int dir, void *src, void *dst, int len)
+{
+	Ctlr *ctlr;
+	Cb *cb;
+	int ti;
+
+	ctlr = dmachan(chan);
 	cb = ctlr->cb;
 	ti = 0;
 	switch(dir){
@@ -180,20 +209,52 @@ dmastart(int chan, int dev, int dir, void *src, void *dst, int len)
 	cb->stride = 0;
 	cb->nextconbk = 0;
 	cachedwbse(cb, sizeof(Cb));
-	ctlr->regs[Cs] = 0;
-	microdelay(1);
-	ctlr->regs[Conblkad] = DMAADDR(cb);
-	DBG print("dma start: %ux %ux %ux %ux %ux %ux\n",
-		cb->ti, cb->sourcead, cb->destad, cb->txfrlen,
-		cb->stride, cb->nextconbk);
-	DBG print("intstatus %ux\n", dmaregs[Intstatus]);
-	dmaregs[Intstatus] = 0;
-	ctlr->regs[Cs] = Int;
-	microdelay(1);
-	coherence();
-	DBG dumpdregs("before Active", ctlr->regs);
-	ctlr->regs[Cs] = Active;
-	DBG dumpdregs("after Active", ctlr->regs);
+	dmago(ctlr, cb);
+}
+
+/*
+ * scatter-gather between a device register and n pieces of
+ * memory at physical addresses pa[i], lengths len[i],
+ * one chained control block each.  only the last one
+ * interrupts.  the caller does the cache maintenance,
+ * since only it knows a virtual address for each piece.
+ */
+void
+dmastartsg(int chan, int dev, int dir, void *io, uintptr *pa, int *len, int n)
+{
+	Ctlr *ctlr;
+	Cb *cb;
+	int i, ti;
+
+	assert(n > 0 && n <= DmaMaxseg && dir != DmaM2M);
+	ctlr = dmachan(chan);
+	if(ctlr->sg == nil){
+		ctlr->sg = xspanalloc(DmaMaxseg*sizeof(Cb), Cbalign, 0);
+		assert(ctlr->sg != nil);
+	}
+	if(dir == DmaD2M)
+		ti = Srcdreq | Destinc;
+	else
+		ti = Destdreq | Srcinc;
+	ti |= dev<<Permapshift;
+	for(i = 0; i < n; i++){
+		cb = &ctlr->sg[i];
+		cb->ti = ti;
+		if(dir == DmaD2M){
+			cb->sourcead = DMAIO(io);
+			cb->destad = BUSDRAM | pa[i];
+		}else{
+			cb->sourcead = BUSDRAM | pa[i];
+			cb->destad = DMAIO(io);
+		}
+		cb->txfrlen = len[i];
+		cb->stride = 0;
+		cb->nextconbk = DMAADDR(cb+1);
+	}
+	cb->ti |= Inten;
+	cb->nextconbk = 0;
+	cachedwbse(ctlr->sg, n*sizeof(Cb));
+	dmago(ctlr, ctlr->sg);
 }
 
 int
@@ -105,6 +105,7 @@ enum {
 	Ccrcerr		= 1<<17,
 	Ctoerr		= 1<<16,
 	Err		= 1<<15,
+	Errors		= 0x1FF<<16 | Err,
 	Cardintr	= 1<<8,		/* not in Broadcom datasheet */
 	Cardinsert	= 1<<6,		/* not in Broadcom datasheet */
 	Readrdy		= 1<<5,
@@ -134,9 +135,9 @@ int cmdinfo[64] = {
 [13] Resp48 | Ixchken | Crcchken,
 [16] Resp48,
 [17] Resp48 | Isdata | Card2host | Ixchken | Crcchken,
-[18] Resp48 | Isdata | Card2host | Multiblock | Blkcnten | Ixchken | Crcchken,
+[18] Resp48 | Isdata | Card2host | Multiblock | Blkcnten | Autocmd12 | Ixchken | Crcchken,
 [24] Resp48 | Isdata | Host2card | Ixchken | Crcchken,
-[25] Resp48 | Isdata | Host2card | Multiblock | Blkcnten | Ixchken | Crcchken,
+[25] Resp48 | Isdata | Host2card | Multiblock | Blkcnten | Autocmd12 | Ixchken | Crcchken,
 [41] Resp48,
 [55] Resp48 | Ixchken | Crcchken,
 };
@@ -144,10 +145,15 @@ int cmdinfo[64] = {
 typedef struct Ctlr Ctlr;
 
 struct Ctlr {
+	Lock;
 	Rendez	r;
-	int	datadone;
+	u32int	intr;		/* interrupt bits not yet consumed */
 	int	fastclock;
 	ulong	extclk;
+
+	/* scatter-gather list for a user buffer */
+	uintptr	sgpa[DmaMaxseg];
+	int	sglen[DmaMaxseg];
 };
 
 static Ctlr emmc;
@@ -176,9 +182,27 @@ clkdiv(uint d)
 }
 
 static int
-datadone(void*)
+intrdone(void *a)
+{
+	return emmc.intr & (uintptr)a;
+}
+
+/*
+ * sleep until one of the interrupt bits in mask, or an
+ * error, has come in; consume and return them.
+ */
+static u32int
+intrwait(u32int mask, int ms)
 {
-	return emmc.datadone;
+	u32int i;
+
+	mask |= Errors;
+	tsleep(&emmc.r, intrdone, (void*)mask, ms);
+	ilock(&emmc);
+	i = emmc.intr & mask;
+	emmc.intr &= ~i;
+	iunlock(&emmc);
+	return i;
 }
 
 static int
@@ -237,6 +261,7 @@ emmcenable(void)
 		print("SD clock won't initialise!\n");
 	WR(Irptmask, ~(Dtoerr|Cardintr));
 	intrenable(IRQmmc, mmcinterrupt, nil, 0, "mmc");
+	WR(Irpten, Cmddone|Datadone|Errors);
 }
 
 static int
@@ -245,7 +270,6 @@ emmccmd(u32int cmd, u32int arg, u32int *resp)
 	u32int *r;
 	u32int c;
 	int i;
-	ulong now;
 
 	r = (u32int*)EMMCREGS;
 	assert(cmd < nelem(cmdinfo) && cmdinfo[cmd] != 0);
@@ -275,15 +299,14 @@ emmccmd(u32int cmd, u32int arg, u32int *resp)
 			print("emmc: before command, intr was %ux\n", i);
 		WR(Interrupt, i);
 	}
+	ilock(&emmc);
+	emmc.intr = 0;
+	iunlock(&emmc);
 	WR(Cmdtm, c);
-	now = m->ticks;
-	while(((i=r[Interrupt])&(Cmddone|Err)) == 0)
-		if(m->ticks-now > HZ)
-			break;
+	i = intrwait(Cmddone, 1000);
 	if((i&(Cmddone|Err)) != Cmddone){
 		if((i&~Err) != Ctoerr)
 			print("emmc: cmd %ux error intr %ux stat %ux\n", c, i, r[Status]);
-		WR(Interrupt, i);
 		if(r[Status]&Cmdinhibit){
 			WR(Control1, r[Control1]|Srstcmd);
 			while(r[Control1]&Srstcmd)
@@ -291,7 +314,6 @@ emmccmd(u32int cmd, u32int arg, u32int *resp)
 		}
 		error(Eio);
 	}
-	WR(Interrupt, i & ~(Datadone|Readrdy|Writerdy));
 	switch(c & Respmask){
 	case Resp136:
 		resp[0] = r[Resp0]<<8;
@@ -308,17 +330,12 @@ emmccmd(u32int cmd, u32int arg, u32int *resp)
 		break;
 	}
 	if((c & Respmask) == Resp48busy){
-		WR(Irpten, Datadone|Err);
-		tsleep(&emmc.r, datadone, 0, 3000);
-		i = emmc.datadone;
-		emmc.datadone = 0;
-		WR(Irpten, 0);
+		i = intrwait(Datadone, 3000);
 		if((i & Datadone) == 0)
 			print("emmcio: no Datadone after CMD%d\n", cmd);
 		if(i & Err)
 			print("emmcio: CMD%d error interrupt %ux\n",
-				cmd, r[Interrupt]);
-		WR(Interrupt, i);
+				cmd, i);
 	}
 	/*
 	 * Once card is selected, use faster clock
@@ -359,47 +376,155 @@ emmciosetup(int write, void *buf, int bsize, int bcount)
 	WR(Blksizecnt, bcount<<16 | bsize);
 }
 
+/*
+ * give up a segment emmcsg returned
+ */
+static void
+emmcsgdone(Segment *s)
+{
+	qlock(&s->lk);
+	s->steal--;
+	qunlock(&s->lk);
+	putseg(s);
+}
+
+/*
+ * build the scatter-gather list for a user buffer, a piece
+ * per physically contiguous run, faulting its pages in.
+ * a reference and a raised steal count keep the segment,
+ * and the pager off its pages, until emmcsgdone.
+ * returns nil if the buffer can't be used directly.
+ */
+static Segment*
+emmcsg(int write, uchar *buf, int len, int *np)
+{
+	Segment *s;
+	Pte *pte;
+	Page *pg;
+	ulong addr, soff;
+	uintptr pa;
+	int l, n, tot;
+
+	/* a read must not share cache lines with anything else */
+	if((uintptr)buf & (CACHELINESZ-1))
+		return nil;
+	s = seg(up, (uintptr)buf, 1);
+	if(s == nil)
+		return nil;
+	if((uintptr)buf+len > s->top){
+		qunlock(&s->lk);
+		return nil;
+	}
+	incref(s);
+	s->steal++;
+	qunlock(&s->lk);
+	if(waserror()){
+		emmcsgdone(s);
+		nexterror();
+	}
+	n = 0;
+	for(tot = 0; tot < len; tot += l){
+		addr = (uintptr)buf + tot;
+		do
+			qlock(&s->lk);
+		while(fixfault(s, addr, write, 1) != 0);
+
+		soff = addr - s->base;
+		pte = s->map[soff/PTEMAPMEM];
+		if(pte == nil)
+			panic("emmcsg");
+		pg = pte->pages[(soff&(PTEMAPMEM-1))/BY2PG];
+		if(pagedout(pg))
+			panic("emmcsg1");
+
+		l = BY2PG - (addr&(BY2PG-1));
+		if(l > len - tot)
+			l = len - tot;
+		pa = pg->pa + (addr&(BY2PG-1));
+		if(n > 0 && emmc.sgpa[n-1] + emmc.sglen[n-1] == pa)
+			emmc.sglen[n-1] += l;
+		else{
+			if(n == DmaMaxseg){
+				poperror();
+				emmcsgdone(s);
+				return nil;
+			}
+			emmc.sgpa[n] = pa;
+			emmc.sglen[n] = l;
+			n++;
+		}
+	}
+	poperror();
+	if(write)
+		cachedwbse(buf, len);
+	else
+		cachedwbinvse(buf, len);
+	*np = n;
+	return s;
+}
+
+/*
+ * dma straight to or from buf: a user buffer through a
+ * scatter-gather list, a kernel one in place if it has
+ * cache lines to itself, or else a bounce buffer.
+ */
 static void
 emmcio(int write, uchar *buf, int len)
 {
 	u32int *r;
-	int i;
+	uchar *b;
+	Segment *s;
+	int i, n;
 
 	r = (u32int*)EMMCREGS;
 	assert((len&3) == 0);
 	okay(1);
+	s = nil;
+	b = nil;
 	if(waserror()){
+		if(s != nil)
+			emmcsgdone(s);
+		sdfree(b);
 		okay(0);
 		nexterror();
 	}
-	if(write)
+	if((uintptr)buf < KZERO)
+		s = emmcsg(write, buf, len, &n);
+	if(s == nil && ((uintptr)buf < KZERO || (((uintptr)buf|len) & (CACHELINESZ-1)) != 0)){
+		b = sdmalloc(len);
+		if(b == nil)
+			error(Enomem);
+		if(write)
+			memmove(b, buf, len);
+	}
+	if(s != nil)
+		dmastartsg(DmaChanEmmc, DmaDevEmmc, write? DmaM2D: DmaD2M,
+			&r[Data], emmc.sgpa, emmc.sglen, n);
+	else if(write)
 		dmastart(DmaChanEmmc, DmaDevEmmc, DmaM2D,
-			buf, &r[Data], len);
+			b? b: buf, &r[Data], len);
 	else
 		dmastart(DmaChanEmmc, DmaDevEmmc, DmaD2M,
-			&r[Data], buf, len);
+			&r[Data], b? b: buf, len);
 	if(dmawait(DmaChanEmmc) < 0)
 		error(Eio);
-	WR(Irpten, Datadone|Err);
-	tsleep(&emmc.r, datadone, 0, 3000);
-	i = emmc.datadone;
-	emmc.datadone = 0;
-	WR(Irpten, 0);
+	i = intrwait(Datadone, 3000);
 	if((i & Datadone) == 0){
 		print("emmcio: %d timeout intr %ux stat %ux\n",
 			write, i, r[Status]);
-		WR(Interrupt, i);
 		error(Eio);
 	}
 	if(i & Err){
 		print("emmcio: %d error intr %ux stat %ux\n",
-			write, r[Interrupt], r[Status]);
-		WR(Interrupt, i);
+			write, i, r[Status]);
 		error(Eio);
 	}
-	if(i)
-		WR(Interrupt, i);
+	if(b != nil && !write)
+		memmove(buf, b, len);
 	poperror();
+	if(s != nil)
+		emmcsgdone(s);
+	sdfree(b);
 	okay(0);
 }
 
@@ -411,8 +536,10 @@ mmcinterrupt(Ureg*, void*)
 
 	r = (u32int*)EMMCREGS;
 	i = r[Interrupt];
-	r[Interrupt] = i & (Datadone|Err);
-	emmc.datadone = i;
+	r[Interrupt] = i;
+	ilock(&emmc);
+	emmc.intr |= i;
+	iunlock(&emmc);
 	wakeup(&emmc.r);
 }
 
@@ -424,4 +551,6 @@ SDio sdio = {
 	emmccmd,
 	emmciosetup,
 	emmcio,
+	1,		/* Autocmd12 */
+	1,		/* emmcio maps user buffers */
 };
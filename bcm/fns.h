@@ -11,6 +11,9 @@ extern void cachedwbinvse(void*, int);
 extern void cacheiinv(void);
 extern void cacheuwbinv(void);
 extern uintptr cankaddr(uintptr pa);
+extern u32int cntfrqget(void);
+extern void cntvctlset(u32int);
+extern void cntvtvalset(u32int);
 extern int cas32(void*, u32int, u32int);
 extern void checkmmu(uintptr, uintptr);
 extern void clockinit(void);
@@ -20,10 +23,12 @@ extern void coherence(void);
 extern ulong cprd(int cp, int op1, int crn, int crm, int op2);
 extern ulong cprdsc(int op1, int crn, int crm, int op2);
 extern void cpuidprint(void);
+extern void cpustart(void);
 extern void cpwr(int cp, int op1, int crn, int crm, int op2, ulong val);
 extern void cpwrsc(int op1, int crn, int crm, int op2, ulong val);
 #define cycles(ip) *(ip) = lcycles()
 extern void dmastart(int, int, int, void*, void*, int);
+extern void dmastartsg(int, int, int, void*, uintptr*, int*, int);
 extern int dmawait(int);
 extern int fbblank(int);
 extern void* fbinit(int, int*, int*, int*);
@@ -42,11 +47,14 @@ extern uint getfirmware(void);
 extern int getpower(int);
 extern void getramsize(Confmem*);
 extern u32int ifsrget(void);
+extern void intrcpu(int);
 extern void irqenable(int, void (*)(Ureg*, void*), void*);
 #define intrenable(i, f, a, b, n) irqenable((i), (f), (a))
 extern void intrsoff(void);
 extern int isaconfig(char*, int, ISAConf*);
+extern void l2cacheuwbinv(void);
 extern void links(void);
+extern void localclockintr(Ureg*);
 extern void mmuinit(void);
 extern void mmuinit1(void);
 extern void mmuinvalidate(void);
@@ -61,8 +69,10 @@ extern void screeninit(void);
 #define sdmalloc(n)	mallocalign(n, CACHELINESZ, 0, 0)
 extern void setpower(int, int);
 extern void setr13(int, u32int*);
+extern void sev(void);
 extern int splfhi(void);
 extern int splflo(void);
+extern int startcpus(uint);
 extern void swcursorinit(void);
 extern void syscallfmt(int syscallno, ulong pc, va_list list);
 extern void sysretfmt(int syscallno, va_list list, long ret, uvlong start, uvlong stop);
@@ -73,7 +83,9 @@ extern void uartconsinit(void);
 extern int userureg(Ureg*);
 extern void vectors(void);
 extern void vtable(void);
+extern void wakewfi(void);
 extern void wdogoff(void);
+extern void wfi(void);
 
 /*
  * floating point emulation
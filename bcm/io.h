@@ -15,9 +15,24 @@ enum {
 
 	IRQfiq		= IRQusb,	/* only one source can be FIQ */
 
+	/*
+	 * bcm2836 per-cpu registers at ARMLOCAL, as u32int indices;
+	 * mailboxes are 4 to a cpu, cpu n's at 4*n.
+	 */
+	Localtimerctl	= 0x40/4,	/* +cpu: timer irq enables */
+	Localmboxctl	= 0x50/4,	/* +cpu: mailbox irq enables */
+	Localirqsrc	= 0x60/4,	/* +cpu: pending irq sources */
+	Localmboxset	= 0x80/4,	/* +4*cpu+mbox: write to set bits */
+	Localmboxclr	= 0xC0/4,	/* +4*cpu+mbox: read, or write to clear */
+
+	Localcntv	= 1<<3,		/* virtual timer */
+	Localmbox0	= 1<<4,		/* ipi */
+	Localgpu	= 1<<8,		/* everything else, to cpu0 */
+
 	DmaD2M		= 0,		/* device to memory */
 	DmaM2D		= 1,		/* memory to device */
 	DmaM2M		= 2,		/* memory to memory */
+	DmaMaxseg	= 520,		/* scatter-gather pieces per transfer */
 
 	DmaChanEmmc	= 4,		/* can only use 2-5, maybe 0 */
 	DmaDevEmmc	= 11,
@@ -1,6 +1,9 @@
 /*
  * Broadcom bcm2835 SoC, as used in Raspberry Pi
- * arm1176jzf-s processor (armv6)
+ * arm1176jzf-s processor (armv6),
+ * and bcm2836, as used in Raspberry Pi 2
+ * 4 x cortex-a7 processors (armv7).
+ * code peculiar to one or the other is in armv6.s and armv7.s.
  */
 
 #include "arm.s"
@@ -13,24 +16,13 @@ TEXT _start(SB), 1, $-4
 	MOVW	$setR12(SB), R12
 	SUB	$KZERO, R12
 	ADD	$PHYSDRAM, R12
-	MOVW	$0, R0
 
 	/*
-	 * SVC mode, interrupts disabled
+	 * SVC mode, interrupts disabled, mmu and caches off,
+	 * caches and tlb invalidated, cycle counter on
 	 */
-	MOVW	$(PsrDirq|PsrDfiq|PsrMsvc), R1
-	MOVW	R1, CPSR
-
-	/*
-	 * disable the mmu and L1 caches
-	 * invalidate caches and tlb
-	 */
-	MRC	CpSC, 0, R1, C(CpCONTROL), C(0), CpMainctl
-	BIC	$(CpCdcache|CpCicache|CpCpredict|CpCmmu), R1
-	MCR	CpSC, 0, R1, C(CpCONTROL), C(0), CpMainctl
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvu), CpCACHEall
-	MCR	CpSC, 0, R0, C(CpTLB), C(CpTLBinvu), CpTLBinv
-	ISB
+	BL	armstart(SB)
+	MOVW	$0, R0
 
 	/*
 	 * clear mach and page tables
@@ -74,12 +66,8 @@ _ramZ:
 	MOVW	$_startpg(SB), R15
 
 TEXT _startpg(SB), 1, $-4
-
-	/*
-	 * enable cycle counter
-	 */
-	MOVW	$1, R1
-	MCR	CpSC, 0, R1, C(CpSPM), C(CpSPMperf), CpSPMctl
+	MOVW	$MACHADDR, R(MACH)
+	SETMACH(R(MACH))
 
 	/*
 	 * call main and loop forever if it returns
@@ -89,6 +77,58 @@ TEXT _startpg(SB), 1, $-4
 
 	BL	_div(SB)		/* hack to load _div, etc. */
 
+/*
+ * the other cpus start here (see startcpu in bcm2836.c),
+ * with the mmu off, after launchinit has given them a Mach
+ * and an l1 table that maps this page at its physical address.
+ */
+TEXT cpureset(SB), 1, $-4
+	MOVW	$setR12(SB), R12
+	SUB	$KZERO, R12
+	ADD	$PHYSDRAM, R12
+	BL	armstart(SB)
+
+	/*
+	 * m = machaddr[cpuid], stack at top of mach (physical addrs)
+	 */
+	CPUID(R1)
+	SLL	$2, R1
+	MOVW	$machaddr(SB), R2
+	BIC	$KSEGM, R2
+	ADD	R1, R2
+	MOVW	(R2), R(MACH)
+	SETMACH(R(MACH))
+	BIC	$KSEGM, R(MACH), R2
+	ADD	$(MACHSIZE-4), R2, R13
+
+	/*
+	 * set up domain access control and page table base
+	 */
+	MOVW	$Client, R1
+	MCR	CpSC, 0, R1, C(CpDAC), C(0)
+	MOVW	12(R2), R1			/* m->mmul1 */
+	BIC	$KSEGM, R1
+	MCR	CpSC, 0, R1, C(CpTTB), C(0)
+
+	/*
+	 * enable caches, mmu, and high vectors
+	 */
+	MRC	CpSC, 0, R0, C(CpCONTROL), C(0), CpMainctl
+	ORR	$(CpChv|CpCdcache|CpCicache|CpCmmu), R0
+	MCR	CpSC, 0, R0, C(CpCONTROL), C(0), CpMainctl
+	ISB
+
+	/*
+	 * switch SB, SP, and PC into KZERO space
+	 */
+	MOVW	$setR12(SB), R12
+	ADD	$(MACHSIZE-4), R(MACH), R13
+	MOVW	$_cpupg(SB), R15
+
+TEXT _cpupg(SB), 1, $-4
+	BL	,cpustart(SB)
+	B	,0(PC)
+
 TEXT fsrget(SB), 1, $-4				/* data fault status */
 	MRC	CpSC, 0, R0, C(CpFSR), C(0), CpFSRdata
 	RET
@@ -101,13 +141,25 @@ TEXT farget(SB), 1, $-4				/* fault address */
 	MRC	CpSC, 0, R0, C(CpFAR), C(0x0)
 	RET
 
-TEXT lcycles(SB), 1, $-4
-	MRC	CpSC, 0, R0, C(CpSPM), C(CpSPMperf), CpSPMcyc
+/*
+ * the generic timer of the cortex-a7 (armv7 only)
+ */
+TEXT cntfrqget(SB), 1, $-4
+	MRC	CpSC, 0, R0, C(CpTIMER), C(CpTIMERfreq), 0
+	RET
+
+TEXT cntvtvalset(SB), 1, $-4
+	MCR	CpSC, 0, R0, C(CpTIMER), C(CpTIMERvirt), CpTIMERval
+	ISB
+	RET
+
+TEXT cntvctlset(SB), 1, $-4
+	MCR	CpSC, 0, R0, C(CpTIMER), C(CpTIMERvirt), CpTIMERctl
+	ISB
 	RET
 
 TEXT splhi(SB), 1, $-4
-	MOVW	$(MACHADDR+4), R2		/* save caller pc in Mach */
-	MOVW	R14, 0(R2)
+	MOVW	R14, 4(R(MACH))			/* save caller pc in Mach */
 
 	MOVW	CPSR, R0			/* turn off irqs (but not fiqs) */
 	ORR	$(PsrDirq), R0, R1
@@ -115,8 +167,7 @@ TEXT splhi(SB), 1, $-4
 	RET
 
 TEXT splfhi(SB), 1, $-4
-	MOVW	$(MACHADDR+4), R2		/* save caller pc in Mach */
-	MOVW	R14, 0(R2)
+	MOVW	R14, 4(R(MACH))			/* save caller pc in Mach */
 
 	MOVW	CPSR, R0			/* turn off irqs and fiqs */
 	ORR	$(PsrDirq|PsrDfiq), R0, R1
@@ -136,8 +187,7 @@ TEXT spllo(SB), 1, $-4
 	RET
 
 TEXT splx(SB), 1, $-4
-	MOVW	$(MACHADDR+0x04), R2		/* save caller pc in Mach */
-	MOVW	R14, 0(R2)
+	MOVW	R14, 4(R(MACH))			/* save caller pc in Mach */
 
 	MOVW	R0, R1				/* reset interrupt level */
 	MOVW	CPSR, R0
@@ -153,122 +203,100 @@ TEXT islo(SB), 1, $-4
 	EOR	$(PsrDirq), R0
 	RET
 
+/*
+ * the exclusive monitor works on cached memory on all
+ * the cpus, where swp (and disabling interrupts) doesn't.
+ */
 TEXT	tas(SB), $-4
 TEXT	_tas(SB), $-4
-	MOVW	R0,R1
-	MOVW	$1,R0
-	SWPW	R0,(R1)			/* fix: deprecated in armv6 */
+	MOVW	R0, R5
+	MOVW	$1, R2
+tas1:
+	LDREX(5,7)			/* LDREX 0(R5),R7 */
+	CMP.S	$0, R7			/* lock taken? */
+	BNE	tasbusy
+	STREX(2,5,4)			/* STREX R2,(R5),R4 */
+	CMP.S	$0, R4
+	BNE	tas1			/* strex failed? try again */
+	DMB
+	MOVW	R7, R0
 	RET
-
-TEXT setlabel(SB), 1, $-4
-	MOVW	R13, 0(R0)		/* sp */
-	MOVW	R14, 4(R0)		/* pc */
-	MOVW	$0, R0
-	RET
-
-TEXT gotolabel(SB), 1, $-4
-	MOVW	0(R0), R13		/* sp */
-	MOVW	4(R0), R14		/* pc */
-	MOVW	$1, R0
-	RET
-
-TEXT getcallerpc(SB), 1, $-4
-	MOVW	0(R13), R0
-	RET
-
-TEXT idlehands(SB), $-4
-	BARRIERS
-	MOVW	CPSR, R3
-	BIC	$(PsrDirq|PsrDfiq), R3, R1		/* spllo */
-	MOVW	R1, CPSR
-
-	MOVW	$0, R0				/* wait for interrupt */
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEintr), CpCACHEwait
-	ISB
-
-	MOVW	R3, CPSR			/* splx */
-	RET
-
-
-TEXT coherence(SB), $-4
-	BARRIERS
+tasbusy:
+	CLREX
+	MOVW	R7, R0
 	RET
 
 /*
- * invalidate tlb
+ * atomics, returning the new value
  */
-TEXT mmuinvalidate(SB), 1, $-4
-	MOVW	$0, R0
-	MCR	CpSC, 0, R0, C(CpTLB), C(CpTLBinvu), CpTLBinv
-	BARRIERS
+TEXT _xinc(SB), $-4			/* void	_xinc(long *); */
+TEXT ainc(SB), $-4			/* long ainc(long *); */
+	MOVW	R0, R5
+	DMB
+ainc1:
+	LDREX(5,3)
+	ADD	$1, R3
+	STREX(3,5,4)
+	CMP.S	$0, R4
+	BNE	ainc1
+	DMB
+	MOVW	R3, R0
 	RET
 
-/*
- * mmuinvalidateaddr(va)
- *   invalidate tlb entry for virtual page address va, ASID 0
- */
-TEXT mmuinvalidateaddr(SB), 1, $-4
-	MCR	CpSC, 0, R0, C(CpTLB), C(CpTLBinvu), CpTLBinvse
-	BARRIERS
+TEXT _xdec(SB), $-4			/* long _xdec(long *); */
+TEXT adec(SB), $-4			/* long adec(long *); */
+	MOVW	R0, R5
+	DMB
+adec1:
+	LDREX(5,3)
+	SUB	$1, R3
+	STREX(3,5,4)
+	CMP.S	$0, R4
+	BNE	adec1
+	DMB
+	MOVW	R3, R0
 	RET
 
 /*
- * drain write buffer
- * writeback and invalidate data cache
+ * int cas32(void *addr, u32int old, u32int new);
+ * returns 1 if *addr was old and is now new, 0 otherwise
  */
-TEXT cachedwbinv(SB), 1, $-4
-	DSB
+TEXT cas32(SB), $-4
+	MOVW	R0, R5
+	MOVW	old+4(FP), R1
+	MOVW	new+8(FP), R2
+	DMB
+cas1:
+	LDREX(5,3)
+	CMP.S	R3, R1
+	BNE	casfail
+	STREX(2,5,4)
+	CMP.S	$0, R4
+	BNE	cas1
+	DMB
+	MOVW	$1, R0
+	RET
+casfail:
+	CLREX
 	MOVW	$0, R0
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEwbi), CpCACHEall
 	RET
 
-/*
- * cachedwbinvse(va, n)
- *   drain write buffer
- *   writeback and invalidate data cache range [va, va+n)
- */
-TEXT cachedwbinvse(SB), 1, $-4
-	MOVW	R0, R1		/* DSB clears R0 */
-	DSB
-	MOVW	n+4(FP), R2
-	ADD	R1, R2
-	SUB	$1, R2
-	BIC	$(CACHELINESZ-1), R1
-	BIC	$(CACHELINESZ-1), R2
-	MCRR(CpSC, 0, 2, 1, CpCACHERANGEdwbi)
+TEXT setlabel(SB), 1, $-4
+	MOVW	R13, 0(R0)		/* sp */
+	MOVW	R14, 4(R0)		/* pc */
+	MOVW	$0, R0
 	RET
 
-/*
- * cachedwbse(va, n)
- *   drain write buffer
- *   writeback data cache range [va, va+n)
- */
-TEXT cachedwbse(SB), 1, $-4
-	MOVW	R0, R1		/* DSB clears R0 */
-	DSB
-	MOVW	n+4(FP), R2
-	ADD	R1, R2
-	BIC	$(CACHELINESZ-1), R1
-	BIC	$(CACHELINESZ-1), R2
-	MCRR(CpSC, 0, 2, 1, CpCACHERANGEdwb)
+TEXT gotolabel(SB), 1, $-4
+	MOVW	0(R0), R13		/* sp */
+	MOVW	4(R0), R14		/* pc */
+	MOVW	$1, R0
 	RET
 
-/*
- * drain write buffer and prefetch buffer
- * writeback and invalidate data cache
- * invalidate instruction cache
- */
-TEXT cacheuwbinv(SB), 1, $-4
-	BARRIERS
-	MOVW	$0, R0
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEwbi), CpCACHEall
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvi), CpCACHEall
+TEXT getcallerpc(SB), 1, $-4
+	MOVW	0(R13), R0
 	RET
 
-/*
- * invalidate instruction cache
- */
-TEXT cacheiinv(SB), 1, $-4
-	MOVW	$0, R0
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvi), CpCACHEall
+TEXT coherence(SB), $-4
+	BARRIERS
 	RET
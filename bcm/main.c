@@ -38,6 +38,8 @@ static int oargblen;
 
 static uintptr sp;		/* XXX - must go - user stack of init proc */
 
+static void launchinit(void);
+
 /* store plan9.ini contents here at least until we stash them in #ec */
 static char confname[MAXCONF][KNAMELEN];
 static char confval[MAXCONF][MAXCONFLINE];
@@ -191,18 +193,45 @@ ataginit(Atag *a)
 void
 machinit(void)
 {
-	m->machno = 0;
-	machaddr[m->machno] = m;
+	Mach *m0;
 
 	m->ticks = 1;
 	m->perf.period = 1;
+	if(m->machno != 0){
+		/* synchronise with cpu 0 */
+		m0 = MACHP(0);
+		m->ticks = m0->ticks;
+		m->cpuhz = m0->cpuhz;
+		m->cpumhz = m0->cpumhz;
+		m->cyclefreq = m0->cyclefreq;
+		m->delayloop = m0->delayloop;
+	}
+	up = nil;
+}
 
-	conf.nmach = 1;
-
-	active.machs = 1;
-	active.exiting = 0;
+/*
+ * count a started cpu in, or out when it stops
+ */
+static void
+machon(int cpu)
+{
+	lock(&active);
+	if((active.machs & (1<<cpu)) == 0){
+		active.machs |= 1<<cpu;
+		conf.nmach++;
+	}
+	unlock(&active);
+}
 
-	up = nil;
+static void
+machoff(int cpu)
+{
+	lock(&active);
+	if(active.machs & (1<<cpu)){
+		active.machs &= ~(1<<cpu);
+		conf.nmach--;
+	}
+	unlock(&active);
 }
 
 static void
@@ -224,7 +253,12 @@ main(void)
 	okay(1);
 	m = (Mach*)MACHADDR;
 	memset(edata, 0, end - edata);	/* clear bss */
+	m->machno = 0;
+	machaddr[0] = m;
 	machinit();
+	conf.nmach = 1;
+	active.machs = 1;
+	active.exiting = 0;
 	mmuinit1();
 
 	optionsinit("/boot/boot boot");
@@ -261,10 +295,100 @@ main(void)
 	pageinit();
 	swapinit();
 	userinit();
+	launchinit();
 	schedinit();
 	assert(0);			/* shouldn't have returned */
 }
 
+/*
+ * start the other cpus, up to *ncpu of them
+ */
+static void
+launchinit(void)
+{
+	char *p;
+	int ncpu;
+
+	ncpu = MAXMACH;
+	if((p = getconf("*ncpu")) != nil){
+		ncpu = strtol(p, 0, 0);
+		if(ncpu < 1)
+			ncpu = 1;
+		if(ncpu > MAXMACH)
+			ncpu = MAXMACH;
+	}
+	if(ncpu > 1)
+		startcpus(ncpu);
+}
+
+/*
+ * the other cpus arrive here from cpureset in l.s,
+ * on their own l1 tables with the mmu and caches on.
+ */
+void
+cpustart(void)
+{
+	machinit();
+	mmuinit1();
+	trapinit();
+	fpon();
+	clockinit();
+	timersinit();
+	cpuidprint();
+	machon(m->machno);
+	schedinit();
+	panic("cpu%d: schedinit returned", m->machno);
+}
+
+/*
+ * wait for an interrupt, telling the other cpus
+ * so they can wake us when there's work.
+ */
+static void
+wfiadvert(int on)
+{
+	u32int o, n, bit;
+
+	bit = 1<<m->machno;
+	do{
+		o = active.wfi;
+		n = on? o|bit: o&~bit;
+	}while(!cas32(&active.wfi, o, n));
+}
+
+void
+idlehands(void)
+{
+	int s;
+
+	if(conf.nmach > 1)
+		wfiadvert(1);
+	s = splhi();
+	if(!anyready())
+		wfi();
+	spllo();			/* take the interrupt that woke us */
+	splx(s);
+	if(conf.nmach > 1)
+		wfiadvert(0);
+}
+
+/*
+ * prod a cpu waiting in idlehands
+ */
+void
+wakewfi(void)
+{
+	u32int w;
+	int cpu;
+
+	w = active.wfi & ~(1<<m->machno);
+	if(w == 0)
+		return;
+	for(cpu = 0; (w & (1<<cpu)) == 0; cpu++)
+		;
+	intrcpu(cpu);
+}
+
 /*
  *  starting place for first process
  */
@@ -456,7 +580,7 @@ confinit(void)
 	conf.upages = (conf.npage*80)/100;
 	conf.ialloc = ((conf.npage-conf.upages)/2)*BY2PG;
 
-	/* only one processor */
+	/* the others are counted in by machon as they start */
 	conf.nmach = 1;
 
 	/* set up other configuration parameters */
@@ -505,9 +629,9 @@ shutdown(int ispanic)
 	else if(m->machno == 0 && (active.machs & (1<<m->machno)) == 0)
 		active.ispanic = 0;
 	once = active.machs & (1<<m->machno);
-	active.machs &= ~(1<<m->machno);
 	active.exiting = 1;
 	unlock(&active);
+	machoff(m->machno);
 
 	if(once)
 		iprint("cpu%d: exiting\n", m->machno);
@@ -528,7 +652,13 @@ exit(int code)
 {
 	shutdown(code);
 	splfhi();
-	archreboot();
+	if(m->machno == 0)
+		archreboot();
+
+	/* the other cpus stop here */
+	clockshutdown();
+	for(;;)
+		wfi();
 }
 
 /*
@@ -551,6 +681,12 @@ reboot(void *entry, void *code, ulong size)
 {
 	void (*f)(ulong, ulong, ulong);
 
+	/* only cpu0 can be sure of returning to the new kernel */
+	if(m->machno != 0){
+		procwired(up, 0);
+		sched();
+	}
+
 	print("starting reboot...");
 	writeconf();
 	shutdown(0);
@@ -581,6 +717,7 @@ reboot(void *entry, void *code, ulong size)
 	f = (void*)REBOOTADDR;
 	memmove(f, rebootcode, sizeof(rebootcode));
 	cacheuwbinv();
+	l2cacheuwbinv();
 
 	/* off we go - never to return */
 	(*f)(PADDR(entry), PADDR(code), size);
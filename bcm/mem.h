@@ -11,8 +11,12 @@
 #define	BY2PG		(4*KiB)			/* bytes per page */
 #define	PGSHIFT		12			/* log(BY2PG) */
 
-#define	MAXMACH		1			/* max # cpus system can run */
+#define	MAXMACH		4			/* max # cpus system can run */
 #define	MACHSIZE	BY2PG
+#define L1SIZE		(4*BY2PG)
+
+#define	USER		9		/* R9 is up-> */
+#define	MACH		10		/* R10 is m-> */
 
 #define KSTKSIZE	(8*KiB)
 #define STACKALIGN(sp)	((sp) & ~3)		/* bug: assure with alloc */
@@ -28,8 +32,8 @@
  */
 
 #define	KSEG0		0x80000000		/* kernel segment */
-/* mask to check segment; good for 512MB dram */
-#define	KSEGM		0xE0000000
+/* mask to check segment; good for 1GB dram */
+#define	KSEGM		0xC0000000
 #define	KZERO		KSEG0			/* kernel address space */
 #define CONFADDR	(KZERO+0x100)		/* unparsed plan9.ini */
 #define	MACHADDR	(KZERO+0x2000)		/* Mach structure */
@@ -39,7 +43,8 @@
 #define	L1		(KZERO+0x4000)		/* tt ptes: 16KiB aligned */
 #define	KTZERO		(KZERO+0x8000)		/* kernel text start */
 #define VIRTIO		0x7E000000		/* i/o registers */
-#define	FRAMEBUFFER	0xA0000000		/* video framebuffer */
+#define	ARMLOCAL	(VIRTIO+IOSIZE)		/* armv7 only */
+#define	FRAMEBUFFER	0xC0000000		/* video framebuffer */
 
 #define	UZERO		0			/* user segment */
 #define	UTZERO		(UZERO+BY2PG)		/* user text start */
@@ -55,7 +60,7 @@
 /*
  * Legacy...
  */
-#define BLOCKALIGN	32			/* only used in allocb.c */
+#define BLOCKALIGN	32			/* allocb.c and rbpool.c */
 #define KSTACK		KSTKSIZE
 
 /*
@@ -66,7 +71,7 @@
 #define BY2WD		4
 #define BY2V		8			/* only used in xalloc.c */
 
-#define CACHELINESZ	32
+#define CACHELINESZ	64			/* 32 on armv6, 64 on armv7 */
 #define	PTEMAPMEM	(1024*1024)
 #define	PTEPERTAB	(PTEMAPMEM/BY2PG)
 #define	SEGMAPSIZE	1984
@@ -86,10 +91,12 @@
  * Physical machine information from here on.
  *	PHYS addresses as seen from the arm cpu.
  *	BUS  addresses as seen from the videocore gpu.
+ * those that differ between the bcm2835 and bcm2836 are in soc.
  */
 #define	PHYSDRAM	0
-#define BUSDRAM		0x40000000
-#define	DRAMSIZE	(512*MiB)
-#define	PHYSIO		0x20000000
+#define BUSDRAM		(soc.busdram)
+#define	DRAMSIZE	(soc.dramsize)
+#define	PHYSIO		(soc.physio)
 #define	BUSIO		0x7E000000
 #define	IOSIZE		(16*MiB)
+#define	PHYSARMLOCAL	(soc.armlocal)
@@ -28,14 +28,14 @@ mmuinit(void)
 	 */
 	va = KZERO;
 	for(pa = PHYSDRAM; pa < PHYSDRAM+DRAMSIZE; pa += MiB){
-		l1[L1X(va)] = pa|Dom0|L1AP(Krw)|Section|Cached|Buffered;
+		l1[L1X(va)] = pa|Dom0|L1AP(Krw)|Section|soc.l1ptedramattrs;
 		va += MiB;
 	}
 
 	/*
 	 * identity map first MB of ram so mmu can be enabled
 	 */
-	l1[L1X(PHYSDRAM)] = PHYSDRAM|Dom0|L1AP(Krw)|Section|Cached|Buffered;
+	l1[L1X(PHYSDRAM)] = PHYSDRAM|Dom0|L1AP(Krw)|Section|soc.l1ptedramattrs;
 
 	/*
 	 * map i/o registers 
@@ -46,6 +46,12 @@ mmuinit(void)
 		va += MiB;
 	}
 
+	/*
+	 * the bcm2836's per-cpu timers and mailboxes
+	 */
+	if(PHYSARMLOCAL != 0)
+		l1[L1X(ARMLOCAL)] = PHYSARMLOCAL|Dom0|L1AP(Krw)|Section;
+
 	/*
 	 * double map exception vectors at top of virtual memory
 	 */
@@ -54,13 +60,18 @@ mmuinit(void)
 	l2[L2X(va)] = PHYSDRAM|L2AP(Krw)|Small;
 }
 
+/*
+ * cpu0 uses L1; launchinit gives the others a copy of it,
+ * identity map and all.
+ */
 void
 mmuinit1(void)
 {
 	PTE *l1;
 
-	l1 = (PTE*)L1;
-	m->mmul1 = l1;
+	if(m->mmul1 == nil)
+		m->mmul1 = (PTE*)L1;
+	l1 = m->mmul1;
 
 	/*
 	 * undo identity map of first MB of ram
@@ -120,15 +131,26 @@ mmul1empty(void)
 void
 mmuswitch(Proc* proc)
 {
-	int x;
+	int x, i;
 	PTE *l1;
 	Page *page;
+	Mach *mm;
 
 	/* do kprocs get here and if so, do they need to? */
 	if(m->mmupid == proc->pid && !proc->newtlb)
 		return;
 	m->mmupid = proc->pid;
 
+	/*
+	 * proc's map will change here; the l1 of a cpu
+	 * it ran on before must be rebuilt if it goes back.
+	 */
+	for(i = 0; i < conf.nmach; i++){
+		mm = MACHP(i);
+		if(mm != m && mm->mmupid == proc->pid)
+			mm->mmupid = 0;
+	}
+
 	/* write back dirty and invalidate l1 caches */
 	cacheuwbinv();
 
@@ -185,8 +207,8 @@ mmurelease(Proc* proc)
 			panic("mmurelease: page->ref %d", page->ref);
 		pagechainhead(page);
 	}
-	if(proc->mmul2cache && palloc.r.p)
-		wakeup(&palloc.r);
+	if(proc->mmul2cache && palloc.pwait.head != nil)
+		sqwakeup(&palloc.pwait);
 	proc->mmul2cache = nil;
 
 	mmul1empty();
@@ -246,7 +268,7 @@ putmmu(uintptr va, uintptr pa, Page* page)
 	 */
 	x = Small;
 	if(!(pa & PTEUNCACHED))
-		x |= Cached|Buffered;
+		x |= soc.l2ptedramattrs;
 	if(pa & PTEWRITE)
 		x |= L2AP(Urw);
 	else
@@ -284,12 +306,16 @@ cankaddr(uintptr pa)
 	return 0;
 }
 
+/*
+ * kernel mappings go in every cpu's l1
+ */
 uintptr
 mmukmap(uintptr va, uintptr pa, usize size)
 {
-	int o;
+	int o, i;
 	usize n;
 	PTE *pte, *pte0;
+	Mach *mm;
 
 	assert((va & (MiB-1)) == 0);
 	o = pa & (MiB-1);
@@ -299,12 +325,17 @@ mmukmap(uintptr va, uintptr pa, usize size)
 	for(n = 0; n < size; n += MiB)
 		if(*pte++ != Fault)
 			return 0;
-	pte = pte0;
-	for(n = 0; n < size; n += MiB){
-		*pte++ = (pa+n)|Dom0|L1AP(Krw)|Section;
-		mmuinvalidateaddr(va+n);
+	for(i = 0; i < MAXMACH; i++){
+		mm = MACHP(i);
+		if(mm == nil || mm->mmul1 == nil)
+			continue;
+		pte = pte0 = &mm->mmul1[L1X(va)];
+		for(n = 0; n < size; n += MiB)
+			*pte++ = (pa+n)|Dom0|L1AP(Krw)|Section;
+		cachedwbse(pte0, (pte - pte0)*sizeof(PTE));
 	}
-	cachedwbse(pte0, pte - pte0);
+	for(n = 0; n < size; n += MiB)
+		mmuinvalidateaddr(va+n);
 	return va + o;
 }
 
@@ -1,5 +1,5 @@
 /*
- * armv6 reboot code
+ * armv6 and armv7 reboot code
  */
 #include "arm.s"
 
@@ -52,10 +52,12 @@ TEXT	main(SB), 1, $-4
  */
 TEXT cachesoff(SB), 1, $-4
 
-	/* write back and invalidate caches */
+	/*
+	 * reboot has written back the data caches (all levels);
+	 * there's no whole-cache writeback op on armv7.
+	 */
 	BARRIERS
 	MOVW	$0, R0
-	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEwbi), CpCACHEall
 	MCR	CpSC, 0, R0, C(CpCACHE), C(CpCACHEinvi), CpCACHEall
 
 	/* turn caches off */
@@ -77,14 +77,20 @@ trapinit(void)
 {
 	Vpage0 *vpage0;
 
-	/* disable everything */
-	intrsoff();
+	if(m->machno == 0){
+		/* disable everything */
+		intrsoff();
+
+		/* set up the exception vectors */
+		vpage0 = (Vpage0*)HVECTORS;
+		memmove(vpage0->vectors, vectors, sizeof(vpage0->vectors));
+		memmove(vpage0->vtable, vtable, sizeof(vpage0->vtable));
+		cacheuwbinv();
+	}
 
-	/* set up the exception vectors */
-	vpage0 = (Vpage0*)HVECTORS;
-	memmove(vpage0->vectors, vectors, sizeof(vpage0->vectors));
-	memmove(vpage0->vtable, vtable, sizeof(vpage0->vtable));
-	cacheuwbinv();
+	/* let other cpus interrupt this one */
+	if(PHYSARMLOCAL != 0)
+		((u32int*)ARMLOCAL)[Localmboxctl + m->machno] = 1;
 
 	/* set up the stacks for the interrupt modes */
 	setr13(PsrMfiq, (u32int*)(FIQSTKTOP));
@@ -110,17 +116,44 @@ intrsoff(void)
 	ip->FIQctl = 0;
 }
 
+/*
+ *  interrupt another cpu, to wake it from wfi
+ */
+void
+intrcpu(int cpu)
+{
+	if(PHYSARMLOCAL == 0)
+		return;
+	coherence();
+	((u32int*)ARMLOCAL)[Localmboxset + 4*cpu] = 1;
+}
+
 /*
  *  called by trap to handle irq interrupts.
  *  returns true iff a clock interrupt, thus maybe reschedule.
+ *  on the bcm2836 each cpu has its own timer and mailboxes,
+ *  and the gpu's interrupts all go to cpu0.
  */
 static int
 irq(Ureg* ureg)
 {
 	Vctl *v;
 	int clockintr;
+	u32int *local, src;
 
 	clockintr = 0;
+	if(PHYSARMLOCAL != 0){
+		local = (u32int*)ARMLOCAL;
+		src = local[Localirqsrc + m->machno];
+		if(src & Localmbox0)
+			local[Localmboxclr + 4*m->machno] = ~0;
+		if(src & Localcntv){
+			localclockintr(ureg);
+			clockintr = 1;
+		}
+		if((src & Localgpu) == 0)
+			return clockintr;
+	}
 	for(v = vctl; v; v = v->next)
 		if(*v->reg & v->mask){
 			coherence();
@@ -314,6 +347,9 @@ trap(Ureg *ureg)
 	case PsrMirq:
 		clockintr = irq(ureg);
 		m->intr++;
+		/* something readied here can run on an idle cpu */
+		if(active.wfi != 0 && anyready())
+			wakewfi();
 		break;
 	case PsrMabt:			/* prefetch fault */
 		x = ifsrget();
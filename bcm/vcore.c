@@ -114,7 +114,7 @@ vcreq(int tag, void *buf, int vallen, int rsplen)
 	uintptr r;
 	int n;
 	Prophdr *prop;
-	static uintptr base = BUSDRAM;
+	static uintptr base = ~0;	/* BUSDRAM isn't a constant */
 
 	if(rsplen < vallen)
 		rsplen = vallen;
@@ -130,6 +130,8 @@ vcreq(int tag, void *buf, int vallen, int rsplen)
 	if(vallen > 0)
 		memmove(prop->data, buf, vallen);
 	cachedwbinvse(prop, prop->len);
+	if(base == ~0)
+		base = BUSDRAM;
 	for(;;){
 		vcwrite(ChanProps, PADDR(prop) + base);
 		r = vcread(ChanProps);
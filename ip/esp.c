@@ -3,6 +3,7 @@
  * extended to IPv6.
  * rfc2104 defines hmac computation.
  *	currently only implements tunnel mode.
+ * rfc4106 defines aes-gcm in esp.
  * TODO: verify aes algorithms;
  *	transport mode (host-to-host)
  */
@@ -27,6 +28,7 @@ typedef struct Espcb Espcb;
 typedef struct Esphdr Esphdr;
 typedef struct Esppriv Esppriv;
 typedef struct Esptail Esptail;
+typedef struct Gcmstate Gcmstate;
 typedef struct Userhdr Userhdr;
 
 enum {
@@ -45,6 +47,12 @@ enum {
 
 	Aesblk	 = BITS2BYTES(128),
 	Aeskeysz = BITS2BYTES(128),
+
+	Gcmivlen = 8,
+	Gcmsaltsz = 4,
+	Gcmtaglen = 16,
+
+	Nspihash = 64,		/* incoming convs by spi */
 };
 
 struct Esphdr
@@ -116,6 +124,9 @@ struct Esppriv
 {
 	uvlong	in;
 	ulong	inerrors;
+
+	Lock;			/* spihash */
+	Conv	*spihash[Nspihash];
 };
 
 /*
@@ -126,6 +137,7 @@ struct Espcb
 	int	incoming;
 	int	header;		/* user-level header */
 	ulong	spi;
+	Conv	*spinext;	/* in Esppriv.spihash, when incoming */
 	ulong	seq;		/* last seq sent */
 	ulong	window;		/* for replay attacks */
 
@@ -159,11 +171,14 @@ static	void des3espinit(Espcb*, char*, uchar *key, unsigned keylen);
 static	void aescbcespinit(Espcb*, char*, uchar *key, unsigned keylen);
 static	void aesctrespinit(Espcb*, char*, uchar *key, unsigned keylen);
 static	void desespinit(Espcb *ecb, char *name, uchar *k, unsigned n);
+static	void aesgcmespinit(Espcb*, char*, uchar *key, unsigned keylen);
 
 static	void nullahinit(Espcb*, char*, uchar *key, unsigned keylen);
 static	void shaahinit(Espcb*, char*, uchar *key, unsigned keylen);
 static	void aesahinit(Espcb*, char*, uchar *key, unsigned keylen);
 static	void md5ahinit(Espcb*, char*, uchar *key, unsigned keylen);
+static	int aesgcmcipher(Espcb*, uchar*, int);
+static	int aesgcmauth(Espcb*, uchar*, int, uchar*);
 
 static Algorithm espalg[] =
 {
@@ -171,6 +186,7 @@ static Algorithm espalg[] =
 	"des3_cbc",	192,	des3espinit,	/* new rfc2451, des-ede3 */
 	"aes_128_cbc",	128,	aescbcespinit,	/* new rfc3602 */
 	"aes_ctr",	128,	aesctrespinit,	/* new rfc3686 */
+	"aes_128_gcm",	160,	aesgcmespinit,	/* rfc4106, 16-byte icv */
 	"des_56_cbc",	64,	desespinit,	/* rfc2405, deprecated */
 	/* rc4 was never required, was used in original bandt */
 //	"rc4_128",	128,	rc4espinit,
@@ -186,6 +202,46 @@ static Algorithm ahalg[] =
 	nil,		0,	nil,
 };
 
+/*
+ *  the spi hash holds incoming convs; change it with c->p qlocked.
+ */
+static void
+spihashin(Conv *c)
+{
+	Esppriv *ep;
+	Espcb *ecb;
+	Conv **l;
+
+	ep = c->p->priv;
+	ecb = c->ptcl;
+	lock(ep);
+	l = &ep->spihash[ecb->spi % Nspihash];
+	ecb->spinext = *l;
+	*l = c;
+	unlock(ep);
+}
+
+static void
+spihashout(Conv *c)
+{
+	Esppriv *ep;
+	Espcb *ecb;
+	Conv **l;
+
+	ep = c->p->priv;
+	ecb = c->ptcl;
+	if(!ecb->incoming)
+		return;
+	lock(ep);
+	for(l = &ep->spihash[ecb->spi % Nspihash]; *l != nil; l = &((Espcb*)(*l)->ptcl)->spinext)
+		if(*l == c){
+			*l = ecb->spinext;
+			break;
+		}
+	unlock(ep);
+	ecb->spinext = nil;
+}
+
 static char*
 espconnect(Conv *c, char **argv, int argc)
 {
@@ -209,6 +265,9 @@ espconnect(Conv *c, char **argv, int argc)
 			break;
 		}
 		findlocalip(c->p->f, c->laddr, c->raddr);
+		qlock(c->p);
+		spihashout(c);
+		qunlock(c->p);
 		ecb->incoming = 0;
 		ecb->seq = 0;
 		if(strcmp(p, "*") == 0) {
@@ -218,9 +277,10 @@ espconnect(Conv *c, char **argv, int argc)
 				if(convlookup(c->p, spi) == nil)
 					break;
 			}
-			qunlock(c->p);
 			ecb->spi = spi;
 			ecb->incoming = 1;
+			spihashin(c);
+			qunlock(c->p);
 			qhangup(c->wq, nil);
 		} else {
 			spi = strtoul(p, &pp, 10);
@@ -264,6 +324,10 @@ espclose(Conv *c)
 	ipmove(c->laddr, IPnoaddr);
 	ipmove(c->raddr, IPnoaddr);
 
+	qlock(c->p);
+	spihashout(c);
+	qunlock(c->p);
+
 	ecb = (Espcb*)c->ptcl;
 	free(ecb->espstate);
 	free(ecb->ahstate);
@@ -338,38 +402,26 @@ getpktspiaddrs(uchar *pkt, Versdep *vp)
 }
 
 /*
- * encapsulate next IP packet on x's write queue in IP/ESP packet
- * and initiate output of the result.
+ * encapsulate bp in an IP/ESP packet, called with c qlocked.
  */
-static void
-espkick(void *x)
+static Block*
+espencap(Conv *c, Block *bp, Versdep *vp)
 {
 	int nexthdr, payload, pad, align;
 	uchar *auth;
-	Block *bp;
-	Conv *c = x;
 	Esp4hdr *eh4;
 	Esp6hdr *eh6;
 	Espcb *ecb;
 	Esptail *et;
 	Userhdr *uh;
-	Versdep vers;
 
-	getverslens(convipvers(c), &vers);
-	bp = qget(c->wq);
-	if(bp == nil)
-		return;
-
-	qlock(c);
 	ecb = c->ptcl;
 
 	if(ecb->header) {
 		/* make sure the message has a User header */
 		bp = pullupblock(bp, Userhdrlen);
-		if(bp == nil) {
-			qunlock(c);
-			return;
-		}
+		if(bp == nil)
+			return nil;
 		uh = (Userhdr*)bp->rp;
 		nexthdr = uh->nexthdr;
 		bp->rp += Userhdrlen;
@@ -380,8 +432,8 @@ espkick(void *x)
 	payload = BLEN(bp) + ecb->espivlen;
 
 	/* Make space to fit ip header */
-	bp = padblock(bp, vers.hdrlen + ecb->espivlen);
-	getpktspiaddrs(bp->rp, &vers);
+	bp = padblock(bp, vp->hdrlen + ecb->espivlen);
+	getpktspiaddrs(bp->rp, vp);
 
 	align = 4;
 	if(ecb->espblklen > align)
@@ -398,18 +450,18 @@ espkick(void *x)
 	bp = padblock(bp, -(pad+Esptaillen+ecb->ahlen));
 	bp->wp += pad+Esptaillen+ecb->ahlen;
 
-	et = (Esptail*)(bp->rp + vers.hdrlen + payload + pad);
+	et = (Esptail*)(bp->rp + vp->hdrlen + payload + pad);
 
 	/* fill in tail */
 	et->pad = pad;
 	et->nexthdr = nexthdr;
 
 	/* encrypt the payload */
-	ecb->cipher(ecb, bp->rp + vers.hdrlen, payload + pad + Esptaillen);
-	auth = bp->rp + vers.hdrlen + payload + pad + Esptaillen;
+	ecb->cipher(ecb, bp->rp + vp->hdrlen, payload + pad + Esptaillen);
+	auth = bp->rp + vp->hdrlen + payload + pad + Esptaillen;
 
 	/* fill in head; construct a new IP header and an ESP header */
-	if (vers.version == V4) {
+	if (vp->version == V4) {
 		eh4 = (Esp4hdr *)bp->rp;
 		eh4->vihl = IP_VER4;
 		v6tov4(eh4->espsrc, c->laddr);
@@ -432,15 +484,46 @@ espkick(void *x)
 	}
 
 	/* compute secure hash */
-	ecb->auth(ecb, bp->rp + vers.iphdrlen, (vers.hdrlen - vers.iphdrlen) +
+	ecb->auth(ecb, bp->rp + vp->iphdrlen, (vp->hdrlen - vp->iphdrlen) +
 		payload + pad + Esptaillen, auth);
+	return bp;
+}
+
+/*
+ * encapsulate the IP packets on x's write queue in IP/ESP packets
+ * and initiate output of the results.  everything queued is taken
+ * under one acquisition of the Conv's qlock.
+ */
+static void
+espkick(void *x)
+{
+	Block *bp, *first, **l;
+	Conv *c = x;
+	Versdep vers;
+
+	getverslens(convipvers(c), &vers);
+	first = nil;
+	l = &first;
 
+	qlock(c);
+	while((bp = qget(c->wq)) != nil){
+		bp = espencap(c, bp, &vers);
+		if(bp == nil)
+			continue;
+		*l = bp;
+		l = &bp->list;
+	}
 	qunlock(c);
-	/* print("esp: pass down: %uld\n", BLEN(bp)); */
-	if (vers.version == V4)
-		ipoput4(c->p->f, bp, 0, c->ttl, c->tos, c);
-	else
-		ipoput6(c->p->f, bp, 0, c->ttl, c->tos, c);
+
+	while((bp = first) != nil){
+		first = bp->list;
+		bp->list = nil;
+		/* print("esp: pass down: %uld\n", BLEN(bp)); */
+		if (vers.version == V4)
+			ipoput4(c->p->f, bp, 0, c->ttl, c->tos, c);
+		else
+			ipoput6(c->p->f, bp, 0, c->ttl, c->tos, c);
+	}
 }
 
 /*
@@ -470,11 +553,9 @@ espiput(Proto *esp, Ipifc*, Block *bp)
 	}
 	getpktspiaddrs(bp->rp, &vers);
 
-	qlock(esp);
 	/* Look for a conversation structure for this port */
 	c = convlookup(esp, vers.spi);
 	if(c == nil) {
-		qunlock(esp);
 		netlog(f, Logesp, "esp: no conv %I -> %I!%lud\n", vers.raddr,
 			vers.laddr, vers.spi);
 		icmpnoconv(f, bp);
@@ -483,9 +564,15 @@ espiput(Proto *esp, Ipifc*, Block *bp)
 	}
 
 	qlock(c);
-	qunlock(esp);
-
 	ecb = c->ptcl;
+	/* closed or reconnected since the lookup */
+	if(!ecb->incoming || ecb->spi != vers.spi) {
+		qunlock(c);
+		netlog(f, Logesp, "esp: conv gone %I -> %I!%lud\n", vers.raddr,
+			vers.laddr, vers.spi);
+		freeblist(bp);
+		return;
+	}
 	/* too hard to do decryption/authentication on block lists */
 	if(bp->next)
 		bp = concatblock(bp);
@@ -574,10 +661,17 @@ espctl(Conv *c, char **f, int n)
 	Espcb *ecb = c->ptcl;
 	char *e = nil;
 
-	if(strcmp(f[0], "esp") == 0)
+	if(strcmp(f[0], "esp") == 0){
 		e = setalg(ecb, f, n, espalg);
-	else if(strcmp(f[0], "ah") == 0)
+		/* gcm's authenticator goes with it */
+		if(e == nil && ecb->auth == aesgcmauth && ecb->cipher != aesgcmcipher)
+			nullahinit(ecb, "null", nil, 0);
+	}
+	else if(strcmp(f[0], "ah") == 0){
+		if(ecb->auth == aesgcmauth)
+			return "esp algorithm does its own authentication";
 		e = setalg(ecb, f, n, ahalg);
+	}
 	else if(strcmp(f[0], "header") == 0)
 		ecb->header = 1;
 	else if(strcmp(f[0], "noheader") == 0)
@@ -651,16 +745,19 @@ espremote(Conv *c, char *buf, int len)
 static	Conv*
 convlookup(Proto *esp, ulong spi)
 {
-	Conv *c, **p;
+	Conv *c;
+	Esppriv *ep;
 	Espcb *ecb;
 
-	for(p=esp->conv; *p; p++){
-		c = *p;
+	ep = esp->priv;
+	lock(ep);
+	for(c = ep->spihash[spi % Nspihash]; c != nil; c = ecb->spinext){
 		ecb = c->ptcl;
-		if(ecb->incoming && ecb->spi == spi)
-			return c;
+		if(ecb->spi == spi)
+			break;
 	}
-	return nil;
+	unlock(ep);
+	return c;
 }
 
 static char *
@@ -951,6 +1048,214 @@ aesctrespinit(Espcb *ecb, char *name, uchar *k, unsigned n)
 }
 
 
+/*
+ * aes-gcm, rfc4106.  a combined mode: the cipher encrypts in counter
+ * mode and the auth function computes the ghash tag, so the esp
+ * algorithm sets both and there is no separate ah.  the 8-byte iv
+ * is a counter; the key is followed by a 4-byte salt.
+ */
+
+struct Gcmstate
+{
+	AESstate;
+	uchar	salt[Gcmsaltsz];
+	uvlong	iv;
+	uvlong	hh[16];		/* multiples of H, 4 bits at a time */
+	uvlong	hl[16];
+};
+
+static ushort gcmlast4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+static uvlong
+gcmget64(uchar *p)
+{
+	return (uvlong)nhgetl(p)<<32 | nhgetl(p+4);
+}
+
+static void
+gcmput64(uchar *p, uvlong v)
+{
+	hnputl(p, v>>32);
+	hnputl(p+4, v);
+}
+
+static void
+gcmtable(Gcmstate *gs)
+{
+	uchar h[AESbsize];
+	uvlong vh, vl;
+	ulong t;
+	int i, j;
+
+	memset(h, 0, sizeof h);
+	aes_encrypt(gs->ekey, gs->rounds, h, h);
+	vh = gcmget64(h);
+	vl = gcmget64(h+8);
+
+	gs->hh[0] = gs->hl[0] = 0;
+	gs->hh[8] = vh;
+	gs->hl[8] = vl;
+	for(i = 4; i > 0; i >>= 1){
+		t = (vl & 1) * 0xe1000000;
+		vl = vh<<63 | vl>>1;
+		vh = vh>>1 ^ (uvlong)t<<32;
+		gs->hh[i] = vh;
+		gs->hl[i] = vl;
+	}
+	for(i = 2; i <= 8; i *= 2){
+		vh = gs->hh[i];
+		vl = gs->hl[i];
+		for(j = 1; j < i; j++){
+			gs->hh[i+j] = vh ^ gs->hh[j];
+			gs->hl[i+j] = vl ^ gs->hl[j];
+		}
+	}
+}
+
+/* y = y*H */
+static void
+gcmmul(Gcmstate *gs, uchar *y)
+{
+	uvlong zh, zl;
+	int i, lo, hi, rem;
+
+	lo = y[15] & 0xf;
+	zh = gs->hh[lo];
+	zl = gs->hl[lo];
+	for(i = 15; i >= 0; i--){
+		lo = y[i] & 0xf;
+		hi = y[i] >> 4;
+		if(i != 15){
+			rem = zl & 0xf;
+			zl = zh<<60 | zl>>4;
+			zh = zh>>4 ^ (uvlong)gcmlast4[rem]<<48;
+			zh ^= gs->hh[lo];
+			zl ^= gs->hl[lo];
+		}
+		rem = zl & 0xf;
+		zl = zh<<60 | zl>>4;
+		zh = zh>>4 ^ (uvlong)gcmlast4[rem]<<48;
+		zh ^= gs->hh[hi];
+		zl ^= gs->hl[hi];
+	}
+	gcmput64(y, zh);
+	gcmput64(y+8, zl);
+}
+
+static void
+gcmghash(Gcmstate *gs, uchar *y, uchar *p, int n)
+{
+	int i, m;
+
+	for(; n > 0; n -= m){
+		m = n < AESbsize? n: AESbsize;
+		for(i = 0; i < m; i++)
+			y[i] ^= *p++;
+		gcmmul(gs, y);
+	}
+}
+
+/* the counter block for iv and block number ctr */
+static void
+gcmctr(Gcmstate *gs, uchar *blk, uchar *iv, ulong ctr)
+{
+	memmove(blk, gs->salt, Gcmsaltsz);
+	memmove(blk+Gcmsaltsz, iv, Gcmivlen);
+	hnputl(blk+Gcmsaltsz+Gcmivlen, ctr);
+}
+
+static int
+aesgcmcipher(Espcb *ecb, uchar *p, int n)
+{
+	uchar blk[AESbsize], ks[AESbsize];
+	uchar *iv, *ep;
+	Gcmstate *gs = ecb->espstate;
+	ulong ctr;
+	int i, m;
+
+	iv = p;
+	if(!ecb->incoming)
+		gcmput64(iv, gs->iv++);
+	ep = p + n;
+	ctr = 2;
+	for(p += Gcmivlen; p < ep; p += m){
+		gcmctr(gs, blk, iv, ctr++);
+		aes_encrypt(gs->ekey, gs->rounds, blk, ks);
+		m = ep - p;
+		if(m > AESbsize)
+			m = AESbsize;
+		for(i = 0; i < m; i++)
+			p[i] ^= ks[i];
+	}
+	return 1;
+}
+
+/*
+ *  t is the esp header, then the iv and the ciphertext;
+ *  the esp header is the additional authenticated data.
+ */
+static int
+aesgcmauth(Espcb *ecb, uchar *t, int tlen, uchar *auth)
+{
+	uchar y[AESbsize], blk[AESbsize], *iv;
+	Gcmstate *gs = ecb->espstate;
+	int i, r, clen;
+
+	iv = t + sizeof(Esphdr);
+	clen = tlen - sizeof(Esphdr) - Gcmivlen;
+	memset(y, 0, sizeof y);
+	gcmghash(gs, y, t, sizeof(Esphdr));
+	gcmghash(gs, y, iv + Gcmivlen, clen);
+	gcmput64(blk, BYTES2BITS((uvlong)sizeof(Esphdr)));
+	gcmput64(blk+8, BYTES2BITS((uvlong)clen));
+	gcmghash(gs, y, blk, AESbsize);
+
+	gcmctr(gs, blk, iv, 1);
+	aes_encrypt(gs->ekey, gs->rounds, blk, blk);
+	for(i = 0; i < AESbsize; i++)
+		y[i] ^= blk[i];
+
+	r = memcmp(auth, y, ecb->ahlen) == 0;
+	memmove(auth, y, ecb->ahlen);
+	return r;
+}
+
+static void
+aesgcmespinit(Espcb *ecb, char *name, uchar *k, unsigned n)
+{
+	uchar key[Aeskeysz], ivec[Aesblk];
+	Gcmstate *gs;
+
+	n = BITS2BYTES(n);
+	if(n != Aeskeysz + Gcmsaltsz)
+		panic("aesgcmespinit: bad keylen");
+	memmove(key, k, Aeskeysz);
+	memset(ivec, 0, sizeof ivec);
+	gs = smalloc(sizeof(Gcmstate));
+	setupAESstate(gs, key, Aeskeysz, ivec);
+	memmove(gs->salt, k + Aeskeysz, Gcmsaltsz);
+	gs->iv = (uvlong)nrand(1<<30)<<32;
+	gcmtable(gs);
+	memset(key, 0, sizeof key);
+
+	ecb->espalg = name;
+	ecb->espblklen = 4;
+	ecb->espivlen = Gcmivlen;
+	ecb->cipher = aesgcmcipher;
+	ecb->espstate = gs;
+
+	free(ecb->ahstate);
+	ecb->ahstate = nil;
+	ecb->ahalg = name;
+	ecb->ahblklen = 1;
+	ecb->ahlen = Gcmtaglen;
+	ecb->auth = aesgcmauth;
+}
+
+
 /*
  * md5
  */
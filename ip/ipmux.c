@@ -13,6 +13,11 @@
 
 typedef struct Ipmuxrock  Ipmuxrock;
 typedef struct Ipmux      Ipmux;
+typedef struct Ipmuxent   Ipmuxent;
+typedef struct Ipmuxop    Ipmuxop;
+typedef struct Ipmuxprog  Ipmuxprog;
+typedef struct Ipmuxpriv  Ipmuxpriv;
+typedef struct Ipmuxcc    Ipmuxcc;
 
 typedef struct Myip4hdr Myip4hdr;
 struct Myip4hdr
@@ -50,6 +55,8 @@ enum
 	Cmlong,		/* single long with mask */
 	Cifc,
 	Cmifc,
+
+	Nlinear	= 4,	/* values an op compares one by one */
 };
 
 char *ftname[] =
@@ -84,6 +91,45 @@ struct Ipmux
 	Conv	*conv;
 };
 
+/*
+ *  the tree compiled for ipmuxiput.  a run of nodes down a no
+ *  chain that look at the same bytes becomes one op: the packet
+ *  bytes are masked once and looked up among the run's values,
+ *  through a hash table when there are more than Nlinear.  the
+ *  ops point into the tree, so the program is rebuilt whenever
+ *  the tree changes.
+ */
+struct Ipmuxent
+{
+	uchar	*val;
+	int	alt;		/* index in op->alt */
+	int	next;		/* in the hash chain, -1 at the end */
+};
+
+struct Ipmuxop
+{
+	Ipmux	*f;		/* field, offset and mask of the run */
+	int	no;		/* op when nothing matches, -1 to stop */
+	int	nalt;
+	Ipmux	**alt;		/* the run's nodes, in tree order */
+	int	*yes;		/* op for each alt's yes side */
+	int	nhash;		/* 0 for a linear search */
+	int	*hash;
+	Ipmuxent *ent;
+};
+
+struct Ipmuxprog
+{
+	int	nop;
+	Ipmuxop	*op;
+};
+
+struct Ipmuxpriv
+{
+	Ipmux	*tree;
+	Ipmuxprog *prog;
+};
+
 /*
  *  someplace to hold per conversation data
  */
@@ -181,6 +227,8 @@ parseop(char **pp)
 			return nil;
 		p++;
 		len = end - off + 1;
+		if(len > 255)		/* fits f->len and ipmuxiput's key */
+			return nil;
 	}
 	else
 		return nil;
@@ -534,6 +582,154 @@ ipmuxremove(Ipmux **l, Ipmux *f)
 	return ipmuxremove(&ft->yes, f->yes);
 }
 
+static void
+ipmuxcount(Ipmux *f, int *nnode, int *nval)
+{
+	for(; f != nil; f = f->no){
+		(*nnode)++;
+		*nval += f->n;
+		ipmuxcount(f->yes, nnode, nval);
+	}
+}
+
+static ulong
+ipmuxhash(uchar *k, int n)
+{
+	ulong h;
+
+	h = 0;
+	while(n-- > 0)
+		h = h*31 + *k++;
+	return h;
+}
+
+/*
+ *  compiler state; the arrays are carved out of the program
+ *  as ops claim them.
+ */
+struct Ipmuxcc
+{
+	Ipmuxprog *p;
+	Ipmux	**alt;
+	int	*yes;
+	Ipmuxent *ent;
+	int	*hash;
+};
+
+static int
+ipmuxfind(Ipmuxop *op, uchar *key)
+{
+	Ipmuxent *e;
+	Ipmux *f;
+	uchar *v;
+	int i, len;
+
+	len = op->f->len;
+	if(op->nhash == 0){
+		for(i = 0; i < op->nalt; i++){
+			f = op->alt[i];
+			for(v = f->val; v < f->e; v += len)
+				if(memcmp(key, v, len) == 0)
+					return i;
+		}
+		return -1;
+	}
+	i = op->hash[ipmuxhash(key, len) & (op->nhash-1)];
+	for(; i >= 0; i = e->next){
+		e = &op->ent[i];
+		if(memcmp(key, e->val, len) == 0)
+			return e->alt;
+	}
+	return -1;
+}
+
+static int
+ipmuxcc(Ipmuxcc *cc, Ipmux *mux)
+{
+	Ipmuxop *op;
+	Ipmux *f;
+	Ipmuxent *e;
+	uchar *v;
+	int i, pc, nv, *h;
+
+	if(mux == nil)
+		return -1;
+
+	pc = cc->p->nop++;
+	op = &cc->p->op[pc];
+	op->f = mux;
+	op->alt = cc->alt;
+	op->yes = cc->yes;
+	op->nalt = 0;
+	nv = 0;
+	for(f = mux; f != nil && ipmuxcmp(f, mux) == 0; f = f->no){
+		op->alt[op->nalt++] = f;
+		nv += f->n;
+	}
+	cc->alt += op->nalt;
+	cc->yes += op->nalt;
+
+	op->nhash = 0;
+	if(nv > Nlinear){
+		for(op->nhash = 1; op->nhash < 2*nv; op->nhash <<= 1)
+			;
+		op->hash = cc->hash;
+		cc->hash += op->nhash;
+		for(i = 0; i < op->nhash; i++)
+			op->hash[i] = -1;
+		op->ent = cc->ent;
+		e = op->ent;
+		for(i = 0; i < op->nalt; i++){
+			for(v = op->alt[i]->val; v < op->alt[i]->e; v += mux->len){
+				/* the first node holding a value takes it */
+				if(ipmuxfind(op, v) >= 0)
+					continue;
+				h = &op->hash[ipmuxhash(v, mux->len) & (op->nhash-1)];
+				e->val = v;
+				e->alt = i;
+				e->next = *h;
+				*h = e - op->ent;
+				e++;
+			}
+		}
+		cc->ent = e;
+	}
+
+	op->no = ipmuxcc(cc, f);
+	for(i = 0; i < op->nalt; i++)
+		op->yes[i] = ipmuxcc(cc, op->alt[i]->yes);
+	return pc;
+}
+
+/*
+ *  recompile the tree, called wlocked
+ */
+static void
+ipmuxcompile(Ipmuxpriv *pr)
+{
+	int nnode, nval;
+	Ipmuxprog *p;
+	Ipmuxcc cc;
+
+	free(pr->prog);
+	pr->prog = nil;
+	if(pr->tree == nil)
+		return;
+
+	nnode = nval = 0;
+	ipmuxcount(pr->tree, &nnode, &nval);
+	p = smalloc(sizeof(Ipmuxprog) + nnode*(sizeof(Ipmuxop) + sizeof(Ipmux*) + sizeof(int))
+		+ nval*(sizeof(Ipmuxent) + 4*sizeof(int)));
+	p->op = (Ipmuxop*)&p[1];
+	cc.p = p;
+	cc.alt = (Ipmux**)&p->op[nnode];
+	cc.ent = (Ipmuxent*)&cc.alt[nnode];
+	cc.yes = (int*)&cc.ent[nval];
+	cc.hash = &cc.yes[nnode];
+	ipmuxcc(&cc, pr->tree);
+	pr->prog = p;
+}
+
 /*
  *  connection request is a semi separated list of filters
  *  e.g. proto=17;data[0:4]=11aa22bb;ifc=135.104.9.2&255.255.255.0
@@ -547,9 +743,11 @@ ipmuxconnect(Conv *c, char **argv, int argc)
 	char *field[10];
 	Ipmux *mux, *chain;
 	Ipmuxrock *r;
+	Ipmuxpriv *pr;
 	Fs *f;
 
 	f = c->p->f;
+	pr = f->ipmux->priv;
 
 	if(argc != 2)
 		return Ebadarg;
@@ -579,7 +777,8 @@ ipmuxconnect(Conv *c, char **argv, int argc)
 
 	/* add the chain to the protocol demultiplexor tree */
 	wlock(f);
-	f->ipmux->priv = ipmuxmerge(f->ipmux->priv, mux);
+	pr->tree = ipmuxmerge(pr->tree, mux);
+	ipmuxcompile(pr);
 	wunlock(f);
 
 	Fsconnected(c, nil);
@@ -616,9 +815,11 @@ static void
 ipmuxclose(Conv *c)
 {
 	Ipmuxrock *r;
+	Ipmuxpriv *pr;
 	Fs *f = c->p->f;
 
 	r = (Ipmuxrock*)(c->ptcl);
+	pr = c->p->priv;
 
 	qclose(c->rq);
 	qclose(c->wq);
@@ -629,7 +830,8 @@ ipmuxclose(Conv *c)
 	c->rport = 0;
 
 	wlock(f);
-	ipmuxremove(&(c->p->priv), r->chain);
+	ipmuxremove(&pr->tree, r->chain);
+	ipmuxcompile(pr);
 	wunlock(f);
 	ipmuxtreefree(r->chain);
 	r->chain = nil;
@@ -659,85 +861,54 @@ ipmuxkick(void *x)
 static void
 ipmuxiput(Proto *p, Ipifc *ifc, Block *bp)
 {
-	int len, hl;
+	int i, len, hl, o, pc;
 	Fs *f = p->f;
-	uchar *m, *h, *v, *e, *ve, *hp;
+	uchar *m, *hp, key[256];
 	Conv *c;
 	Ipmux *mux;
+	Ipmuxop *op;
+	Ipmuxprog *prog;
+	Ipmuxpriv *pr;
 	Myip4hdr *ip;
 	Ip6hdr *ip6;
 
 	ip = (Myip4hdr*)bp->rp;
 	hl = (ip->vihl&0x0F)<<2;
 
-	if(p->priv == nil)
+	pr = p->priv;
+	if(pr->prog == nil)
 		goto nomatch;
 
-	h = bp->rp;
 	len = BLEN(bp);
 
 	/* run the v4 filter */
 	rlock(f);
 	c = nil;
-	mux = f->ipmux->priv;
-	while(mux != nil){
-		if(mux->eoff > len){
-			mux = mux->no;
-			continue;
-		}
-		hp = h + mux->off + ((int)mux->skiphdr)*hl;
-		switch(mux->ctype){
-		case Cbyte:
-			if(*mux->val == *hp)
-				goto yes;
-			break;
-		case Cmbyte:
-			if((*hp & *mux->mask) == *mux->val)
-				goto yes;
-			break;
-		case Cshort:
-			if(*((ushort*)mux->val) == *(ushort*)hp)
-				goto yes;
-			break;
-		case Cmshort:
-			if((*(ushort*)hp & (*((ushort*)mux->mask))) == *((ushort*)mux->val))
-				goto yes;
-			break;
-		case Clong:
-			if(*((ulong*)mux->val) == *(ulong*)hp)
-				goto yes;
-			break;
-		case Cmlong:
-			if((*(ulong*)hp & (*((ulong*)mux->mask))) == *((ulong*)mux->val))
-				goto yes;
-			break;
-		case Cifc:
-			if(*((ulong*)mux->val) == *(ulong*)(ifc->lifc->local + IPv4off))
-				goto yes;
-			break;
-		case Cmifc:
-			if((*(ulong*)(ifc->lifc->local + IPv4off) & (*((ulong*)mux->mask))) == *((ulong*)mux->val))
-				goto yes;
-			break;
-		default:
-			v = mux->val;
-			for(e = mux->e; v < e; v = ve){
-				m = mux->mask;
-				hp = h + mux->off;
-				for(ve = v + mux->len; v < ve; v++){
-					if((*hp++ & *m++) != *v)
-						break;
-				}
-				if(v == ve)
-					goto yes;
+	prog = pr->prog;
+	for(pc = prog != nil? 0: -1; pc >= 0; ){
+		op = &prog->op[pc];
+		mux = op->f;
+		if(mux->type == Tifc)
+			hp = ifc->lifc->local + IPv4off;
+		else{
+			o = mux->off + ((int)mux->skiphdr)*hl;
+			if(o + mux->len > len){
+				pc = op->no;
+				continue;
 			}
+			hp = bp->rp + o;
+		}
+		m = mux->mask;
+		for(i = 0; i < mux->len; i++)
+			key[i] = hp[i] & m[i];
+		i = ipmuxfind(op, key);
+		if(i < 0){
+			pc = op->no;
+			continue;
 		}
-		mux = mux->no;
-		continue;
-yes:
-		if(mux->conv != nil)
-			c = mux->conv;
-		mux = mux->yes;
+		if(op->alt[i]->conv != nil)
+			c = op->alt[i]->conv;
+		pc = op->yes[i];
 	}
 	runlock(f);
 
@@ -807,7 +978,7 @@ ipmuxstats(Proto *p, char *buf, int len)
 	Fs *f = p->f;
 
 	rlock(f);
-	n = ipmuxsprint(p->priv, 0, buf, len);
+	n = ipmuxsprint(((Ipmuxpriv*)p->priv)->tree, 0, buf, len);
 	runlock(f);
 
 	return n;
@@ -819,7 +990,7 @@ ipmuxinit(Fs *f)
 	Proto *ipmux;
 
 	ipmux = smalloc(sizeof(Proto));
-	ipmux->priv = nil;
+	ipmux->priv = smalloc(sizeof(Ipmuxpriv));
 	ipmux->name = "ipmux";
 	ipmux->connect = ipmuxconnect;
 	ipmux->announce = ipmuxannounce;
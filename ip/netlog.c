@@ -11,22 +11,23 @@ enum {
 };
 
 /*
- *  action log
+ *  action log, a ring for each processor so that
+ *  logging doesn't serialise the protocols.
+ *  the rings stay once made: netlog doesn't lock.
  */
 struct Netlog {
 	Lock;
 	int	opens;
-	char*	buf;
-	char	*end;
-	char	*rptr;
-	int	len;
+	Logring	*ring;
+	int	nring;
+	ulong	*rd;				/* reader's place in each ring */
 
 	int	logmask;			/* mask of things to debug */
 	uchar	iponly[IPaddrlen];		/* ip address to print debugging for */
 	int	iponlyset;
 
 	QLock;
-	Rendez;
+	Rendez	r;
 };
 
 typedef struct Netlogflag {
@@ -77,92 +78,90 @@ netloginit(Fs *f)
 void
 netlogopen(Fs *f)
 {
-	lock(f->alog);
-	if(waserror()){
-		unlock(f->alog);
-		nexterror();
-	}
-	if(f->alog->opens == 0){
-		if(f->alog->buf == nil)
-			f->alog->buf = malloc(Nlog);
-		if(f->alog->buf == nil)
-			error(Enomem);
-		f->alog->rptr = f->alog->buf;
-		f->alog->end = f->alog->buf + Nlog;
+	Netlog *l;
+	Logring *ring;
+	ulong *rd;
+	int i, n;
+
+	l = f->alog;
+	if(l->ring == nil){
+		n = conf.nmach;
+		ring = smalloc(n*sizeof(Logring));
+		rd = smalloc(n*sizeof(ulong));
+		for(i = 0; i < n; i++){
+			ring[i].buf = malloc(Nlog);
+			if(ring[i].buf == nil){
+				while(--i >= 0)
+					free(ring[i].buf);
+				free(ring);
+				free(rd);
+				error(Enomem);
+			}
+			ring[i].size = Nlog;
+		}
+		lock(l);
+		if(l->ring == nil){
+			l->rd = rd;
+			l->nring = n;
+			coherence();
+			l->ring = ring;
+			ring = nil;
+		}
+		unlock(l);
+		if(ring != nil){
+			for(i = 0; i < n; i++)
+				free(ring[i].buf);
+			free(ring);
+			free(rd);
+		}
 	}
-	f->alog->opens++;
-	unlock(f->alog);
-	poperror();
+	lock(l);
+	if(l->opens == 0)
+		for(i = 0; i < l->nring; i++)
+			l->rd[i] = l->ring[i].head;
+	l->opens++;
+	unlock(l);
 }
 
 void
 netlogclose(Fs *f)
 {
 	lock(f->alog);
-	if(waserror()){
-		unlock(f->alog);
-		nexterror();
-	}
 	f->alog->opens--;
-	if(f->alog->opens == 0){
-		free(f->alog->buf);
-		f->alog->buf = nil;
-	}
 	unlock(f->alog);
-	poperror();
 }
 
 static int
 netlogready(void *a)
 {
-	Fs *f = a;
-
-	return f->alog->len;
+	Netlog *l;
+	int i;
+
+	l = a;
+	for(i = 0; i < l->nring; i++)
+		if(l->ring[i].head != l->rd[i])
+			return 1;
+	return 0;
 }
 
 long
 netlogread(Fs *f, void *a, ulong, long n)
 {
-	int i, d;
-	char *p, *rptr;
+	Netlog *l;
+	long k;
 
-	qlock(f->alog);
+	l = f->alog;
+	qlock(l);
 	if(waserror()){
-		qunlock(f->alog);
+		qunlock(l);
 		nexterror();
 	}
-
-	for(;;){
-		lock(f->alog);
-		if(f->alog->len){
-			if(n > f->alog->len)
-				n = f->alog->len;
-			d = 0;
-			rptr = f->alog->rptr;
-			f->alog->rptr += n;
-			if(f->alog->rptr >= f->alog->end){
-				d = f->alog->rptr - f->alog->end;
-				f->alog->rptr = f->alog->buf + d;
-			}
-			f->alog->len -= n;
-			unlock(f->alog);
-
-			i = n-d;
-			p = a;
-			memmove(p, rptr, i);
-			memmove(p+i, f->alog->buf, d);
-			break;
-		}
-		else
-			unlock(f->alog);
-
-		sleep(f->alog, netlogready, f);
-	}
-
-	qunlock(f->alog);
+	while((k = logringread(l->ring, l->nring, l->rd, a, n)) == 0)
+		sleep(&l->r, netlogready, l);
+	qunlock(l);
 	poperror();
 
-	return n;
+	return k;
 }
 
 void
@@ -228,37 +227,25 @@ netlogctl(Fs *f, char* s, int n)
 void
 netlog(Fs *f, int mask, char *fmt, ...)
 {
-	char buf[256], *t, *fp;
-	int i, n;
+	char buf[256];
+	int n, s;
 	va_list arg;
+	Netlog *l;
 
-	if(!(f->alog->logmask & mask))
+	l = f->alog;
+	if(!(l->logmask & mask))
 		return;
 
-	if(f->alog->opens == 0)
+	if(l->opens == 0 || l->ring == nil)
 		return;
 
 	va_start(arg, fmt);
 	n = vseprint(buf, buf+sizeof(buf), fmt, arg) - buf;
 	va_end(arg);
 
-	lock(f->alog);
-	i = f->alog->len + n - Nlog;
-	if(i > 0){
-		f->alog->len -= i;
-		f->alog->rptr += i;
-		if(f->alog->rptr >= f->alog->end)
-			f->alog->rptr = f->alog->buf + (f->alog->rptr - f->alog->end);
-	}
-	t = f->alog->rptr + f->alog->len;
-	fp = buf;
-	f->alog->len += n;
-	while(n-- > 0){
-		if(t >= f->alog->end)
-			t = f->alog->buf + (t - f->alog->end);
-		*t++ = *fp++;
-	}
-	unlock(f->alog);
+	s = splhi();
+	logringput(&l->ring[m->machno], buf, n);
+	splx(s);
 
-	wakeup(f->alog);
+	wakeup(&l->r);
 }
@@ -445,6 +445,7 @@ tcpsetstate(Conv *s, uchar newstate)
 	oldstate = tcb->state;
 	if(oldstate == newstate)
 		return;
+	TRACEPT(TPtcpstate, (uintptr)s, oldstate, newstate);
 
 	if(oldstate == Established)
 		tpriv->stats[CurrEstab]--;
@@ -2922,6 +2923,7 @@ tcprxmit(Conv *s)
 
 	tcb = (Tcpctl*)s->ptcl;
 	tcb->flags |= RETRAN|FORCE;
+	TRACEPT(TPtcprexmit, (uintptr)s, tcb->snd.una, tcb->snd.nxt - tcb->snd.una);
 
 	tptr = tcb->snd.ptr;
 	tcwind = tcb->cwind;
@@ -28,11 +28,13 @@
 
 enum {
 	Nrx		= 512,
-	Ntx		= 32,
-	Nrxblks		= 1024,
+	Ntx		= 128,
+	Nrxblks		= 1024,		/* rx pool's initial blocks */
+	Maxrxblks	= 4*Nrxblks,	/* most free blocks a pool keeps */
 	Rxblklen	= 2+1522,  /* ifc. supplies first 2 bytes as padding */
 
 	Maxrxintrsec	= 20*1000,	/* max. rx intrs. / sec */
+	Maxtxintrsec	= 10*1000,	/* max. tx intrs. / sec */
 	Etherstuck	= 70,	/* must send or receive a packet in this many sec.s */
 
 	Descralign	= 16,
@@ -41,18 +43,30 @@ enum {
 	Pass		= 1,		/* accept packets */
 
 	Qno		= 0,		/* do everything on queue zero */
+	Nport		= 2,
 };
 
 typedef struct Ctlr Ctlr;
 typedef struct Gbereg Gbereg;
 typedef struct Mibstats Mibstats;
 typedef struct Rx Rx;
+typedef struct Rxpool Rxpool;
 typedef struct Tx Tx;
 
-static struct {
+/*
+ * receive buffers for a queue.  when the free list runs dry,
+ * blocks are borrowed from iallocb and the limit on free blocks
+ * kept grows; rxpooltrim shrinks it again once input is idle.
+ */
+struct Rxpool {
 	Lock;
 	Block	*head;
-} freeblocks;
+	int	nfree;		/* blocks on head */
+	int	limit;		/* more free than this go back to the allocator */
+	int	dry;		/* borrowed since the last trim */
+	ulong	borrowed;
+	ulong	returned;
+};
 
 /* hardware receive buffer descriptor */
 struct Rx {
@@ -131,6 +145,7 @@ struct Ctlr {
 
 	Rx	*rx;		/* receive descriptors */
 	Block	*rxb[Nrx];	/* blocks belonging to the descriptors */
+	Rxpool	rxpool;		/* for queue Qno */
 	int	rxhead;		/* descr ethernet will write to next */
 	int	rxtail;		/* next descr that might need a buffer */
 	Rendez	rrendez;	/* interrupt wakes up read process */
@@ -282,7 +297,7 @@ enum {
 	IEsum		= 1<<31,
 
 	/* tx fifo urgent threshold (tx interrupt coalescing), pxtfut */
-#define TFUTipginttx(v)	(((v) & MASK(16))<<4);
+#define TFUTipginttx(v)	(((v) & MASK(16))<<4)
 
 	/* minimal frame size, mfs */
 	MFS40by	= 10<<2,
@@ -482,37 +497,116 @@ static uchar zeroea[Eaddrlen];
 static void getmibstats(Ctlr *);
 
 static void
-rxfreeb(Block *b)
+rxblkinit(Block *b)
 {
-	/* freeb(b) will have previously decremented b->ref to 0; raise to 1 */
-	_xinc(&b->ref);
 	b->wp = b->rp =
 		(uchar*)((uintptr)(b->lim - Rxblklen) & ~(Bufalign - 1));
 	assert(((uintptr)b->rp & (Bufalign - 1)) == 0);
-	b->free = rxfreeb;
+	b->next = nil;
+}
+
+static void
+rxpoolput(Rxpool *pool, Block *b, void (*free)(Block*))
+{
+	/* freeb(b) will have previously decremented b->ref to 0; raise to 1 */
+	_xinc(&b->ref);
+	ilock(pool);
+	if(pool->nfree >= pool->limit) {
+		pool->returned++;
+		iunlock(pool);
+		b->free = nil;
+		freeb(b);
+		return;
+	}
+	rxblkinit(b);
+	b->free = free;
+	b->next = pool->head;
+	pool->head = b;
+	pool->nfree++;
+	iunlock(pool);
+}
+
+/* a free routine per port, since a Block can't say whose it is */
+static void
+rxfreeb0(Block *b)
+{
+	rxpoolput(&ctlrs[0]->rxpool, b, rxfreeb0);
+}
 
-	ilock(&freeblocks);
-	b->next = freeblocks.head;
-	freeblocks.head = b;
-	iunlock(&freeblocks);
+static void
+rxfreeb1(Block *b)
+{
+	rxpoolput(&ctlrs[1]->rxpool, b, rxfreeb1);
 }
 
+static void (*rxfreeb[Nport])(Block*) = {
+	rxfreeb0,
+	rxfreeb1,
+};
+
 static Block *
-rxallocb(void)
+rxallocb(Ctlr *ctlr)
 {
 	Block *b;
+	Rxpool *pool;
 
-	ilock(&freeblocks);
-	b = freeblocks.head;
+	pool = &ctlr->rxpool;
+	ilock(pool);
+	b = pool->head;
 	if(b != nil) {
-		freeblocks.head = b->next;
+		pool->head = b->next;
+		pool->nfree--;
+		iunlock(pool);
 		b->next = nil;
-		b->free = rxfreeb;
+		return b;
 	}
-	iunlock(&freeblocks);
+	pool->borrowed++;
+	pool->dry = 1;
+	if(pool->limit < Maxrxblks)
+		pool->limit++;
+	iunlock(pool);
+
+	b = iallocb(Rxblklen+Bufalign-1);
+	if(b == nil)
+		return nil;
+	rxblkinit(b);
+	b->free = rxfreeb[ctlr->port];
 	return b;
 }
 
+/*
+ * called when input is idle: if the pool didn't run dry since
+ * the last call, let the limit decay and give back the excess.
+ */
+static void
+rxpooltrim(Rxpool *pool)
+{
+	Block *b, *l;
+
+	l = nil;
+	ilock(pool);
+	if(!pool->dry && pool->limit > Nrxblks) {
+		pool->limit -= (pool->limit - Nrxblks + 3) / 4;
+		while(pool->nfree > pool->limit) {
+			b = pool->head;
+			pool->head = b->next;
+			pool->nfree--;
+			pool->returned++;
+			b->next = l;
+			l = b;
+		}
+	}
+	pool->dry = 0;
+	iunlock(pool);
+
+	for(; l != nil; l = b) {
+		b = l->next;
+		l->next = nil;
+		l->free = nil;
+		freeb(l);
+	}
+}
+
 static void
 rxkick(Ctlr *ctlr)
 {
@@ -544,7 +638,7 @@ rxreplenish(Ctlr *ctlr)
 	Block *b;
 
 	while(ctlr->rxb[ctlr->rxtail] == nil) {
-		b = rxallocb();
+		b = rxallocb(ctlr);
 		if(b == nil) {
 			iprint("#l%d: rxreplenish out of buffers\n",
 				ctlr->ether->ctlrno);
@@ -784,8 +878,10 @@ rcvproc(void* arg)
 			ctlr->haveinput = 0;
 			iunlock(ctlr);
 			receive(ether);
-		} else
+		} else {
 			iunlock(ctlr);
+			rxpooltrim(&ctlr->rxpool);
+		}
 	}
 }
 
@@ -1403,8 +1499,10 @@ ctlralloc(Ctlr *ctlr)
 	Block *b;
 	Rx *r;
 	Tx *t;
+	Rxpool *pool;
 
-	ilock(&freeblocks);
+	pool = &ctlr->rxpool;
+	pool->limit = Nrxblks;
 	for(i = 0; i < Nrxblks; i++) {
 		b = iallocb(Rxblklen+Bufalign-1);
 		if(b == nil) {
@@ -1412,14 +1510,14 @@ ctlralloc(Ctlr *ctlr)
 			break;
 		}
 		assert(b->ref == 1);
-		b->wp = b->rp = (uchar*)
-			((uintptr)(b->lim - Rxblklen) & ~(Bufalign - 1));
-		assert(((uintptr)b->rp & (Bufalign - 1)) == 0);
-		b->free = rxfreeb;
-		b->next = freeblocks.head;
-		freeblocks.head = b;
+		rxblkinit(b);
+		b->free = rxfreeb[ctlr->port];
+		ilock(pool);
+		b->next = pool->head;
+		pool->head = b;
+		pool->nfree++;
+		iunlock(pool);
 	}
-	iunlock(&freeblocks);
 
 	/*
 	 * allocate uncached rx ring descriptors because rings are shared
@@ -1491,10 +1589,13 @@ ctlrinit(Ether *ether)
 	if (CLOCKFREQ/(Maxrxintrsec*64) >= (1<<16))
 		panic("rx coalescing value %d too big for short",
 			CLOCKFREQ/(Maxrxintrsec*64));
+	if (CLOCKFREQ/(Maxtxintrsec*64) >= (1<<16))
+		panic("tx coalescing value %d too big for short",
+			CLOCKFREQ/(Maxtxintrsec*64));
 	reg->sdc = SDCrifb | SDCrxburst(Burst16) | SDCtxburst(Burst16) |
 		SDCrxnobyteswap | SDCtxnobyteswap |
 		SDCipgintrx(CLOCKFREQ/(Maxrxintrsec*64));
-	reg->pxtfut = 0;	/* TFUTipginttx(CLOCKFREQ/(Maxrxintrsec*64)) */
+	reg->pxtfut = TFUTipginttx(CLOCKFREQ/(Maxtxintrsec*64));
 
 	/* allow just these interrupts */
 	/* guruplug generates Irxerr interrupts continually */
@@ -1632,6 +1733,10 @@ ifstat(Ether *ether, void *a, long n, ulong off)
 	p = seprint(p, e, "rx discarded frames: %lud\n", ctlr->rxdiscard);
 	p = seprint(p, e, "rx overrun frames: %lud\n", ctlr->rxoverrun);
 	p = seprint(p, e, "no first+last flag: %lud\n", ctlr->nofirstlast);
+	p = seprint(p, e, "rx pool free: %d limit %d\n",
+		ctlr->rxpool.nfree, ctlr->rxpool.limit);
+	p = seprint(p, e, "rx pool borrowed: %lud returned %lud\n",
+		ctlr->rxpool.borrowed, ctlr->rxpool.returned);
 
 	p = seprint(p, e, "duplex: %s\n", (reg->ps0 & PS0fd)? "full": "half");
 	p = seprint(p, e, "flow control: %s\n", (reg->ps0 & PS0flctl)? "on": "off");
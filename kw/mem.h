@@ -81,7 +81,7 @@
 /*
  * Legacy...
  */
-#define BLOCKALIGN	32			/* only used in allocb.c */
+#define BLOCKALIGN	32			/* allocb.c and rbpool.c */
 #define KSTACK		KSTKSIZE
 
 /*
@@ -264,8 +264,8 @@ mmurelease(Proc* proc)
 			panic("mmurelease: page->ref %d", page->ref);
 		pagechainhead(page);
 	}
-	if(proc->mmul2cache && palloc.r.p)
-		wakeup(&palloc.r);
+	if(proc->mmul2cache && palloc.pwait.head != nil)
+		sqwakeup(&palloc.pwait);
 	proc->mmul2cache = nil;
 
 	mmul1empty();
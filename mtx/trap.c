@@ -633,6 +633,7 @@ syscall(Ureg* ureg)
 
 	scallnr = ureg->r3;
 	up->scallnr = ureg->r3;
+	statsyscall(ureg->r3);
 	spllo();
 
 	sp = ureg->usp;
@@ -207,6 +207,7 @@ syscall(Ureg* ureg)
 
 	scallnr = ureg->r0;
 	up->scallnr = scallnr;
+	statsyscall(scallnr);
 	if(scallnr == RFORK)
 		fpusysrfork(ureg);
 	spllo();
@@ -241,10 +241,13 @@ lapicinit(Apic* apic)
 	 */
 }
 
+/*
+ * the caller waits 10ms between the INIT and the STARTUPs;
+ * split so one wait can serve every processor.
+ */
 void
-lapicstartap(Apic* apic, int v)
+lapicinitap(Apic* apic)
 {
-	int i;
 	ulong crhi;
 
 	/* make apic's processor do a warm reset */
@@ -253,8 +256,15 @@ lapicstartap(Apic* apic, int v)
 	lapicw(LapicICRLO, LapicFIELD|ApicLEVEL|LapicASSERT|ApicINIT);
 	microdelay(200);
 	lapicw(LapicICRLO, LapicFIELD|ApicLEVEL|LapicDEASSERT|ApicINIT);
-	delay(10);
+}
+
+void
+lapicstartap(Apic* apic, int v)
+{
+	int i;
+	ulong crhi;
 
+	crhi = apic->apicno<<24;
 	/* assumes apic is not an 82489dx */
 	for(i = 0; i < 2; i++){
 		lapicw(LapicICRHI, crhi);
@@ -26,6 +26,9 @@ PCArch archmp = {
 .reset=		mpshutdown,
 .intrinit=	mpinit,
 .intrenable=	mpintrenable,
+.msienable=	mpmsienable,
+.msidisable=	mpmsidisable,
+.intrassign=	mpintrassign,
 .intron=	lapicintron,
 .introff=	lapicintroff,
 .fastclock=	i8253read,
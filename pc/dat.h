@@ -295,6 +295,9 @@ struct PCArch
 
 	void	(*intrinit)(void);
 	int	(*intrenable)(Vctl*);
+	int	(*msienable)(Vctl*);
+	void	(*msidisable)(Vctl*);
+	int	(*intrassign)(Vctl*, int);
 	int	(*intrvecno)(int);
 	int	(*intrdisable)(int);
 	void	(*introff)(void);
@@ -321,6 +324,7 @@ enum {
 	Cpuapic	= 1<<9,
 	Mtrr	= 1<<12,	/* memory-type range regs.  */
 	Pge	= 1<<13,	/* page global extension */
+	Pat	= 1<<16,	/* page attribute table */
 	Pse2	= 1<<17,	/* more page size extensions */
 	Clflush = 1<<19,
 	Mmx	= 1<<23,
@@ -35,7 +35,7 @@ enum {
 	Qiol,
 	Qbase,
 
-	Qmax = 16,
+	Qmax = 32,
 };
 
 enum {
@@ -853,6 +853,14 @@ cpuidentify(void)
 		fprestore = fpx87restore;
 	}
 
+	/*
+	 * keep the power-on page attribute table but for
+	 * entry 5 (PTEPAT|PTEWT), which becomes write combining
+	 * for frame buffers; see mmu.c:/^vmapwc.
+	 */
+	if(m->cpuiddx & Pat)
+		wrmsr(0x277, 0x0007010600070406LL);
+
 	cputype = t;
 	return t->family;
 }
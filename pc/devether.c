@@ -375,6 +375,7 @@ etherprobe(int cardno, int ctlrno)
 	int i, lg;
 	ulong mb, bsz;
 	Ether *ether;
+	Pcidev *pcidev;
 	char buf[128], name[32];
 
 	ether = malloc(sizeof(Ether));
@@ -428,8 +429,14 @@ etherprobe(int cardno, int ctlrno)
 	 * If ether->irq is <0, it is a hack to indicate no interrupt
 	 * used by ethersink.
 	 */
-	if(ether->irq >= 0)
-		intrenable(ether->irq, ether->interrupt, ether, ether->tbdf, name);
+	if(ether->irq >= 0){
+		pcidev = nil;
+		if(ether->msi)
+			pcidev = pcimatchtbdf(ether->tbdf);
+		if(pcidev == nil ||
+		   intrenablemsi(pcidev, -1, -1, ether->interrupt, ether, name) == -1)
+			intrenable(ether->irq, ether->interrupt, ether, ether->tbdf, name);
+	}
 
 	i = sprint(buf, "#l%d: %s: ", ctlrno, cards[cardno].type);
 	if(ether->mbps >= 1000)
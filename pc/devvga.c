@@ -42,6 +42,7 @@ enum {
 	CMlinear,
 	CMpalettedepth,
 	CMpanning,
+	CMshadow,
 	CMsize,
 	CMtextmode,
 	CMtype,
@@ -59,6 +60,7 @@ static Cmdtab vgactlmsg[] = {
 	CMlinear,	"linear",	0,
 	CMpalettedepth,	"palettedepth",	2,
 	CMpanning,	"panning",	2,
+	CMshadow,	"shadow",	2,
 	CMsize,		"size",		3,
 	CMtextmode,	"textmode",	1,
 	CMtype,		"type",		2,
@@ -201,6 +203,7 @@ vgaread(Chan* c, void* a, long n, vlong off)
 		len += snprint(p+len, READSTR-len, "hwaccel %s\n", hwaccel ? "on" : "off");
 		len += snprint(p+len, READSTR-len, "hwblank %s\n", hwblank ? "on" : "off");
 		len += snprint(p+len, READSTR-len, "panning %s\n", panning ? "on" : "off");
+		len += snprint(p+len, READSTR-len, "shadow %s\n", shadow ? "on" : "off");
 		len += snprint(p+len, READSTR-len, "addr p 0x%lux v 0x%p size 0x%ux\n", scr->paddr, scr->vaddr, scr->apsize);
 		USED(len);
 
@@ -413,6 +416,16 @@ vgactl(Cmdbuf *cb)
 			break;
 		return;
 	
+	case CMshadow:
+		/* takes effect at the next size */
+		if(strcmp(cb->f[1], "on") == 0)
+			shadow = 1;
+		else if(strcmp(cb->f[1], "off") == 0)
+			shadow = 0;
+		else
+			break;
+		return;
+
 	case CMhwblank:
 		if(strcmp(cb->f[1], "on") == 0)
 			hwblank = 1;
@@ -479,6 +479,7 @@ struct Ctlr {
 	int	ntd;
 	int	nrb;			/* # bufs this Ctlr has in the pool */
 	unsigned rbsz;			/* unsigned for % and / by 1024 */
+	Rbpool*	pool;			/* receive Blocks, shared by size */
 
 	int	*nic;
 	Lock	imlock;
@@ -532,9 +533,6 @@ struct Ctlr {
 static Ctlr* i82563ctlrhead;
 static Ctlr* i82563ctlrtail;
 
-static Lock i82563rblock;		/* free receive Blocks */
-static Block* i82563rbpool;
-
 static char* statistics[] = {
 	"CRC Error",
 	"Alignment Error",
@@ -791,33 +789,6 @@ i82563multicast(void* arg, uchar* addr, int on)
 	csr32w(ctlr, Mta+x*4, ctlr->mta[x]);
 }
 
-static Block*
-i82563rballoc(void)
-{
-	Block *bp;
-
-	ilock(&i82563rblock);
-	if((bp = i82563rbpool) != nil){
-		i82563rbpool = bp->next;
-		bp->next = nil;
-		_xinc(&bp->ref);	/* prevent bp from being freed */
-	}
-	iunlock(&i82563rblock);
-
-	return bp;
-}
-
-static void
-i82563rbfree(Block* b)
-{
-	b->rp = b->wp = (uchar*)PGROUND((uintptr)b->base);
- 	b->flag &= ~(Bipck | Budpck | Btcpck | Bpktck);
-	ilock(&i82563rblock);
-	b->next = i82563rbpool;
-	i82563rbpool = b;
-	iunlock(&i82563rblock);
-}
-
 static void
 i82563im(Ctlr* ctlr, int im)
 {
@@ -945,7 +916,7 @@ i82563replenish(Ctlr* ctlr)
 			iprint("#l%d: 82563: rx overrun\n", ctlr->edev->ctlrno);
 			break;
 		}
-		bp = i82563rballoc();
+		bp = rbpoolalloc(ctlr->pool);
 		if(bp == nil){
 			vlong now;
 			static vlong lasttime;
@@ -1255,7 +1226,6 @@ i82563tproc(void *v)
 static void
 i82563attach(Ether* edev)
 {
-	Block *bp;
 	Ctlr *ctlr;
 	char name[KNAMELEN];
 
@@ -1269,13 +1239,11 @@ i82563attach(Ether* edev)
 	ctlr->nrd = Nrd;
 	ctlr->ntd = Ntd;
 
+	ctlr->nrb = 0;
 	if(waserror()){
-		while(ctlr->nrb > 0){
-			bp = i82563rballoc();
-			bp->free = nil;
-			freeb(bp);
-			ctlr->nrb--;
-		}
+		if(ctlr->nrb > 0)
+			rbpoolshrink(ctlr->pool, ctlr->nrb);
+		ctlr->nrb = 0;
 		free(ctlr->tb);
 		ctlr->tb = nil;
 		free(ctlr->rb);
@@ -1294,12 +1262,8 @@ i82563attach(Ether* edev)
 	   (ctlr->tb = malloc(ctlr->ntd*sizeof(Block*))) == nil)
 		error(Enomem);
 
-	for(ctlr->nrb = 0; ctlr->nrb < Nrb; ctlr->nrb++){
-		if((bp = allocb(ctlr->rbsz + BY2PG)) == nil)
-			error(Enomem);
-		bp->free = i82563rbfree;
-		freeb(bp);
-	}
+	ctlr->pool = rbpoolget(ctlr->rbsz, Nrb);
+	ctlr->nrb = Nrb;
 
 	ctlr->edev = edev;			/* point back to Ether* */
 	ctlr->attached = 1;
@@ -309,6 +309,7 @@ struct Ctlr {
 	int	ntd;
 	int	nrb;			/* # bufs this Ctlr has in the pool */
 	uint	rbsz;
+	Rbpool	*pool;			/* receive Blocks, shared by size */
 	int	procsrunning;
 	int	attached;
 
@@ -348,8 +349,6 @@ enum {
 
 static	Ctlr	*ctlrtab[4];
 static	int	nctlr;
-static	Lock	rblock;
-static	Block	*rbpool;
 
 static void
 readstats(Ctlr *c)
@@ -442,32 +441,6 @@ ctl(Ether *, void *, long)
 	return -1;
 }
 
-static Block*
-rballoc(void)
-{
-	Block *bp;
-
-	ilock(&rblock);
-	if((bp = rbpool) != nil){
-		rbpool = bp->next;
-		bp->next = 0;
-		_xinc(&bp->ref);	/* prevent bp from being freed */
-	}
-	iunlock(&rblock);
-	return bp;
-}
-
-void
-rbfree(Block *b)
-{
-	b->rp = b->wp = (uchar*)PGROUND((uintptr)b->base);
- 	b->flag &= ~(Bipck | Budpck | Btcpck | Bpktck);
-	ilock(&rblock);
-	b->next = rbpool;
-	rbpool = b;
-	iunlock(&rblock);
-}
-
 static int
 cleanup(Ctlr *c, int tdh)
 {
@@ -611,7 +584,7 @@ replenish(Ctlr *c, uint rdh)
 	i = 0;
 	for(rdt = c->rdt; NEXTPOW2(rdt, m) != rdh; rdt = NEXTPOW2(rdt, m)){
 		r = c->rdba + rdt;
-		if((b = rballoc()) == nil){
+		if((b = rbpoolalloc(c->pool)) == nil){
 			print("82598: no buffers\n");
 			break;
 		}
@@ -715,12 +688,9 @@ multicast(void *a, uchar *ea, int on)
 static void
 freemem(Ctlr *c)
 {
-	Block *b;
-
-	while(b = rballoc()){
-		b->free = 0;
-		freeb(b);
-	}
+	if(c->nrb > 0)
+		rbpoolshrink(c->pool, c->nrb);
+	c->nrb = 0;
 	free(c->rdba);
 	c->rdba = nil;
 	free(c->tdba);
@@ -906,7 +876,6 @@ txinit(Ctlr *c)
 static void
 attach(Ether *e)
 {
-	Block *b;
 	Ctlr *c;
 	char buf[KNAMELEN];
 
@@ -929,13 +898,8 @@ attach(Ether *e)
 		    c->rb == nil || c->tb == nil)
 			error(Enomem);
 
-		for(c->nrb = 0; c->nrb < 2*Nrb; c->nrb++){
-			b = allocb(c->rbsz + BY2PG);	/* see rbfree() */
-			if(b == nil)
-				error(Enomem);
-			b->free = rbfree;
-			freeb(b);
-		}
+		c->pool = rbpoolget(c->rbsz, 2*Nrb);
+		c->nrb = 2*Nrb;
 	}
 	if (!c->attached) {
 		rxinit(c);
@@ -1090,6 +1054,7 @@ pnp(Ether *e)
 	e->port = (uintptr)c->physreg;
 	e->irq = c->p->intl;
 	e->tbdf = c->p->tbdf;
+	e->msi = 1;
 	e->mbps = 10000;
 	e->maxmtu = ETHERMAXTU;
 	memmove(e->ea, c->ra, Eaddrlen);
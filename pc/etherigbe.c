@@ -466,6 +466,7 @@ struct Ctlr {
 	int	nrd;
 	int	ntd;
 	int	nrb;			/* # bufs this Ctlr has in the pool */
+	Rbpool*	pool;			/* receive Blocks, shared by size */
 
 	int*	nic;
 	Lock	imlock;
@@ -519,9 +520,6 @@ struct Ctlr {
 static Ctlr* igbectlrhead;
 static Ctlr* igbectlrtail;
 
-static Lock igberblock;		/* free receive Blocks */
-static Block* igberbpool;	/* receive Blocks for all igbe controllers */
-
 static char* statistics[Nstatistics] = {
 	"CRC Error",
 	"Alignment Error",
@@ -763,35 +761,6 @@ igbemulticast(void* arg, uchar* addr, int add)
 	csr32w(ctlr, Mta+x*4, ctlr->mta[x]);
 }
 
-static Block*
-igberballoc(void)
-{
-	Block *bp;
-
-	ilock(&igberblock);
-	if((bp = igberbpool) != nil){
-		igberbpool = bp->next;
-		bp->next = nil;
-		_xinc(&bp->ref);	/* prevent bp from being freed */
-	}
-	iunlock(&igberblock);
-
-	return bp;
-}
-
-static void
-igberbfree(Block* bp)
-{
-	bp->rp = bp->lim - Rbsz;
-	bp->wp = bp->rp;
- 	bp->flag &= ~(Bipck | Budpck | Btcpck | Bpktck);
-
-	ilock(&igberblock);
-	bp->next = igberbpool;
-	igberbpool = bp;
-	iunlock(&igberblock);
-}
-
 static void
 igbeim(Ctlr* ctlr, int im)
 {
@@ -1040,7 +1009,7 @@ igbereplenish(Ctlr* ctlr)
 	while(NEXT(rdt, ctlr->nrd) != ctlr->rdh){
 		rd = &ctlr->rdba[rdt];
 		if(ctlr->rb[rdt] == nil){
-			bp = igberballoc();
+			bp = rbpoolalloc(ctlr->pool);
 			if(bp == nil){
 				iprint("#l%d: igbereplenish: no available buffers\n",
 					ctlr->edev->ctlrno);
@@ -1199,7 +1168,6 @@ igberproc(void* arg)
 static void
 igbeattach(Ether* edev)
 {
-	Block *bp;
 	Ctlr *ctlr;
 	char name[KNAMELEN];
 
@@ -1216,12 +1184,9 @@ igbeattach(Ether* edev)
 	ctlr->alloc = nil;
 	ctlr->nrb = 0;
 	if(waserror()){
-		while(ctlr->nrb > 0){
-			bp = igberballoc();
-			bp->free = nil;
-			freeb(bp);
-			ctlr->nrb--;
-		}
+		if(ctlr->nrb > 0)
+			rbpoolshrink(ctlr->pool, ctlr->nrb);
+		ctlr->nrb = 0;
 		free(ctlr->tb);
 		ctlr->tb = nil;
 		free(ctlr->rb);
@@ -1249,12 +1214,8 @@ igbeattach(Ether* edev)
 		error(Enomem);
 	}
 
-	for(ctlr->nrb = 0; ctlr->nrb < Nrb; ctlr->nrb++){
-		if((bp = allocb(Rbsz)) == nil)
-			break;
-		bp->free = igberbfree;
-		freeb(bp);
-	}
+	ctlr->pool = rbpoolget(Rbsz, Nrb);
+	ctlr->nrb = Nrb;
 
 	snprint(name, KNAMELEN, "#l%dlproc", edev->ctlrno);
 	kproc(name, igbelproc, edev);
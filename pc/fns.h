@@ -78,6 +78,7 @@ ulong	inl(int);
 void	insl(int, void*, int);
 int	intrdisable(int, void (*)(Ureg *, void *), void*, int, char*);
 void	intrenable(int, void (*)(Ureg*, void*), void*, int, char*);
+int	intrenablemsi(Pcidev*, int, int, void (*)(Ureg*, void*), void*, char*);
 void	introff(void);
 void	intron(void);
 void	invlpg(ulong);
@@ -120,6 +121,7 @@ void	outsl(int, void*, int);
 ulong	paddr(void*);
 ulong	pcibarsize(Pcidev*, int);
 void	pcibussize(Pcidev*, ulong*, ulong*);
+int	pcicap(Pcidev*, int);
 int	pcicfgr8(Pcidev*, int);
 int	pcicfgr16(Pcidev*, int);
 int	pcicfgr32(Pcidev*, int);
@@ -134,6 +136,10 @@ void	pcihinv(Pcidev*);
 uchar	pciipin(Pcidev*, uchar);
 Pcidev* pcimatch(Pcidev*, int, int);
 Pcidev* pcimatchtbdf(int);
+void	pcimsioff(Pcidev*, int);
+int	pcimsiset(Pcidev*, int, ulong, ulong);
+ulong*	pcimsixmap(Pcidev*);
+int	pcimsixsize(Pcidev*);
 void	pcireset(void);
 int	pciscan(int, Pcidev**);
 void	pcisetbme(Pcidev*);
@@ -183,6 +189,7 @@ void	upareserve(ulong, int);
 void	vectortable(void);
 void*	vmap(ulong, int);
 int	vmapsync(ulong);
+void*	vmapwc(ulong, int);
 void	vunmap(void*, int);
 void	wbinvd(void);
 void	wrmsr(int, vlong);
@@ -170,15 +170,19 @@ guesscpuhz(int aalcycles)
 		 *  prefetch buffer.
 		 *
 		 */
+		ilock(&i8253);		/* application processors start together */
 		outb(Tmode, Latch0);
 		cycles(&a);
 		x = inb(T0cntr);
 		x |= inb(T0cntr)<<8;
+		iunlock(&i8253);
 		aamloop(loops);
+		ilock(&i8253);
 		outb(Tmode, Latch0);
 		cycles(&b);
 		y = inb(T0cntr);
 		y |= inb(T0cntr)<<8;
+		iunlock(&i8253);
 		x -= y;
 	
 		if(x < 0)
@@ -56,6 +56,11 @@ typedef struct Vctl {
 
 	void	(*f)(Ureg*, void*);	/* handler to call */
 	void*	a;			/* argument to call it with */
+
+	int	vno;			/* vector assigned */
+	int	cpu;			/* machno it's routed to, -1 if none */
+	Pcidev*	msidev;			/* message signalled, if not nil */
+	int	msino;			/* msi-x table entry, -1 for msi */
 } Vctl;
 
 enum {
@@ -214,6 +219,13 @@ enum {					/* type 2 pre-defined header */
 	PciCBLMBAR	= 0x44,		/* legacy mode base address */
 };
 
+enum {					/* capability list ids */
+	PciCapPMG	= 0x01,		/* power management */
+	PciCapMSI	= 0x05,		/* message signalled interrupts */
+	PciCapPCIe	= 0x10,		/* pci express */
+	PciCapMSIX	= 0x11,		/* extended msi */
+};
+
 typedef struct Pcisiz Pcisiz;
 struct Pcisiz
 {
@@ -259,6 +271,7 @@ struct Pcidev
 	} ioa, mema;
 
 	int	pmrb;			/* power management register block */
+	ulong*	msixtab;		/* msi-x table, once mapped */
 };
 
 enum {
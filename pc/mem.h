@@ -149,6 +149,9 @@
 #define	PTEKERNEL	(0<<2)
 #define	PTEUSER		(1<<2)
 #define	PTESIZE		(1<<7)
+#define	PTEPAT		(1<<7)		/* in a pte; bit 12 in a 4MB pde */
+#define	PDEPAT		(1<<12)
+#define	PTEWC		(PTEPAT|PTEWT)	/* pat entry 5, write combining */
 #define	PTEGLOBAL	(1<<8)
 
 /*
@@ -365,8 +365,8 @@ mmurelease(Proc* proc)
 			panic("mmurelease: page->ref %d", page->ref);
 		pagechainhead(page);
 	}
-	if(proc->mmufree && palloc.r.p)
-		wakeup(&palloc.r);
+	if(proc->mmufree && palloc.pwait.head != nil)
+		sqwakeup(&palloc.pwait);
 	proc->mmufree = 0;
 }
 
@@ -538,8 +538,8 @@ static void pdbunmap(ulong*, ulong, int);
 /*
  * Add a device mapping to the vmap range.
  */
-void*
-vmap(ulong pa, int size)
+static void*
+vmapflag(ulong pa, int size, ulong flag)
 {
 	int osize;
 	ulong o, va;
@@ -559,7 +559,7 @@ vmap(ulong pa, int size)
 	}
 	ilock(&vmaplock);
 	if((va = vmapalloc(size)) == 0 
-	|| pdbmap(MACHP(0)->pdb, pa|PTEUNCACHED|PTEWRITE, va, size) < 0){
+	|| pdbmap(MACHP(0)->pdb, pa|flag, va, size) < 0){
 		iunlock(&vmaplock);
 		return 0;
 	}
@@ -573,6 +573,24 @@ vmap(ulong pa, int size)
 	return (void*)(va + o);
 }
 
+void*
+vmap(ulong pa, int size)
+{
+	return vmapflag(pa, size, PTEUNCACHED|PTEWRITE);
+}
+
+/*
+ * map a frame buffer write combining through the page
+ * attribute table, or uncached on processors without one.
+ */
+void*
+vmapwc(ulong pa, int size)
+{
+	if(MACHP(0)->cpuiddx & Pat)
+		return vmapflag(pa, size, PTEWC|PTEWRITE);
+	return vmapflag(pa, size, PTEUNCACHED|PTEWRITE);
+}
+
 static int
 findhole(ulong *a, int n, int count)
 {
@@ -714,7 +732,10 @@ pdbmap(ulong *pdb, ulong pa, ulong va, int size)
 		 * va, pa aligned and size >= 4MB and processor can do it.
 		 */
 		if(pse && (pa+off)%(4*MB) == 0 && (va+off)%(4*MB) == 0 && (size-off) >= 4*MB){
-			*table = (pa+off)|flag|PTESIZE|PTEVALID;
+			if(flag & PTEPAT)
+				*table = (pa+off)|(flag&~PTEPAT)|PDEPAT|PTESIZE|PTEVALID;
+			else
+				*table = (pa+off)|flag|PTESIZE|PTEVALID;
 			pgsz = 4*MB;
 		}else{
 			pte = mmuwalk(pdb, va+off, 2, 1);
@@ -26,10 +26,16 @@ extern int i8259elcr;			/* mask of level-triggered interrupts */
 /* static */ Apic mpapic[MaxAPICNO+1];
 /* static */ int machno2apicno[MaxAPICNO+1];	/* inverse map: machno -> APIC ID */
 /* static */ Apic ioapic[MaxAPICNO+1];
-static Ref mpvnoref;			/* unique vector assignment */
+static Lock mpveclock;
+static uchar mpvecused[MaxVectorAPIC+1];	/* unique vector assignment */
+static struct {
+	Apic*	apic;
+	int	intin;
+} mpvecrdt[MaxVectorAPIC+1];		/* where each io apic vector comes from */
 static int mpmachno = 1;
 static Lock mpphysidlock;
-static int mpphysid;
+static int mpintrload[MaxAPICNO+1];	/* vectors routed to each apic */
+static int mpsmtshift = -1;
 
 static char* buses[] = {
 	"CBUSI ",
@@ -398,6 +404,10 @@ squidboy(Apic* apic)
 {
 //	iprint("Hello Squidboy\n");
 
+	/* done with the trampoline; the next processor may have it */
+	apic->started = 1;
+	coherence();
+
 	machinit();
 	mmuinit();
 
@@ -425,12 +435,15 @@ squidboy(Apic* apic)
 	schedinit();
 }
 
-static void
-mpstartap(Apic* apic)
+/*
+ * build the page tables and Mach for apic's processor.
+ */
+static int
+mpapmach(Apic* apic)
 {
-	ulong *apbootp, *pdb, *pte;
+	ulong *pdb, *pte;
 	Mach *mach, *mach0;
-	int i, machno;
+	int machno;
 	uchar *p;
 
 	mach0 = MACHP(0);
@@ -447,7 +460,7 @@ mpstartap(Apic* apic)
 	p += BY2PG;
 
 	if((pte = mmuwalk(pdb, MACHADDR, 1, 0)) == nil)
-		return;
+		return -1;
 	memmove(p, KADDR(PPN(*pte)), BY2PG);
 	*pte = PADDR(p)|PTEWRITE|PTEVALID;
 	if(mach0->havepge)
@@ -456,7 +469,7 @@ mpstartap(Apic* apic)
 
 	mach = (Mach*)p;
 	if((pte = mmuwalk(pdb, MACHADDR, 2, 0)) == nil)
-		return;
+		return -1;
 	*pte = PADDR(mach)|PTEWRITE|PTEVALID;
 	if(mach0->havepge)
 		*pte |= PTEGLOBAL;
@@ -467,6 +480,18 @@ mpstartap(Apic* apic)
 	mach->machno = machno;
 	mach->pdb = pdb;
 	mach->gdt = (Segdesc*)p;	/* filled by mmuinit */
+	return 0;
+}
+
+/*
+ * hand apic's processor the trampoline and wait only until it has
+ * taken its arguments; it carries on initialising by itself.
+ */
+static void
+mpstartap(Apic* apic)
+{
+	ulong *apbootp;
+	int i;
 
 	/*
 	 * Tell the AP where its kernel vector and pdb are.
@@ -474,12 +499,30 @@ mpstartap(Apic* apic)
 	 */
 	apbootp = (ulong*)(APBOOTSTRAP+0x08);
 	*apbootp++ = (ulong)squidboy;	/* assembler jumps here eventually */
-	*apbootp++ = PADDR(pdb);
+	*apbootp++ = PADDR(MACHP(apic->machno)->pdb);
 	*apbootp = (ulong)apic;
+	coherence();
+
+	lapicstartap(apic, PADDR(APBOOTSTRAP));
+	for(i = 0; i < 10000; i++){
+		if(apic->started)
+			break;
+		delay(1);
+	}
+}
+
+/*
+ * Universal Startup Algorithm, all processors at once: INIT each,
+ * one 10ms wait, then the STARTUPs one after another, each as soon
+ * as the one before has left the trampoline.  then wait for
+ * them all to come online together.
+ */
+static void
+mpstartaps(Apic** aps, int n)
+{
+	uchar *p;
+	int i, j;
 
-	/*
-	 * Universal Startup Algorithm.
-	 */
 	p = KADDR(0x467);		/* warm-reset vector */
 	*p++ = PADDR(APBOOTSTRAP);
 	*p++ = PADDR(APBOOTSTRAP)>>8;
@@ -493,13 +536,16 @@ mpstartap(Apic* apic)
 	coherence();
 
 	nvramwrite(0x0F, 0x0A);	/* shutdown code: warm reset upon init ipi */
-	lapicstartap(apic, PADDR(APBOOTSTRAP));
-	for(i = 0; i < 1000; i++){
-		if(apic->online)
-			break;
-		delay(10);
-	}
+	for(i = 0; i < n; i++)
+		lapicinitap(aps[i]);
+	delay(10);
+	for(i = 0; i < n; i++)
+		mpstartap(aps[i]);
 	nvramwrite(0x0F, 0x00);
+
+	for(i = 0; i < n; i++)
+		for(j = 0; j < 1000 && !aps[i]->online; j++)
+			delay(10);
 }
 
 static void
@@ -520,6 +566,8 @@ mpinit(void)
 	uchar *e, *p;
 	Apic *apic, *bpapic;
 	void *va;
+	Apic *aps[MAXMACH];
+	int naps;
 
 	mpdebug = getconf("*debugmp") != nil;
 	i8259init();
@@ -647,16 +695,19 @@ mpinit(void)
 	else
 		ncpu = MAXMACH;
 	memmove((void*)APBOOTSTRAP, apbootstrap, sizeof(apbootstrap));
+	naps = 0;
 	for(apic = mpapic; apic <= &mpapic[MaxAPICNO]; apic++){
 		if(ncpu <= 1)
 			break;
 		if((apic->flags & (PcmpBP|PcmpEN)) == PcmpEN
 		&& apic->type == PcmpPROCESSOR){
-			mpstartap(apic);
+			if(mpapmach(apic) == 0)
+				aps[naps++] = apic;
 			conf.nmach++;
 			ncpu--;
 		}
 	}
+	mpstartaps(aps, naps);
 
 	/*
 	 *  we don't really know the number of processors till
@@ -669,10 +720,35 @@ mpinit(void)
 		conf.copymode = 1;
 }
 
+/*
+ * threads in a core differ in the low mpsmtshift bits of their
+ * apic ids.  cpuid leaf 0xB gives the width on intel parts;
+ * elsewhere assume one thread per core.
+ */
 static int
-mpintrcpu(void)
+mpsmtbits(void)
 {
-	int i;
+	ulong r[4];
+
+	memset(r, 0, sizeof r);
+	cpuid(0, r);
+	if(r[0] < 0xB)
+		return 0;
+	memset(r, 0, sizeof r);
+	cpuid(0xB, r);
+	if(((r[2]>>8) & 0xFF) != 1)	/* level 0 isn't smt */
+		return 0;
+	return r[0] & 0x1F;
+}
+
+/*
+ * pick the apic for a new vector, taking a share of its load.
+ * machno >= 0 asks for a particular processor.
+ */
+static int
+mpintrcpu(int machno)
+{
+	int i, j, best, bestcore, core, smtmask;
 
 	/*
 	 * The bulk of this code was written ~1995, when there was
@@ -684,32 +760,98 @@ mpintrcpu(void)
 	 * fall-back is to physical mode, which works across all processor
 	 * generations, both AMD and Intel, using the APIC and xAPIC.
 	 *
-	 * Interrupt routing policy can be set here.
-	 * Currently, just assign each interrupt to a different CPU on
-	 * a round-robin basis. Some idea of the packages/cores/thread
-	 * topology would be useful here, e.g. to not assign interrupts
-	 * to more than one thread in a core, or to use a "noise" core.
-	 * But, as usual, Intel make that an onerous task. 
+	 * Interrupt routing policy is set here.
+	 * Each vector goes to the online core carrying the fewest
+	 * vectors, and within it to the least loaded thread, the
+	 * first thread on ties, so a second thread of a core only
+	 * takes interrupts once every core has them.
+	 * *intrcpu0= in plan9.ini sends everything to cpu0 as before.
 	 */
+	lock(&mpphysidlock);
+	if(machno >= 0 && machno < conf.nmach && mpapic[machno2apicno[machno]].online){
+		best = machno2apicno[machno];
+		goto Found;
+	}
+	if(getconf("*intrcpu0") != nil){
+		best = machno2apicno[0];
+		goto Found;
+	}
+	if(mpsmtshift < 0)
+		mpsmtshift = mpsmtbits();
+	smtmask = (1<<mpsmtshift)-1;
+
+	best = -1;
+	bestcore = 0;
+	for(i = 0; i <= MaxAPICNO; i++){
+		if(!mpapic[i].online)
+			continue;
+		core = 0;
+		for(j = i & ~smtmask; j <= (i|smtmask) && j <= MaxAPICNO; j++)
+			if(mpapic[j].online)
+				core += mpintrload[j];
+		if(best == -1 || core < bestcore
+		|| core == bestcore && mpintrload[i] < mpintrload[best]){
+			best = i;
+			bestcore = core;
+		}
+	}
+	if(best == -1)
+		best = machno2apicno[0];
+Found:
+	mpintrload[best]++;
+	unlock(&mpphysidlock);
 
-	/*
-	 * temporary workaround for many-core intel (non-amd) systems:
-	 * always use cpu 0.  (TODO)
-	 */
-	if(strncmp(m->cpuidid, "AuthenticAMD", 12) != 0 && conf.nmach > 8)
-		return 0;
+	return mpapic[best].apicno;
+}
 
+static void
+mpintrcpuput(int apicno)
+{
 	lock(&mpphysidlock);
-	for(;;){
-		i = mpphysid++;
-		if(mpphysid >= MaxAPICNO+1)
-			mpphysid = 0;
-		if(mpapic[i].online)
-			break;
-	}
+	if(mpintrload[apicno] > 0)
+		mpintrload[apicno]--;
 	unlock(&mpphysidlock);
+}
+
+/*
+ * With the APIC a unique vector can be assigned to each
+ * request to enable an interrupt. There are two reasons this
+ * is a good idea:
+ * 1) to prevent lost interrupts, no more than 2 interrupts
+ *    should be assigned per block of 16 vectors (there is an
+ *    in-service entry and a holding entry for each priority
+ *    level and there is one priority level per block of 16
+ *    interrupts).
+ * 2) each input pin on the IOAPIC will receive a different
+ *    vector regardless of whether the devices on that pin use
+ *    the same IRQ as devices on another pin.
+ * Vectors are handed out 8 apart for as long as that lasts,
+ * which keeps (1); after that, with msi-x devices wanting one
+ * per queue, the gaps are filled in.
+ */
+static int
+mpvecalloc(void)
+{
+	int i, vno;
+
+	lock(&mpveclock);
+	for(i = 0; i < 8; i++)
+		for(vno = VectorAPIC+i; vno <= MaxVectorAPIC; vno += 8)
+			if(!mpvecused[vno]){
+				mpvecused[vno] = 1;
+				unlock(&mpveclock);
+				return vno;
+			}
+	unlock(&mpveclock);
+	return -1;
+}
 
-	return mpapic[i].apicno;
+static void
+mpvecfree(int vno)
+{
+	lock(&mpveclock);
+	mpvecused[vno] = 0;
+	unlock(&mpveclock);
 }
 
 static int
@@ -785,9 +927,10 @@ mpintrenablex(Vctl* v, int tbdf)
 		 * are never disabled once enabled.
 		 */
 		apic = aintr->apic;
-		ioapicrdtr(apic, aintr->intr->intin, 0, &lo);
+		ioapicrdtr(apic, aintr->intr->intin, &hi, &lo);
 		if(!(lo & ApicIMASK)){
 			vno = lo & 0xFF;
+			v->cpu = mpapic[(hi>>24) & 0xFF].machno;
 //print("%s vector %d (!imask)\n", v->name, vno);
 			n = mpintrinit(bus, aintr->intr, vno, v->irq);
 			n |= ApicPHYSICAL;		/* no-op */
@@ -800,38 +943,32 @@ mpintrenablex(Vctl* v, int tbdf)
 			break;
 		}
 
-		/*
-		 * With the APIC a unique vector can be assigned to each
-		 * request to enable an interrupt. There are two reasons this
-		 * is a good idea:
-		 * 1) to prevent lost interrupts, no more than 2 interrupts
-		 *    should be assigned per block of 16 vectors (there is an
-		 *    in-service entry and a holding entry for each priority
-		 *    level and there is one priority level per block of 16
-		 *    interrupts).
-		 * 2) each input pin on the IOAPIC will receive a different
-		 *    vector regardless of whether the devices on that pin use
-		 *    the same IRQ as devices on another pin.
-		 */
-		vno = VectorAPIC + (incref(&mpvnoref)-1)*8;
+		vno = mpvecalloc();
 //print("%s vector %d (imask)\n", v->name, vno);
-		if(vno > MaxVectorAPIC){
-			print("mpintrenable: vno %d, irq %d, tbdf %uX\n",
-				vno, v->irq, tbdf);
+		if(vno == -1){
+			print("mpintrenable: out of vectors, irq %d, tbdf %uX\n",
+				v->irq, tbdf);
 			return -1;
 		}
 
-		hi = mpintrcpu()<<24;
 		lo = mpintrinit(bus, aintr->intr, vno, v->irq);
 		//print("lo 0x%uX: busno %d intr %d vno %d irq %d elcr 0x%uX\n",
 		//	lo, bus->busno, aintr->intr->irq, vno,
 		//	v->irq, i8259elcr);
-		if(lo & ApicIMASK)
+		if(lo & ApicIMASK){
+			mpvecfree(vno);
 			return -1;
+		}
+		hi = mpintrcpu(-1);
+		v->cpu = mpapic[hi].machno;
+		hi <<= 24;
 		lo |= ApicPHYSICAL;			/* no-op */
 
-		if((apic->flags & PcmpEN) && apic->type == PcmpIOAPIC)
+		if((apic->flags & PcmpEN) && apic->type == PcmpIOAPIC){
  			ioapicrdtw(apic, aintr->intr->intin, hi, lo);
+			mpvecrdt[vno].apic = apic;
+			mpvecrdt[vno].intin = aintr->intr->intin;
+		}
 		//else
 		//	print("lo not enabled 0x%uX %d\n",
 		//		apic->flags, apic->type);
@@ -896,6 +1033,77 @@ mpintrenable(Vctl* v)
 	return -1;
 }
 
+/*
+ * route the message signalled interrupt described by v.
+ * on entry v->cpu is the machno asked for, or -1;
+ * on return it's the one chosen.
+ */
+int
+mpmsienable(Vctl* v)
+{
+	int cpu, vno;
+
+	if((vno = mpvecalloc()) == -1){
+		print("mpmsienable: out of vectors for %s\n", v->name);
+		return -1;
+	}
+	cpu = mpintrcpu(v->cpu);
+	if(pcimsiset(v->msidev, v->msino, Msiaddr|cpu<<12, vno) == -1){
+		mpintrcpuput(cpu);
+		mpvecfree(vno);
+		return -1;
+	}
+	v->cpu = mpapic[cpu].machno;
+	v->isr = lapicisr;
+	v->eoi = lapiceoi;
+	return vno;
+}
+
+/*
+ * undo mpmsienable.  called with vctllock held.
+ */
+void
+mpmsidisable(Vctl* v)
+{
+	pcimsioff(v->msidev, v->msino);
+	mpintrcpuput(machno2apicno[v->cpu]);
+	mpvecfree(v->vno);
+}
+
+/*
+ * move the vector v is on to processor machno,
+ * returning the machno it's now on, or -1.
+ * called with vctllock held.
+ */
+int
+mpintrassign(Vctl* v, int machno)
+{
+	int cpu, hi, lo, vno;
+
+	vno = v->vno;
+	if(vno < VectorAPIC || vno > MaxVectorAPIC || v->cpu < 0)
+		return -1;
+	if(machno < 0 || machno >= conf.nmach || !mpapic[machno2apicno[machno]].online)
+		return -1;
+	if(v->msidev == nil && mpvecrdt[vno].apic == nil)
+		return -1;
+
+	cpu = mpintrcpu(machno);
+	if(v->msidev != nil){
+		if(pcimsiset(v->msidev, v->msino, Msiaddr|cpu<<12, vno) == -1){
+			mpintrcpuput(cpu);
+			return -1;
+		}
+	}
+	else{
+		ioapicrdtr(mpvecrdt[vno].apic, mpvecrdt[vno].intin, &hi, &lo);
+		ioapicrdtw(mpvecrdt[vno].apic, mpvecrdt[vno].intin, cpu<<24, lo);
+	}
+	mpintrcpuput(machno2apicno[v->cpu]);
+
+	return machno;
+}
+
 static Lock mpshutdownlock;
 
 void
@@ -166,6 +166,7 @@ typedef struct Apic {
 	int	lintr[2];		/* Local APIC */
 	int	machno;
 
+	int	started;		/* has left the boot trampoline */
 	int	online;
 } Apic;
 
@@ -209,6 +210,10 @@ enum {
 	ApicIMASK	= 0x00010000,	/* [16] Interrupt Mask */
 };
 
+enum {
+	Msiaddr		= 0xFEE00000,	/* msi address, physical apic id in [19:12] */
+};
+
 extern void ioapicinit(Apic*, int);
 extern void ioapicrdtr(Apic*, int, int*, int*);
 extern void ioapicrdtw(Apic*, int, int, int);
@@ -218,6 +223,7 @@ extern int lapiceoi(int);
 extern void lapicerror(Ureg*, void*);
 extern void lapicicrw(ulong, ulong);
 extern void lapicinit(Apic*);
+extern void lapicinitap(Apic*);
 extern void lapicintroff(void);
 extern void lapicintron(void);
 extern int lapicisr(int);
@@ -230,6 +236,9 @@ extern void lapictimerset(uvlong);
 
 extern void mpinit(void);
 extern int mpintrenable(Vctl*);
+extern int mpmsienable(Vctl*);
+extern void mpmsidisable(Vctl*);
+extern int mpintrassign(Vctl*, int);
 extern void mpshutdown(void);
 
 extern _MP_ *_mp_;
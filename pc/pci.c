@@ -56,6 +56,7 @@ enum
 	MemWrInv	= (1<<4),
 	PErrEn		= (1<<6),
 	SErrEn		= (1<<8),
+	IntxDis		= (1<<10),
 };
 
 static Lock pcicfglock;
@@ -1401,24 +1402,19 @@ pciclrmwi(Pcidev* p)
 	pcicfgw16(p, PciPCR, p->pcr);
 }
 
-static int
-pcigetpmrb(Pcidev* p)
+int
+pcicap(Pcidev* p, int cap)
 {
-	int ptr;
-
-	if(p->pmrb != 0)
-		return p->pmrb;
-	p->pmrb = -1;
+	int i, ptr;
 
 	/*
 	 * If there are no extended capabilities implemented,
-	 * (bit 4 in the status register) assume there's no standard
-	 * power management method.
+	 * (bit 4 in the status register) there's nothing to find.
 	 * Find the capabilities pointer based on PCI header type.
 	 */
 	if(!(pcicfgr16(p, PciPSR) & 0x0010))
 		return -1;
-	switch(pcicfgr8(p, PciHDT)){
+	switch(pcicfgr8(p, PciHDT) & 0x7F){
 	default:
 		return -1;
 	case 0:					/* all other */
@@ -1429,9 +1425,10 @@ pcigetpmrb(Pcidev* p)
 		ptr = 0x14;
 		break;
 	}
-	ptr = pcicfgr32(p, ptr);
+	ptr = pcicfgr8(p, ptr);
 
-	while(ptr != 0){
+	/* bound the walk in case the list loops */
+	for(i = 0; ptr != 0 && i < 48; i++){
 		/*
 		 * Check for validity.
 		 * Can't be in standard header and must be double
@@ -1439,10 +1436,8 @@ pcigetpmrb(Pcidev* p)
 		 */
 		if(ptr < 0x40 || (ptr & ~0xFC))
 			return -1;
-		if(pcicfgr8(p, ptr) == 0x01){
-			p->pmrb = ptr;
+		if(pcicfgr8(p, ptr) == cap)
 			return ptr;
-		}
 
 		ptr = pcicfgr8(p, ptr+1);
 	}
@@ -1450,6 +1445,132 @@ pcigetpmrb(Pcidev* p)
 	return -1;
 }
 
+static int
+pcigetpmrb(Pcidev* p)
+{
+	if(p->pmrb != 0)
+		return p->pmrb;
+	p->pmrb = pcicap(p, PciCapPMG);
+	return p->pmrb;
+}
+
+enum {						/* msi message control */
+	MsiEnable	= 0x0001,
+	MsiMME		= 0x0070,		/* multiple message enable */
+	Msi64		= 0x0080,		/* 64-bit address capable */
+
+	MsixSize	= 0x07FF,		/* table size - 1 */
+	MsixMask	= 0x4000,		/* function mask */
+	MsixEnable	= 0x8000,
+};
+
+/*
+ * number of msi-x table entries, 0 if the device has none.
+ */
+int
+pcimsixsize(Pcidev* p)
+{
+	int c;
+
+	if((c = pcicap(p, PciCapMSIX)) == -1)
+		return 0;
+	return (pcicfgr16(p, c+2) & MsixSize) + 1;
+}
+
+static ulong*
+pcimsixtab(Pcidev* p, int c)
+{
+	int bir;
+	ulong o;
+
+	if(p->msixtab != nil)
+		return p->msixtab;
+	o = pcicfgr32(p, c+4);
+	bir = o & 7;
+	if(bir >= nelem(p->mem) || p->mem[bir].bar == 0 || (p->mem[bir].bar & 1))
+		return nil;
+	p->msixtab = vmap((p->mem[bir].bar & ~0xF) + (o & ~7),
+		((pcicfgr16(p, c+2) & MsixSize) + 1) * 16);
+	return p->msixtab;
+}
+
+/*
+ * map the msi-x table, if it isn't already; vmap can't be
+ * called with interrupts off, so do this before pcimsiset.
+ */
+ulong*
+pcimsixmap(Pcidev* p)
+{
+	int c;
+
+	if((c = pcicap(p, PciCapMSIX)) == -1)
+		return nil;
+	return pcimsixtab(p, c);
+}
+
+/*
+ * point message n at addr with data and enable it: n is an msi-x
+ * table entry or -1 for plain msi (single message only).
+ * also used to retarget an enabled message.
+ * once messages are enabled the INTx pin is turned off.
+ */
+int
+pcimsiset(Pcidev* p, int n, ulong addr, ulong data)
+{
+	int c, ctl;
+	ulong *tab;
+
+	if(n < 0){
+		if((c = pcicap(p, PciCapMSI)) == -1)
+			return -1;
+		ctl = pcicfgr16(p, c+2);
+		pcicfgw16(p, c+2, ctl & ~MsiEnable);
+		pcicfgw32(p, c+4, addr);
+		if(ctl & Msi64){
+			pcicfgw32(p, c+8, 0);
+			pcicfgw16(p, c+12, data);
+		}
+		else
+			pcicfgw16(p, c+8, data);
+		pcicfgw16(p, c+2, (ctl & ~MsiMME)|MsiEnable);
+	}
+	else{
+		if((c = pcicap(p, PciCapMSIX)) == -1)
+			return -1;
+		ctl = pcicfgr16(p, c+2);
+		if(n > (ctl & MsixSize) || (tab = pcimsixtab(p, c)) == nil)
+			return -1;
+		tab += n*4;
+		tab[3] |= 1;			/* mask while changing */
+		tab[0] = addr;
+		tab[1] = 0;
+		tab[2] = data;
+		tab[3] &= ~1;
+		pcicfgw16(p, c+2, (ctl & ~MsixMask)|MsixEnable);
+	}
+	p->pcr = pcicfgr16(p, PciPCR) | IntxDis;
+	pcicfgw16(p, PciPCR, p->pcr);
+
+	return 0;
+}
+
+/*
+ * stop message n (as for pcimsiset) being sent.
+ * INTx stays off; the caller is giving up the interrupt.
+ */
+void
+pcimsioff(Pcidev* p, int n)
+{
+	int c;
+
+	if(n < 0){
+		if((c = pcicap(p, PciCapMSI)) != -1)
+			pcicfgw16(p, c+2, pcicfgr16(p, c+2) & ~MsiEnable);
+	}
+	else if(p->msixtab != nil)
+		p->msixtab[n*4+3] |= 1;		/* mask */
+}
+
 int
 pcigetpms(Pcidev* p)
 {
@@ -41,6 +41,7 @@ Cursor	arrow = {
 int didswcursorinit;
 
 static void *softscreen;
+static int shadowed;	/* softscreen shadows a linear frame buffer */
 
 int
 screensize(int x, int y, int z, ulong chan)
@@ -57,6 +58,7 @@ screensize(int x, int y, int z, ulong chan)
 	memimageinit();
 	scr = &vgascreen[0];
 	oldsoft = softscreen;
+	shadowed = 0;
 
 	if(scr->paddr == 0){
 		int width = (x*z)/BI2WD;
@@ -72,7 +74,18 @@ screensize(int x, int y, int z, ulong chan)
 		}
 		scr->useflush = 1;
 	}
+	else if(shadow && !panning && (scr->dev == nil || scr->dev->flush == nil)
+	&& (softscreen = xalloc((x*z)/BI2WD*BY2WD*y)) != nil){
+		/*
+		 * draw in memory, which is quick to read back,
+		 * and copy what changes to the frame buffer.
+		 */
+		gscreendata.bdata = softscreen;
+		scr->useflush = 1;
+		shadowed = 1;
+	}
 	else{
+		softscreen = nil;
 		gscreendata.bdata = scr->vaddr;
 		scr->useflush = scr->dev && scr->dev->flush;
 	}
@@ -131,7 +144,7 @@ screenaperture(int size, int align)
 	scr->paddr = upaalloc(size, align);
 	if(scr->paddr == 0)
 		return -1;
-	scr->vaddr = vmap(scr->paddr, size);
+	scr->vaddr = vmapwc(scr->paddr, size);
 	if(scr->vaddr == nil)
 		return -1;
 	scr->apsize = size;
@@ -157,6 +170,35 @@ attachscreen(Rectangle* r, ulong* chan, int* d, int* width, int *softscreen)
 	return scr->gscreendata->bdata;
 }
 
+/*
+ * copy r from the shadow to the linear frame buffer,
+ * in one move when it spans whole scan lines.
+ */
+static void
+flushshadow(VGAscr *scr, Rectangle r)
+{
+	uchar *sp, *dp;
+	int y, len, incs, off;
+
+	if(rectclip(&r, scr->gscreen->r) == 0)
+		return;
+	incs = scr->gscreen->width * BY2WD;
+	off = (r.min.x*scr->gscreen->depth)/8;
+	len = (r.max.x*scr->gscreen->depth + 7)/8 - off;
+	off += r.min.y*incs;
+	sp = (uchar*)softscreen + off;
+	dp = (uchar*)scr->vaddr + off;
+	if(len == incs){
+		memmove(dp, sp, incs*Dy(r));
+		return;
+	}
+	for(y = r.min.y; y < r.max.y; y++){
+		memmove(dp, sp, len);
+		sp += incs;
+		dp += incs;
+	}
+}
+
 /*
  * It would be fair to say that this doesn't work for >8-bit screens.
  */
@@ -174,6 +216,10 @@ flushmemscreen(Rectangle r)
 	}
 	if(scr->gscreen == nil || scr->useflush == 0)
 		return;
+	if(shadowed){
+		flushshadow(scr, r);
+		return;
+	}
 	if(scr->dev == nil || scr->dev->page == nil)
 		return;
 
@@ -352,6 +398,7 @@ setcursor(Cursor* curs)
 int hwaccel = 1;
 int hwblank = 0;	/* turned on by drivers that are known good */
 int panning = 0;
+int shadow = 0;		/* draw in memory and flush to a linear frame buffer */
 
 int
 hwdraw(Memdrawparam *par)
@@ -385,7 +432,8 @@ hwdraw(Memdrawparam *par)
 			swcursoravoid(par->mr);
 	}
 	
-	if(dst->data->bdata != gscreendata.bdata)
+	/* the engine draws on the frame buffer, not the shadow */
+	if(dst->data->bdata != gscreendata.bdata || shadowed)
 		return 0;
 
 	if(scr->fill==nil && scr->scroll==nil)
@@ -531,12 +579,14 @@ vgalinearaddr(VGAscr *scr, ulong paddr, int size)
 	 */
 	if(nsize > 64*MB)
 		nsize = 64*MB;
-	scr->vaddr = vmap(npaddr, nsize);
+	scr->vaddr = vmapwc(npaddr, nsize);
 	if(scr->vaddr == 0)
 		error("cannot allocate vga frame buffer");
 	scr->vaddr = (char*)scr->vaddr+x;
 	scr->paddr = paddr;
 	scr->apsize = nsize;
+	if(m->cpuiddx & Pat)
+		return;
 	/* let mtrr harmlessly fail on old CPUs, e.g., P54C */
 	if(!waserror()){
 		mtrr(npaddr, nsize, "wc");
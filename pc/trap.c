@@ -28,27 +28,60 @@ enum
 };
 ulong intrtimes[256][Ntimevec];
 
-void
-intrenable(int irq, void (*f)(Ureg*, void*), void* a, int tbdf, char *name)
+typedef struct Intrstat Intrstat;
+struct Intrstat {
+	ulong	count;			/* times taken */
+	ulong	spurious;		/* taken with no handler */
+	uvlong	cycles;			/* in handlers, from intrtime */
+};
+static Intrstat intrstats[256];
+
+static Vctl*
+vctlalloc(int irq, void (*f)(Ureg*, void*), void* a, int tbdf, char *name)
 {
-	int vno;
 	Vctl *v;
 
-	if(f == nil){
-		print("intrenable: nil handler for %d, tbdf 0x%uX for %s\n",
-			irq, tbdf, name);
-		return;
-	}
-
 	v = xalloc(sizeof(Vctl));
 	v->isintr = 1;
 	v->irq = irq;
 	v->tbdf = tbdf;
 	v->f = f;
 	v->a = a;
+	v->cpu = -1;
+	v->msino = -1;
 	strncpy(v->name, name, KNAMELEN-1);
 	v->name[KNAMELEN-1] = 0;
+	return v;
+}
 
+/* call with vctllock held */
+static void
+vctladd(Vctl *v, int vno)
+{
+	v->vno = vno;
+	if(vctl[vno]){
+		if(vctl[vno]->isr != v->isr || vctl[vno]->eoi != v->eoi)
+			panic("intrenable: handler: %s %s %#p %#p %#p %#p",
+				vctl[vno]->name, v->name,
+				vctl[vno]->isr, v->isr, vctl[vno]->eoi, v->eoi);
+		v->next = vctl[vno];
+	}
+	vctl[vno] = v;
+}
+
+void
+intrenable(int irq, void (*f)(Ureg*, void*), void* a, int tbdf, char *name)
+{
+	int vno;
+	Vctl *v;
+
+	if(f == nil){
+		print("intrenable: nil handler for %d, tbdf 0x%uX for %s\n",
+			irq, tbdf, name);
+		return;
+	}
+
+	v = vctlalloc(irq, f, a, tbdf, name);
 	ilock(&vctllock);
 	vno = arch->intrenable(v);
 	if(vno == -1){
@@ -58,15 +91,42 @@ intrenable(int irq, void (*f)(Ureg*, void*), void* a, int tbdf, char *name)
 		xfree(v);
 		return;
 	}
-	if(vctl[vno]){
-		if(vctl[vno]->isr != v->isr || vctl[vno]->eoi != v->eoi)
-			panic("intrenable: handler: %s %s %#p %#p %#p %#p",
-				vctl[vno]->name, v->name,
-				vctl[vno]->isr, v->isr, vctl[vno]->eoi, v->eoi);
-		v->next = vctl[vno];
+	vctladd(v, vno);
+	iunlock(&vctllock);
+}
+
+/*
+ * enable message signalled interrupt n of p (an msi-x table
+ * entry, or -1 for msi) on a vector of its own, directed at
+ * processor machno, or wherever the arch's policy puts it if
+ * machno is -1.  returns -1 if the device or the arch can't do
+ * it; the caller should fall back to intrenable on p->intl.
+ */
+int
+intrenablemsi(Pcidev *p, int n, int machno, void (*f)(Ureg*, void*), void *a, char *name)
+{
+	int vno;
+	Vctl *v;
+
+	if(f == nil || arch->msienable == nil || getconf("*nomsi") != nil)
+		return -1;
+	if(n >= 0 && pcimsixmap(p) == nil)
+		return -1;
+
+	v = vctlalloc(p->intl, f, a, p->tbdf, name);
+	v->msidev = p;
+	v->msino = n;
+	v->cpu = machno;
+	ilock(&vctllock);
+	vno = arch->msienable(v);
+	if(vno == -1){
+		iunlock(&vctllock);
+		xfree(v);
+		return -1;
 	}
-	vctl[vno] = v;
+	vctladd(v, vno);
 	iunlock(&vctllock);
+	return 0;
 }
 
 int
@@ -75,6 +135,21 @@ intrdisable(int irq, void (*f)(Ureg *, void *), void *a, int tbdf, char *name)
 	Vctl **pv, *v;
 	int vno;
 
+	/* message signalled ones are found by all but irq */
+	ilock(&vctllock);
+	for(vno = 0; vno < nelem(vctl); vno++)
+		for(pv = &vctl[vno]; (v = *pv) != nil; pv = &v->next)
+			if(v->msidev != nil && v->tbdf == tbdf && v->f == f &&
+			   v->a == a && strcmp(v->name, name) == 0){
+				*pv = v->next;
+				if(arch->msidisable != nil)
+					arch->msidisable(v);
+				iunlock(&vctllock);
+				xfree(v);
+				return 0;
+			}
+	iunlock(&vctllock);
+
 	/*
 	 * For now, none of this will work with the APIC code,
 	 * there is no mapping between irq and vector as the IRQ
@@ -140,6 +215,97 @@ irqallocread(Chan*, void *vbuf, long n, vlong offset)
 	return oldn - n;
 }
 
+/*
+ * one line per handler: vector, irq, cpu and, for irqstat,
+ * the vector's counts; handlers sharing a vector share them.
+ */
+static long
+irqtextread(void *a, long n, vlong offset, int stats)
+{
+	char *buf, *p, *e;
+	int vno;
+	Vctl *v;
+	Intrstat *s;
+
+	buf = smalloc(16*1024);
+	p = buf;
+	e = buf+16*1024;
+	ilock(&vctllock);
+	for(vno=0; vno<nelem(vctl); vno++){
+		s = &intrstats[vno];
+		if(vctl[vno] == nil && stats && s->spurious != 0)
+			p = seprint(p, e, "%11d %11d %11d %11lud %11lud %20llud %s\n",
+				vno, -1, -1, 0UL, s->spurious, 0ULL, "spurious");
+		for(v=vctl[vno]; v; v=v->next){
+			if(!v->isintr)
+				continue;
+			if(stats)
+				p = seprint(p, e, "%11d %11d %11d %11lud %11lud %20llud %.*s\n",
+					vno, v->irq, v->cpu, s->count, s->spurious,
+					s->cycles, KNAMELEN, v->name);
+			else
+				p = seprint(p, e, "%11d %11d %.*s\n",
+					vno, v->cpu, KNAMELEN, v->name);
+		}
+	}
+	iunlock(&vctllock);
+	n = readstr(offset, a, n, buf);
+	free(buf);
+	return n;
+}
+
+static long
+irqstatread(Chan*, void *a, long n, vlong offset)
+{
+	return irqtextread(a, n, offset, 1);
+}
+
+static long
+irqaffinityread(Chan*, void *a, long n, vlong offset)
+{
+	return irqtextread(a, n, offset, 0);
+}
+
+/*
+ * "vector machno" moves an interrupt vector, and every
+ * handler on it, to another processor.
+ */
+static long
+irqaffinitywrite(Chan*, void *a, long n, vlong)
+{
+	int vno, machno;
+	Cmdbuf *cb;
+	Vctl *v;
+
+	cb = parsecmd(a, n);
+	if(waserror()){
+		free(cb);
+		nexterror();
+	}
+	if(cb->nf != 2)
+		cmderror(cb, "usage: vector machno");
+	vno = strtol(cb->f[0], 0, 0);
+	machno = strtol(cb->f[1], 0, 0);
+	if(vno < 0 || vno >= nelem(vctl) || machno < 0 || machno >= conf.nmach)
+		error(Ebadarg);
+	if(arch->intrassign == nil)
+		error("can't move interrupts with this interrupt controller");
+
+	ilock(&vctllock);
+	v = vctl[vno];
+	if(v == nil || !v->isintr || (machno = arch->intrassign(v, machno)) == -1){
+		iunlock(&vctllock);
+		error("can't move that vector");
+	}
+	for(; v != nil; v = v->next)
+		v->cpu = machno;
+	iunlock(&vctllock);
+
+	free(cb);
+	poperror();
+	return n;
+}
+
 void
 trapenable(int vno, void (*f)(Ureg*, void*), void* a, char *name)
 {
@@ -227,6 +393,8 @@ trapinit(void)
 	nmienable();
 
 	addarchfile("irqalloc", 0444, irqallocread, nil);
+	addarchfile("irqaffinity", 0664, irqaffinityread, irqaffinitywrite);
+	addarchfile("irqstat", 0444, irqstatread, nil);
 	trapinited = 1;
 }
 
@@ -281,6 +449,7 @@ intrtime(Mach*, int vno)
 	m->perf.inintr += diff;
 	if(up == nil && m->perf.inidle > diff)
 		m->perf.inidle -= diff;
+	intrstats[vno].cycles += diff;
 
 	diff /= m->cpumhz*100;		/* quantum = 100µsec */
 	if(diff >= Ntimevec)
@@ -338,6 +507,7 @@ trap(Ureg* ureg)
 	if(ctl = vctl[vno]){
 		if(ctl->isintr){
 			m->intr++;
+			intrstats[vno].count++;
 			if(vno >= VectorPIC && vno != VectorSYSCALL)
 				m->lastintr = ctl->irq;
 		}
@@ -410,6 +580,7 @@ trap(Ureg* ureg)
 			print("\n");
 		}
 		m->spuriousintr++;
+		intrstats[vno].spurious++;
 		if(user)
 			kexit(ureg);
 		return;
@@ -679,6 +850,7 @@ syscall(Ureg* ureg)
 	sp = ureg->usp;
 	scallnr = ureg->ax;
 	up->scallnr = scallnr;
+	statsyscall(scallnr);
 
 	if(up->procctl == Proc_tracesyscall){
 		/*
@@ -38,6 +38,24 @@ static int curphdr;
 static ulong curoff;
 static ulong elftotal;
 
+/*
+ * a gzipped kernel is inflated by a kproc as it's read,
+ * straight into place.
+ */
+static struct {
+	Rendez	r;		/* inflater waits for input */
+	Rendez	done;		/* loader waits for inflater */
+	char	*rp;		/* next compressed byte */
+	int	eof;		/* no more input coming */
+	int	finished;
+	int	err;
+
+	ulong	nout;		/* bytes inflated */
+	uchar	*op;		/* next byte of kernel */
+	uchar	*oe;		/* end of text+data; symbols are dropped */
+} gz;
+
+static void gzstart(Boot*);
 static uvlong (*swav)(uvlong);
 static long (*swal)(long);
 static ushort (*swab)(ushort);
@@ -604,6 +622,7 @@ readexec(Boot *b)
 		memmove(b->bp, &b->hdr, sizeof(Exechdr));
 		b->wp += sizeof(Exechdr);
 		print("gz...");
+		gzstart(b);
 	} else {
 		print("bad kernel format (magic %#lux)\n", magic);
 		return bootfail(b);
@@ -624,30 +643,41 @@ boot9(Boot *b, ulong magic, ulong entry)
 		print("bad magic %#lux\n", magic);
 }
 
-/* only returns upon failure */
-static void
-readgzip(Boot *b)
+static int
+gzmore(void *a)
 {
-	ulong entry, text, data, bss, magic, all, pentry;
-	uchar *sdata;
-	Exechdr *hdr;
+	Boot *b;
 
-	/* the whole gzipped kernel is now at b->bp */
-	hdr = &b->hdr;
-	if(!isgzipped((uchar *)b->bp)) {
-		print("lost magic\n");
-		return;
-	}
-	print("%ld => ", b->wp - b->bp);
-	/* just fill hdr from gzipped b->bp, to get various sizes */
-	if(gunzip((uchar*)hdr, sizeof *hdr, (uchar*)b->bp, b->wp - b->bp)
-	    < sizeof *hdr) {
-		print("error uncompressing kernel exec header\n");
-		return;
+	b = a;
+	return gz.rp < b->wp || gz.eof;
+}
+
+static int
+gzget(void *a)
+{
+	Boot *b;
+
+	b = a;
+	while(gz.rp >= b->wp){
+		if(gz.eof)
+			return -1;
+		sleep(&gz.r, gzmore, b);
 	}
+	return (uchar)*gz.rp++;
+}
+
+/*
+ * the exec header has been inflated into b->hdr;
+ * check it and aim the rest at the kernel's load address.
+ */
+static void
+gzplace(Boot *b)
+{
+	ulong entry, text, data, bss, pentry;
+	Exechdr *hdr;
 
 	/* assume uncompressed kernel is a plan 9 boot image */
-	magic = GLLONG(hdr->magic);
+	hdr = &b->hdr;
 	entry = GLLONG(hdr->entry);
 	text = GLLONG(hdr->text);
 	data = GLLONG(hdr->data);
@@ -660,19 +690,90 @@ readgzip(Boot *b)
 	if (PGROUND(pentry + text) + data > MB + Kernelmax)
 		panic("kernel larger than %d bytes", Kernelmax);
 
-	/* fill entry from gzipped b->bp */
-	all = sizeof(Exec) + text + data;
-	if(gunzip((uchar *)KADDR(PADDR(entry)) - sizeof(Exec), all,
-	    (uchar*)b->bp, b->wp - b->bp) < all) {
+	gz.op = (uchar *)KADDR(pentry) - sizeof(Exec);
+	gz.oe = gz.op + sizeof(Exec) + text + data;
+	memmove(gz.op, hdr, sizeof *hdr);
+	gz.op += sizeof *hdr;
+}
+
+static int
+gzput(void *a, void *buf, int n)
+{
+	Boot *b;
+	uchar *p;
+	int k;
+
+	b = a;
+	p = buf;
+	k = n;
+	if(gz.nout < sizeof(Exechdr)){
+		if(k > sizeof(Exechdr) - gz.nout)
+			k = sizeof(Exechdr) - gz.nout;
+		memmove((uchar *)&b->hdr + gz.nout, p, k);
+		gz.nout += k;
+		p += k;
+		k = n - k;
+		if(gz.nout == sizeof(Exechdr))
+			gzplace(b);
+	}
+	if(k > gz.oe - gz.op)
+		k = gz.oe - gz.op;
+	if(k > 0){
+		memmove(gz.op, p, k);
+		gz.op += k;
+		gz.nout += k;
+	}
+	return n;
+}
+
+static void
+gzproc(void *a)
+{
+	gz.err = gunzipstream(a, gzget, a, gzput) < 0 || gz.op == nil;
+	gz.finished = 1;
+	wakeup(&gz.done);
+}
+
+static int
+gzfinished(void *)
+{
+	return gz.finished;
+}
+
+static void
+gzstart(Boot *b)
+{
+	memset(&gz, 0, sizeof gz);
+	gz.rp = b->bp;
+	kproc("gunzip", gzproc, b);
+}
+
+/* only returns upon failure */
+static void
+readgzip(Boot *b)
+{
+	ulong entry, text, data;
+	uchar *sdata;
+
+	/* the last of the gzipped kernel is now at b->bp */
+	gz.eof = 1;
+	wakeup(&gz.r);
+	sleep(&gz.done, gzfinished, nil);
+	print("%ld => %lud\n", b->wp - b->bp, gz.nout);
+	if(gz.err) {
 		print("error uncompressing kernel\n");
 		return;
 	}
 
+	entry = GLLONG(b->hdr.entry);
+	text = GLLONG(b->hdr.text);
+	data = GLLONG(b->hdr.data);
+
 	/* relocate data to start at page boundary */
 	sdata = KADDR(PADDR(entry+text));
 	memmove((void*)PGROUND((uintptr)sdata), sdata, data);
 
-	boot9(b, magic, entry);
+	boot9(b, GLLONG(b->hdr.magic), entry);
 }
 
 /*
@@ -695,6 +796,10 @@ bootpass(Boot *b, void *vbuf, int nbuf)
 	if(nbuf == 0)
 		goto Endofinput;
 
+	/* don't read the rest of a kernel that won't inflate */
+	if(b->state == READGZIP && gz.finished && gz.err)
+		return bootfail(b);
+
 	buf = vbuf;
 	ebuf = buf+nbuf;
 	/* possibly copy into b->wp from buf (not first time) */
@@ -785,6 +890,8 @@ bootpass(Boot *b, void *vbuf, int nbuf)
 		if(b->state == FAILED)
 			return FAIL;
 	}
+	if(b->state == READGZIP)
+		wakeup(&gz.r);
 	return MORE;
 
 Endofinput:
@@ -38,6 +38,7 @@ enum {
 
 	Minsectsz	= 512,		/* for disks */
 	Maxsectsz	= 2048,		/* for optical (CDs, etc.) */
+	Maxxfer		= 32*1024,	/* bytes per multi-sector read */
 
 	Highshort	= ((1ul<<16) - 1) << 16,  /* upper short of a long */
 
@@ -475,48 +476,75 @@ biosboot(int dev, char *file, Boot *b)
 }
 #endif
 
+/*
+ * buffer for reads of more than one sector.  the bios needs it below
+ * 1MB; it's addressed seg:off, so it needn't be in the bottom 64K.
+ * loaders linked above 1MB make do with one sector per call.
+ */
+static uchar xferbuf[Maxxfer];
+
+static uchar *
+lowxfer(void)
+{
+	if(PADDR(xferbuf) + Maxxfer > BIOSTABLES)
+		return nil;
+	return xferbuf;
+}
+
+/* bytes to ask sectread for at once */
+static long
+sectmax(Biosdev *bdp)
+{
+	if(lowxfer() == nil)
+		return bdp->sectsz;
+	return Maxxfer - Maxxfer % bdp->sectsz;
+}
+
 /* read n bytes at sector offset into a from drive id */
 long
 sectread(Biosdev *bdp, void *a, long n, Devsects offset)
 {
 	uchar *xch;
 	uintptr xchaddr;
+	int nsect;
 	Dap *dap;
 
-	if(bdp->sectsz <= 0 || n < 0 || n > bdp->sectsz)
+	if(bdp->sectsz <= 0 || n < 0 || n > sectmax(bdp))
 		return -1;
-	xch = (uchar *)BIOSXCHG;
-	assertlow64k(PADDR(xch), "biosxchg");
+	nsect = (n + bdp->sectsz - 1) / bdp->sectsz;
+	if(nsect <= 1){
+		nsect = 1;
+		xch = (uchar *)BIOSXCHG;
+		assertlow64k(PADDR(xch), "biosxchg");
+	} else
+		xch = lowxfer();
 	if(Debug)
 		/* scribble on the buffer to provoke trouble */
-		memset(xch, 'r', bdp->sectsz);
+		memset(xch, 'r', nsect * bdp->sectsz);
 
-	/* read into BIOSXCHG; alloc space for a worst-case (optical) sector */
-	dap = (Dap *)(xch + Maxsectsz);
+	/* dap follows BIOSXCHG's space for a worst-case (optical) sector */
+	dap = (Dap *)((uchar *)BIOSXCHG + Maxsectsz);
 	assertlow64k(PADDR(dap), "Dap");
 	memset(dap, 0, sizeof *dap);
 	dap->size = sizeof *dap;
-	dap->nsects = 1;
+	dap->nsects = nsect;
 	dap->stsect = offset;
 
 	xchaddr = PADDR(xch);
-	assertlow64k(xchaddr, "sectread buffer");
-	dap->addr = xchaddr;		/* ulong version */
-	dap->addroff = xchaddr;		/* pedantic seg:off */
-	dap->addrseg = 0;
+	dap->addroff = xchaddr & 0xF;	/* seg:off */
+	dap->addrseg = xchaddr >> 4;
 	dap->addr64 = xchaddr;		/* paranoid redundancy */
-	dap->lnsects = 1;
+	dap->lnsects = nsect;
 
 	/*
-	 * ensure that entire buffer fits in low memory.
+	 * ensure that entire buffer fits in one real-mode segment.
 	 */
-	if((dap->addr & Highshort) !=
-	    ((dap->addr + Minsectsz - 1) & Highshort))
+	if(dap->addroff + nsect * bdp->sectsz > 0x10000)
 		print("devbios: sectread: address %#lux too near seg boundary\n",
-			dap->addr);
+			xchaddr);
 	if (Debug)
-		print("reading bios drive %#ux sector %lld -> %#lux...",
-			bdp->id, offset, dap->addr);
+		print("reading bios drive %#ux %d sector(s) @ %lld -> %#lux...",
+			bdp->id, nsect, offset, xchaddr);
 	delay(Pause);			/* pause to read the screen (DEBUG) */
 
 	/*
@@ -528,9 +556,12 @@ sectread(Biosdev *bdp, void *a, long n, Devsects offset)
 			n, offset, bdp->id);
 		return -1;
 	}
-	if (dap->nsects != 1)
-		panic("devbios: sector read ok but read %d sectors",
-			dap->nsects);
+	/* some bioses stop short of a long request; take what came */
+	if (dap->nsects == 0 || dap->nsects > nsect)
+		panic("devbios: sector read ok but read %d of %d sectors",
+			dap->nsects, nsect);
+	if (n > dap->nsects * bdp->sectsz)
+		n = dap->nsects * bdp->sectsz;
 	if (Debug)
 		print("OK\n");
 
@@ -679,13 +710,20 @@ biosread0(Bootfs *fs, void *a, long n)
 			print("devbios: zero sector size\n");
 			return -1;
 		}
+		part = offset % bdp->sectsz;
 		want = bdp->sectsz;
+		if (part == 0 && n - totnr >= 2*bdp->sectsz) {
+			/* whole sectors, several per bios call */
+			want = n - totnr;
+			if (want > sectmax(bdp))
+				want = sectmax(bdp);
+			want -= want % bdp->sectsz;
+		}
 		if (totnr + want > n)
 			want = n - totnr;
 		if(0 && Debug && debugload)
 			print("bios%d, read: %ld @ off %lld, want: %d, id: %#ux\n",
 				dev, n, offset, want, bdp->id);
-		part = offset % bdp->sectsz;
 		if (part != 0) {	/* back up to start of sector */
 			offset -= part;
 			totnr  -= part;
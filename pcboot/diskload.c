@@ -19,7 +19,7 @@
 #define	STATMAX	65535U	/* max length of machine-independent stat structure */
 
 enum {
-	Bufsize = 8192,
+	Bufsize = 32*1024,	/* match devbios's Maxxfer */
 };
 
 int	dosdirread(File *f, char ***nmarray);
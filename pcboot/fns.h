@@ -7,6 +7,7 @@ void changeconf(char *fmt, ...);
 Dir *dirchstat(Chan *chan);
 int getstr(char *prompt, char *buf, int size, char *def, int timeout);
 int gunzip(uchar*, int, uchar*, int);
+int gunzipstream(void*, int (*)(void*), void*, int (*)(void*, void*, int));
 void i8042a20(void);
 void (*i8237alloc)(void);
 void impulse(void);
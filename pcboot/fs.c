@@ -11,7 +11,7 @@
 #include	"dosfs.h"
 
 enum {
-	Bufsize = 8192,
+	Bufsize = 32*1024,	/* match devbios's Maxxfer */
 };
 
 /*
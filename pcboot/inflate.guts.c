@@ -1,6 +1,7 @@
 /* included by expand and 9boot with different header files */
 
 typedef struct Biobuf	Biobuf;
+typedef struct Gzstream	Gzstream;
 
 struct Biobuf
 {
@@ -9,13 +10,21 @@ struct Biobuf
 	uchar *ep;
 };
 
+struct Gzstream
+{
+	int	(*put)(void*, void*, int);
+	void	*arg;
+	ulong	n;		/* bytes put */
+};
+
 static ulong	Boffset(Biobuf *bp);
 static int	crcwrite(void *out, void *buf, int n);
-static ulong	get4(Biobuf *b);
+static ulong	get4(void*, int (*)(void*));
 static int	getc(void*);
-static int	header(Biobuf*);
+static int	header(void*, int (*)(void*));
 static ulong	offset(Biobuf*);
-static int	trailer(Biobuf*, Biobuf*);
+static int	trailer(ulong, void*, int (*)(void*));
+static int	streamwrite(void *out, void *buf, int n);
 
 /* GZIP flags */
 enum {
@@ -48,7 +57,7 @@ gunzip(uchar *out, int outn, uchar *in, int inn)
 	bout.bp = bout.p = out;
 	bout.ep = out+outn;
 
-	err = header(&bin);
+	err = header(&bin, getc);
 	if(err != FlateOk)
 		return err;
 
@@ -56,72 +65,110 @@ gunzip(uchar *out, int outn, uchar *in, int inn)
 	if(err != FlateOk)
 		print("inflate failed: %s\n", flateerr(err));
 
-	err = trailer(&bout, &bin);
+	err = trailer(Boffset(&bout), &bin, getc);
 	if(err != FlateOk)
 		return err;
 
 	return Boffset(&bout);
 }
 
+/*
+ * gunzip as the input arrives: get returns the next byte of
+ * the gzipped stream, blocking if need be, or -1 at its end;
+ * put takes each run of output and returns -1 to give up.
+ */
+int
+gunzipstream(void *in, int (*get)(void*), void *arg, int (*put)(void*, void*, int))
+{
+	Gzstream out;
+	int err;
+
+	crc = 0;
+	crctab = mkcrctab(GZCRCPOLY);
+	err = inflateinit();
+	if(err != FlateOk)
+		print("inflateinit failed: %s\n", flateerr(err));
+
+	out.put = put;
+	out.arg = arg;
+	out.n = 0;
+
+	err = header(in, get);
+	if(err != FlateOk)
+		return err;
+
+	err = inflate(&out, streamwrite, in, get);
+	if(err != FlateOk){
+		print("inflate failed: %s\n", flateerr(err));
+		return err;
+	}
+
+	err = trailer(out.n, in, get);
+	if(err != FlateOk)
+		return err;
+
+	return out.n;
+}
+
 static int
-header(Biobuf *bin)
+header(void *in, int (*get)(void*))
 {
 	int i, flag;
 
-	if(getc(bin) != 0x1f || getc(bin) != 0x8b){
+	if(get(in) != 0x1f || get(in) != 0x8b){
 		print("bad magic\n");
 		return FlateCorrupted;
 	}
-	if(getc(bin) != 8){
+	if(get(in) != 8){
 		print("unknown compression type\n");
 		return FlateCorrupted;
 	}
 	
-	flag = getc(bin);
+	flag = get(in);
 	
 	/* mod time */
-	get4(bin);
+	get4(in, get);
 	
 	/* extra flags */
-	getc(bin);
+	get(in);
 	
 	/* OS type */
-	getc(bin);
+	get(in);
 
 	if(flag & Fextra)
-		for(i=getc(bin); i>0; i--)
-			getc(bin);
+		for(i=get(in); i>0; i--)
+			get(in);
 	
 	/* name */
 	if(flag&Fname)
-		while(getc(bin) != 0)
+		while(get(in) > 0)
 			;
 
 	/* comment */
 	if(flag&Fcomment)
-		while(getc(bin) != 0)
+		while(get(in) > 0)
 			;
 
 	/* crc16 */
 	if(flag&Fhcrc) {
-		getc(bin);
-		getc(bin);
+		get(in);
+		get(in);
 	}
 		
 	return FlateOk;
 }
 
 static int
-trailer(Biobuf *bout, Biobuf *bin)
+trailer(ulong nout, void *in, int (*get)(void*))
 {
 	/* crc32 */
-	if(crc != get4(bin)){
+	if(crc != get4(in, get)){
 		print("crc mismatch\n");
 		return FlateCorrupted;
 	}
 
 	/* length */
-	if(get4(bin) != Boffset(bout)){
+	if(get4(in, get) != nout){
 		print("bad output len\n");
 		return FlateCorrupted;
 	}
@@ -129,14 +176,14 @@ trailer(Biobuf *bout, Biobuf *bin)
 }
 
 static ulong
-get4(Biobuf *b)
+get4(void *in, int (*get)(void*))
 {
 	ulong v;
 	int i, c;
 
 	v = 0;
 	for(i = 0; i < 4; i++){
-		c = getc(b);
+		c = get(in);
 		v |= c << (i * 8);
 	}
 	return v;
@@ -178,3 +225,16 @@ crcwrite(void *out, void *buf, int n)
 	bp->p += n;
 	return n;
 }
+
+static int
+streamwrite(void *out, void *buf, int n)
+{
+	Gzstream *gz;
+
+	crc = blockcrc(crctab, crc, buf, n);
+	gz = out;
+	if(gz->put(gz->arg, buf, n) < 0)
+		return -1;
+	gz->n += n;
+	return n;
+}
@@ -374,8 +374,8 @@ mmurelease(Proc* proc)
 			panic("mmurelease: page->ref %d", page->ref);
 		pagechainhead(page);
 	}
-	if(proc->mmufree && palloc.r.p)
-		wakeup(&palloc.r);
+	if(proc->mmufree && palloc.pwait.head != nil)
+		sqwakeup(&palloc.pwait);
 	proc->mmufree = 0;
 }
 
@@ -7,3 +7,10 @@ gunzip(uchar *, int, uchar *, int)
 	print("booting gzipped kernels is not supported by this bootstrap.\n");
 	return -1;
 }
+
+int
+gunzipstream(void*, int (*)(void*), void*, int (*)(void*, void*, int))
+{
+	print("booting gzipped kernels is not supported by this bootstrap.\n");
+	return -1;
+}
@@ -30,8 +30,9 @@ enum {
 	 * this can be bigger than the ether mtu and
 	 * will work due to ip fragmentation, at least on v4.
 	 */
-	Prefsegsize =	1400,
+	Prefsegsize =	1468,	/* fills a 1500-byte ether frame */
 	Maxsegsize =	2048,
+	Prefwindow =	8,	/* blocks sent per ack (rfc7440) */
 	Bufsz =		Maxsegsize + 2,
 };
 
@@ -83,6 +84,8 @@ static int tftpblockno;
 static int tftpphase;
 static int progress;
 static int segsize;
+static int tftpwindow;
+static int tftpacked;		/* last block acked */
 static Tftp *tftpb;
 
 static uchar myea[Eaddrlen];
@@ -326,6 +329,7 @@ ack(Openeth *oe, Pxenetaddr *a, int blkno)
 	buf[2] = blkno>>8;
 	buf[3] = blkno;
 	udpsend(oe, a, buf, sizeof buf);
+	tftpacked = blkno;
 }
 
 static char *
@@ -375,6 +379,8 @@ tftpread1st(Openeth *oe, Pxenetaddr *a, char *name, Tftp *tftp)
 	len += snprint(buf+len, Bufsz - len, "octet") + 1;
 	len += snprint(buf+len, Bufsz - len, "blksize") + 1; /* option */
 	len += snprint(buf+len, Bufsz - len, "%d", Prefsegsize) + 1;
+	len += snprint(buf+len, Bufsz - len, "windowsize") + 1;
+	len += snprint(buf+len, Bufsz - len, "%d", Prefwindow) + 1;
 
 	/*
 	 * keep sending the same packet until we get an answer.
@@ -389,7 +395,9 @@ tftpread1st(Openeth *oe, Pxenetaddr *a, char *name, Tftp *tftp)
 	oe->rxactive = 0;
 	oport = a->port;
 	tftpblockno = 0;
+	tftpacked = 0;
 	segsize = Defsegsize;
+	tftpwindow = 1;
 	sendack = 0;
 	for(i = 0; i < 10; i++){
 		a->port = oport;
@@ -415,6 +423,10 @@ tftpread1st(Openeth *oe, Pxenetaddr *a, char *name, Tftp *tftp)
 				return -1;
 			}
 			segsize = n;
+			/* servers without rfc7440 leave windowsize out */
+			n = optval("windowsize", (char *)tftp->header+2, rlen-2);
+			if (n > 0)
+				tftpwindow = n;
 			/* no bytes stashed in tftp.data */
 			i = 0;
 			sendack = 1;
@@ -448,17 +460,30 @@ tftpread1st(Openeth *oe, Pxenetaddr *a, char *name, Tftp *tftp)
 static int
 tftpread(Openeth *oe, Pxenetaddr *a, Tftp *tftp, int dlen)
 {
-	int try, blockno, len;
+	int try, blockno, len, resend, gap;
 
 	dlen += Tftphdrsz;
 
 	/*
-	 * keep sending ACKs until we get an answer.
+	 * the server sends a window of blocks per ack, so ack only
+	 * the last of each.  a gap is acked once, to have the server
+	 * go back to it; after a time-out, keep sending ACKs until
+	 * we get an answer.  only time-outs use up tries, since a
+	 * window's worth of stale blocks may follow a loss.
 	 */
-	for(try = 0; try < 10; try++) {
-		ack(oe, a, tftpblockno);
+	resend = 0;
+	gap = 0;
+	for(try = 0; try < 10; ) {
+		if(resend || tftpblockno - tftpacked >= tftpwindow)
+			ack(oe, a, tftpblockno);
+		resend = 0;
 
 		len = udprecv(oe, a, tftp, dlen);
+		if(len <= 0){
+			try++;
+			resend = 1;
+			continue;
+		}
 		/*
 		 * NB: not `<='; just a header is legal and happens when
 		 * file being read is a multiple of segsize bytes long.
@@ -492,6 +517,8 @@ tftpread(Openeth *oe, Pxenetaddr *a, Tftp *tftp, int dlen)
 			if(Debug)
 				print("tftpread: blkno %d <= %d\n",
 					blockno, tftpblockno);
+			/* the rest of a window already acked past */
+			resend = tftpwindow == 1;
 			continue;
 		}
 
@@ -501,8 +528,12 @@ tftpread(Openeth *oe, Pxenetaddr *a, Tftp *tftp, int dlen)
 				ack(oe, a, tftpblockno);
 			return len-Tftphdrsz;
 		}
-		print("tftpread: block error: %d, expected %d\n",
-			blockno, tftpblockno+1);
+		if(!gap){
+			print("tftpread: block error: %d, expected %d\n",
+				blockno, tftpblockno+1);
+			gap = 1;
+			resend = 1;
+		}
 	}
 
 	return -1;
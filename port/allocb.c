@@ -29,6 +29,7 @@ _allocb(int size)
 	b->next = nil;
 	b->list = nil;
 	b->free = 0;
+	b->pool = nil;
 	b->flag = 0;
 	b->ref = 0;
 	_xinc(&b->ref);
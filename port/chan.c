@@ -187,16 +187,96 @@ kstrdup(char **p, char *s)
 
 static int debugstart = 1;
 
+/*
+ *  devices whose reset and init are left to a kproc each, so that
+ *  slow probes (ether autonegotiation, disk spin-up, usb port resets)
+ *  overlap each other and the rest of boot.  they are reached only
+ *  through attach, which waits for them.  *nodevproc turns it off.
+ */
+static char devprocs[] = "lSu";
+
+/*
+ *  the devices bootargs names come up ahead of the others,
+ *  so /boot can start before unrelated probes finish.
+ */
+static int
+isrootdev(int dc)
+{
+	char *s;
+
+	if((s = getconf("bootargs")) == nil && (s = getconf("nobootprompt")) == nil)
+		return 0;
+	switch(dc){
+	case 'S':
+		return strncmp(s, "local", 5) == 0 || strstr(s, "#S") != nil;
+	case 'l':
+		return strncmp(s, "tcp", 3) == 0 || strncmp(s, "il", 2) == 0;
+	}
+	return 0;
+}
+
+static int
+devisready(void *a)
+{
+	return !((Dev*)a)->pending;
+}
+
+static void
+devinitproc(void *a)
+{
+	Dev *d;
+
+	d = a;
+	if(!isrootdev(d->dc))
+		procpriority(up, PriNormal-1, 0);
+	if(!waserror()){
+		d->reset();
+		d->init();
+		poperror();
+	}else
+		print("%s: init: %s\n", d->name, up->errstr);
+	if(debugstart)
+		iprint("init: %s ready\n", d->name);
+	d->pending = 0;
+	coherence();
+	wakeup(&d->ready);
+	pexit("", 1);
+}
+
+/*
+ *  wait for a device's kproc to finish its reset and init
+ */
+void
+devready(Dev *d)
+{
+	if(!d->pending || up == nil)
+		return;
+	qlock(&d->readyq);
+	if(waserror()){
+		qunlock(&d->readyq);
+		nexterror();
+	}
+	sleep(&d->ready, devisready, d);
+	poperror();
+	qunlock(&d->readyq);
+}
+
 void
 chandevreset(void)
 {
-	int i;
+	int i, defer;
 
 	todinit();	/* avoid later reentry causing infinite recursion */
 	debugstart = getconf("*debugstart") != nil;
+	defer = getconf("*nodevproc") == nil;
 	if(debugstart)
 		iprint("reset:");
 	for(i=0; devtab[i] != nil; i++) {
+		if(defer && devtab[i]->dc < Runeself
+		&& strchr(devprocs, devtab[i]->dc) != nil){
+			devtab[i]->pending = 1;
+			continue;
+		}
 		if(debugstart)
 			iprint(" %s", devtab[i]->name);
 		devtab[i]->reset();
@@ -212,7 +292,15 @@ chandevinit(void)
 
 	if(debugstart)
 		iprint("init:");
+	for(i=0; devtab[i] != nil; i++)
+		if(devtab[i]->pending && isrootdev(devtab[i]->dc))
+			kproc(devtab[i]->name, devinitproc, devtab[i]);
 	for(i=0; devtab[i] != nil; i++) {
+		if(devtab[i]->pending){
+			if(!isrootdev(devtab[i]->dc))
+				kproc(devtab[i]->name, devinitproc, devtab[i]);
+			continue;
+		}
 		if(debugstart)
 			iprint(" %s", devtab[i]->name);
 		devtab[i]->init();
@@ -230,7 +318,8 @@ chandevshutdown(void)
 	for(i=0; devtab[i] != nil; i++)
 		;
 	for(i--; i >= 0; i--)
-		devtab[i]->shutdown();
+		if(!devtab[i]->pending)		/* still in reset */
+			devtab[i]->shutdown();
 }
 
 Chan*
@@ -246,6 +335,7 @@ newchan(void)
 
 	if(c == nil){
 		c = smalloc(sizeof(Chan));
+		c->umqlock.pi = 1;
 		lock(&chanalloc);
 		c->fid = ++chanalloc.fid;
 		c->link = chanalloc.list;
@@ -278,20 +368,67 @@ newchan(void)
 
 Ref npath;
 
-Path*
-newpath(char *s)
+/*
+ * Paths don't change once made.  Walks build new names in a
+ * Wpath, mostly on the stack, and make a Path of it only if
+ * they succeed; the string and the mount point array are
+ * allocated with the Path.
+ *
+ * Recently made Paths are kept in a small cache so opens of
+ * the same name through the same mount points share one.
+ * The cache holds no reference: pathclose takes a Path out
+ * of it as it frees it, under the cache lock.
+ */
+enum
+{
+	Wpathslen	= 64,
+	Wpathmlen	= 8,
+	Npathcache	= 64,
+};
+
+typedef struct Wpath Wpath;
+struct Wpath
+{
+	Path	*from;		/* the name it started as */
+	int	changed;	/* s and mtpt are our own copies */
+	char	*s;
+	int	len;
+	int	alen;
+	Chan	**mtpt;		/* a reference to each */
+	int	mlen;
+	int	malen;
+	char	sbuf[Wpathslen];
+	Chan	*mbuf[Wpathmlen];
+};
+
+static struct
+{
+	Lock;
+	Path	*p[Npathcache];
+} pathcache;
+
+static Path*
+allocpath(char *s, int len, Chan **mtpt, int mlen)
 {
-	int i;
 	Path *p;
 
-	p = smalloc(sizeof(Path));
-	i = strlen(s);
-	p->len = i;
-	p->alen = i+PATHSLOP;
-	p->s = smalloc(p->alen);
-	memmove(p->s, s, i+1);
+	p = smalloc(sizeof(Path) + mlen*sizeof(Chan*) + len+1);
 	p->ref = 1;
 	incref(&npath);
+	p->mtpt = (Chan**)&p[1];
+	p->mlen = mlen;
+	memmove(p->mtpt, mtpt, mlen*sizeof(Chan*));
+	p->s = (char*)&p->mtpt[mlen];
+	p->len = len;
+	memmove(p->s, s, len);
+	p->s[len] = '\0';
+	return p;
+}
+
+Path*
+newpath(char *s)
+{
+	Chan *mtpt;
 
 	/*
 	 * Cannot use newpath for arbitrary names because the mtpt 
@@ -301,38 +438,8 @@ newpath(char *s)
 	if(strchr(s, '/') && strcmp(s, "#/") != 0 && strcmp(s, "/") != 0)
 		print("newpath: %s from %#p\n", s, getcallerpc(&s));
 
-	p->mlen = 1;
-	p->malen = PATHMSLOP;
-	p->mtpt = smalloc(p->malen*sizeof p->mtpt[0]);
-	return p;
-}
-
-static Path*
-copypath(Path *p)
-{
-	int i;
-	Path *pp;
-	
-	pp = smalloc(sizeof(Path));
-	pp->ref = 1;
-	incref(&npath);
-	DBG("copypath %s %p => %p\n", p->s, p, pp);
-	
-	pp->len = p->len;
-	pp->alen = p->alen;
-	pp->s = smalloc(p->alen);
-	memmove(pp->s, p->s, p->len+1);
-	
-	pp->mlen = p->mlen;
-	pp->malen = p->malen;
-	pp->mtpt = smalloc(p->malen*sizeof pp->mtpt[0]);
-	for(i=0; i<pp->mlen; i++){
-		pp->mtpt[i] = p->mtpt[i];
-		if(pp->mtpt[i])
-			incref(pp->mtpt[i]);
-	}
-
-	return pp;
+	mtpt = nil;
+	return allocpath(s, strlen(s), &mtpt, 1);
 }
 
 void
@@ -348,29 +455,160 @@ pathclose(Path *p)
 		DBG(" %p", p->mtpt[i]);
 	DBG("\n");
 
-	if(decref(p))
+	if(p->incache){
+		lock(&pathcache);
+		if(decref(p)){
+			unlock(&pathcache);
+			return;
+		}
+		if(p->incache && pathcache.p[p->incache-1] == p)
+			pathcache.p[p->incache-1] = nil;
+		unlock(&pathcache);
+	}else if(decref(p))
 		return;
 	decref(&npath);
-	free(p->s);
 	for(i=0; i<p->mlen; i++)
 		if(p->mtpt[i])
 			cclose(p->mtpt[i]);
-	free(p->mtpt);
 	free(p);
 }
 
+static void
+wpathinit(Wpath *w, Path *p)
+{
+	incref(p);
+	w->from = p;
+	w->changed = 0;
+}
+
+/*
+ * Copy the name before the first change.
+ */
+static void
+wpathown(Wpath *w)
+{
+	Path *p;
+	int i;
+
+	if(w->changed)
+		return;
+	w->changed = 1;
+	p = w->from;
+
+	w->len = p->len;
+	w->alen = Wpathslen;
+	w->s = w->sbuf;
+	if(p->len+1 > w->alen){
+		w->alen = p->len+1+PATHSLOP;
+		w->s = smalloc(w->alen);
+	}
+	memmove(w->s, p->s, p->len+1);
+
+	w->mlen = p->mlen;
+	w->malen = Wpathmlen;
+	w->mtpt = w->mbuf;
+	if(p->mlen > w->malen){
+		w->malen = p->mlen+PATHMSLOP;
+		w->mtpt = smalloc(w->malen*sizeof(Chan*));
+	}
+	for(i=0; i<p->mlen; i++){
+		w->mtpt[i] = p->mtpt[i];
+		if(w->mtpt[i])
+			incref(w->mtpt[i]);
+	}
+	w->from = nil;
+	pathclose(p);
+}
+
+/*
+ * Drop a Wpath that won't be made into a Path.
+ */
+static void
+wpathfree(Wpath *w)
+{
+	int i;
+
+	if(!w->changed){
+		pathclose(w->from);
+		w->from = nil;
+		return;
+	}
+	for(i=0; i<w->mlen; i++)
+		if(w->mtpt[i])
+			cclose(w->mtpt[i]);
+	if(w->s != w->sbuf)
+		free(w->s);
+	if(w->mtpt != w->mbuf)
+		free(w->mtpt);
+	w->changed = 0;
+}
+
+static ulong
+pathhash(char *s, int mlen)
+{
+	ulong h;
+
+	h = mlen;
+	while(*s)
+		h = h*31 + *s++;
+	return h % Npathcache;
+}
+
+/*
+ * The Path for a Wpath: the one it started from if it wasn't
+ * changed, or one like it from the cache, or a new one.
+ * The Wpath's references go to the Path.
+ */
+static Path*
+wpathdone(Wpath *w)
+{
+	Path *p;
+	ulong h;
+
+	if(!w->changed)
+		return w->from;
+
+	h = pathhash(w->s, w->mlen);
+	lock(&pathcache);
+	p = pathcache.p[h];
+	if(p != nil && p->len == w->len && p->mlen == w->mlen
+	&& memcmp(p->mtpt, w->mtpt, w->mlen*sizeof(Chan*)) == 0
+	&& strcmp(p->s, w->s) == 0){
+		incref(p);
+		unlock(&pathcache);
+		wpathfree(w);
+		return p;
+	}
+	unlock(&pathcache);
+
+	p = allocpath(w->s, w->len, w->mtpt, w->mlen);
+	if(w->s != w->sbuf)
+		free(w->s);
+	if(w->mtpt != w->mbuf)
+		free(w->mtpt);
+	w->changed = 0;
+
+	lock(&pathcache);
+	if(pathcache.p[h] != nil)
+		pathcache.p[h]->incache = 0;
+	pathcache.p[h] = p;
+	p->incache = h+1;
+	unlock(&pathcache);
+	return p;
+}
+
 /*
  * In place, rewrite name to compress multiple /, eliminate ., and process ..
  * (Really only called to remove a trailing .. that has been added.
  * Otherwise would need to update n->mtpt as well.)
  */
 static void
-fixdotdotname(Path *p)
+fixdotdotname(Wpath *w)
 {
 	char *r;
 
-	if(p->s[0] == '#'){
-		r = strchr(p->s, '/');
+	if(w->s[0] == '#'){
+		r = strchr(w->s, '/');
 		if(r == nil)
 			return;
 		cleanname(r);
@@ -379,74 +617,61 @@ fixdotdotname(Path *p)
 		 * The correct name is #i rather than #i/,
 		 * but the correct name of #/ is #/.
 		 */
-		if(strcmp(r, "/")==0 && p->s[1] != '/')
+		if(strcmp(r, "/")==0 && w->s[1] != '/')
 			*r = '\0';
 	}else
-		cleanname(p->s);
-	p->len = strlen(p->s);
-}
-
-static Path*
-uniquepath(Path *p)
-{
-	Path *new;
-	
-	if(p->ref > 1){
-		/* copy on write */
-		new = copypath(p);
-		pathclose(p);
-		p = new;
-	}
-	return p;
+		cleanname(w->s);
+	w->len = strlen(w->s);
 }
 
-static Path*
-addelem(Path *p, char *s, Chan *from)
+static void
+addelem(Wpath *w, char *s, Chan *from)
 {
 	char *t;
 	int a, i;
 	Chan *c, **tt;
 
 	if(s[0]=='.' && s[1]=='\0')
-		return p;
+		return;
 
-	p = uniquepath(p);
+	wpathown(w);
 
 	i = strlen(s);
-	if(p->len+1+i+1 > p->alen){
-		a = p->len+1+i+1 + PATHSLOP;
+	if(w->len+1+i+1 > w->alen){
+		a = w->len+1+i+1 + PATHSLOP;
 		t = smalloc(a);
-		memmove(t, p->s, p->len+1);
-		free(p->s);
-		p->s = t;
-		p->alen = a;
+		memmove(t, w->s, w->len+1);
+		if(w->s != w->sbuf)
+			free(w->s);
+		w->s = t;
+		w->alen = a;
 	}
 	/* don't insert extra slash if one is present */
-	if(p->len>0 && p->s[p->len-1]!='/' && s[0]!='/')
-		p->s[p->len++] = '/';
-	memmove(p->s+p->len, s, i+1);
-	p->len += i;
+	if(w->len>0 && w->s[w->len-1]!='/' && s[0]!='/')
+		w->s[w->len++] = '/';
+	memmove(w->s+w->len, s, i+1);
+	w->len += i;
 	if(isdotdot(s)){
-		fixdotdotname(p);
-		DBG("addelem %s .. => rm %p\n", p->s, p->mtpt[p->mlen-1]);
-		if(p->mlen>1 && (c = p->mtpt[--p->mlen])){
-			p->mtpt[p->mlen] = nil;
+		fixdotdotname(w);
+		DBG("addelem %s .. => rm %p\n", w->s, w->mtpt[w->mlen-1]);
+		if(w->mlen>1 && (c = w->mtpt[--w->mlen])){
+			w->mtpt[w->mlen] = nil;
 			cclose(c);
 		}
 	}else{
-		if(p->mlen >= p->malen){
-			p->malen = p->mlen+1+PATHMSLOP;
-			tt = smalloc(p->malen*sizeof tt[0]);
-			memmove(tt, p->mtpt, p->mlen*sizeof tt[0]);
-			free(p->mtpt);
-			p->mtpt = tt;
+		if(w->mlen >= w->malen){
+			w->malen = w->mlen+1+PATHMSLOP;
+			tt = smalloc(w->malen*sizeof tt[0]);
+			memmove(tt, w->mtpt, w->mlen*sizeof tt[0]);
+			if(w->mtpt != w->mbuf)
+				free(w->mtpt);
+			w->mtpt = tt;
 		}
-		DBG("addelem %s %s => add %p\n", p->s, s, from);
-		p->mtpt[p->mlen++] = from;
+		DBG("addelem %s %s => add %p\n", w->s, s, from);
+		w->mtpt[w->mlen++] = from;
 		if(from)
 			incref(from);
 	}
-	return p;
 }
 
 void
@@ -892,50 +1117,47 @@ findmount(Chan **cp, Mhead **mp, int type, int dev, Qid qid)
  * Calls findmount but also updates path.
  */
 static int
-domount(Chan **cp, Mhead **mp, Path **path)
+domount(Chan **cp, Mhead **mp, Wpath *w)
 {
 	Chan **lc;
-	Path *p;
 
 	if(findmount(cp, mp, (*cp)->type, (*cp)->dev, (*cp)->qid) == 0)
 		return 0;
 
-	if(path){
-		p = *path;
-		p = uniquepath(p);
-		if(p->mlen <= 0)
-			print("domount: path %s has mlen==%d\n", p->s, p->mlen);
+	if(w){
+		wpathown(w);
+		if(w->mlen <= 0)
+			print("domount: path %s has mlen==%d\n", w->s, w->mlen);
 		else{
-			lc = &p->mtpt[p->mlen-1];
-DBG("domount %p %s => add %p (was %p)\n", p, p->s, (*mp)->from, p->mtpt[p->mlen-1]);
+			lc = &w->mtpt[w->mlen-1];
+DBG("domount %s => add %p (was %p)\n", w->s, (*mp)->from, w->mtpt[w->mlen-1]);
 			incref((*mp)->from);
 			if(*lc)
 				cclose(*lc);
 			*lc = (*mp)->from;
 		}
-		*path = p;
 	}
 	return 1;
 }
 
 /*
  * If c is the right-hand-side of a mount point, returns the left hand side.
- * Changes name to reflect the fact that we've uncrossed the mountpoint,
- * so name had better be ours to change!
+ * Changes name to reflect the fact that we've uncrossed the mountpoint.
  */
 static Chan*
-undomount(Chan *c, Path *path)
+undomount(Chan *c, Wpath *w)
 {
 	Chan *nc;
 
-	if(path->ref != 1 || path->mlen == 0)
-		print("undomount: path %s ref %ld mlen %d caller %#p\n",
-			path->s, path->ref, path->mlen, getcallerpc(&c));
+	wpathown(w);
+	if(w->mlen == 0)
+		print("undomount: path %s mlen %d caller %#p\n",
+			w->s, w->mlen, getcallerpc(&c));
 
-	if(path->mlen>0 && (nc=path->mtpt[path->mlen-1]) != nil){
-DBG("undomount %p %s => remove %p\n", path, path->s, nc);
+	if(w->mlen>0 && (nc=w->mtpt[w->mlen-1]) != nil){
+DBG("undomount %s => remove %p\n", w->s, nc);
 		cclose(c);
-		path->mtpt[path->mlen-1] = nil;
+		w->mtpt[w->mlen-1] = nil;
 		c = nc;
 	}
 	return c;
@@ -966,15 +1188,14 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 {
 	int dev, didmount, dotdot, i, n, nhave, ntry, type;
 	Chan *c, *nc, *mtpt;
-	Path *path;
+	Wpath path;
 	Mhead *mh, *nmh;
 	Mount *f;
 	Walkqid *wq;
 
 	c = *cp;
 	incref(c);
-	path = c->path;
-	incref(path);
+	wpathinit(&path, c->path);
 	mh = nil;
 
 	/*
@@ -995,7 +1216,7 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 		if((c->qid.type&QTDIR)==0){
 			if(nerror)
 				*nerror = nhave;
-			pathclose(path);
+			wpathfree(&path);
 			cclose(c);
 			strcpy(up->errstr, Enotdir);
 			if(mh != nil)
@@ -1042,7 +1263,7 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 			}
 			if(wq == nil){
 				cclose(c);
-				pathclose(path);
+				wpathfree(&path);
 				if(nerror)
 					*nerror = nhave+1;
 				if(mh != nil)
@@ -1056,8 +1277,8 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 			assert(wq->nqid == 1);
 			assert(wq->clone != nil);
 
-			path = addelem(path, "..", nil);
-			nc = undomount(wq->clone, path);
+			addelem(&path, "..", nil);
+			nc = undomount(wq->clone, &path);
 			nmh = nil;
 			n = 1;
 		}else{
@@ -1074,7 +1295,7 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 			if(nc == nil){	/* no mount points along path */
 				if(wq->clone == nil){
 					cclose(c);
-					pathclose(path);
+					wpathfree(&path);
 					if(wq->nqid==0 || (wq->qid[wq->nqid-1].type&QTDIR)){
 						if(nerror)
 							*nerror = nhave+wq->nqid+1;
@@ -1103,7 +1324,7 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 				mtpt = nil;
 				if(i==n-1 && nmh)
 					mtpt = nmh->from;
-				path = addelem(path, names[nhave+i], mtpt);
+				addelem(&path, names[nhave+i], mtpt);
 			}
 		}
 		cclose(c);
@@ -1124,7 +1345,7 @@ walk(Chan **cp, char **names, int nnames, int nomount, int *nerror)
 	}
 
 	pathclose(c->path);
-	c->path = path;
+	c->path = wpathdone(&path);
 
 	cclose(*cp);
 	*cp = c;
@@ -1318,7 +1539,7 @@ namec(char *aname, int amode, int omode, ulong perm)
 {
 	int len, n, t, nomount;
 	Chan *c, *cnew;
-	Path *path;
+	Wpath path;
 	Elemlist e;
 	Rune r;
 	Mhead *m;
@@ -1378,6 +1599,7 @@ namec(char *aname, int amode, int omode, ulong perm)
 		t = devno(r, 1);
 		if(t == -1)
 			error(Ebadsharp);
+		devready(devtab[t]);
 		if(debugstart && !devtab[t]->attached)
 			print("#%C...", devtab[t]->dc);
 		c = devtab[t]->attach(up->genbuf+n);
@@ -1469,8 +1691,7 @@ namec(char *aname, int amode, int omode, ulong perm)
 	case Aopen:
 	Open:
 		/* save&update the name; domount might change c */
-		path = c->path;
-		incref(path);
+		wpathinit(&path, c->path);
 		m = nil;
 		if(!nomount)
 			domount(&c, &m, &path);
@@ -1480,7 +1701,7 @@ namec(char *aname, int amode, int omode, ulong perm)
 
 		/* now it's our copy anyway, we can put the name back */
 		pathclose(c->path);
-		c->path = path;
+		c->path = wpathdone(&path);
 
 		/* record whether c is on a mount point */
 		c->ismtpt = m!=nil;
@@ -1623,7 +1844,10 @@ if(c->umh != nil){
 				putmhead(m);
 			cclose(c);
 			c = cnew;
-			c->path = addelem(c->path, e.elems[e.nelems-1], nil);
+			wpathinit(&path, c->path);
+			addelem(&path, e.elems[e.nelems-1], nil);
+			pathclose(c->path);
+			c->path = wpathdone(&path);
 			break;
 		}
 
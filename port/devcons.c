@@ -74,6 +74,7 @@ printinit(void)
 	if(lineq == nil)
 		panic("printinit");
 	qnoblock(lineq, 1);
+	logringinit();
 }
 
 int
@@ -98,40 +99,90 @@ prflush(void)
 /*
  * Log console output so it can be retrieved via /dev/kmesg.
  * This is good for catching boot-time messages after the fact.
+ * The other processors' rings are made by consinit, once
+ * conf.nmach is known; until then they share processor 0's
+ * static ring under kmesglock.
  */
-struct {
-	Lock lk;
-	char buf[KMESGSIZE];
-	uint n;
-} kmesg;
+enum {
+	Kmcpusize	= KMESGSIZE/8 < 1024? 1024: KMESGSIZE/8,
+};
+
+static char kmesgbuf[KMESGSIZE];
+static Logring kmesg[MAXMACH] = {
+	{ kmesgbuf, KMESGSIZE, },
+};
+static Lock kmesglock;		/* ring 0, while it's shared */
+static QLock kmesgsnaplock;	/* Qkmesg c->aux */
+
+typedef struct Kmsnap Kmsnap;
+struct Kmsnap {
+	long	n;
+	char*	buf;
+};
 
 static void
 kmesgputs(char *str, int n)
 {
-	uint nn, d;
-
-	ilock(&kmesg.lk);
-	/* take the tail of huge writes */
-	if(n > sizeof kmesg.buf){
-		d = n - sizeof kmesg.buf;
-		str += d;
-		n -= d;
+	Logring *r;
+	int s;
+
+	r = &kmesg[m->machno];
+	if(m->machno != 0 && r->buf != nil){
+		s = splhi();
+		logringput(r, str, n);
+		splx(s);
+		return;
 	}
+	ilock(&kmesglock);
+	logringput(&kmesg[0], str, n);
+	iunlock(&kmesglock);
+}
 
-	/* slide the buffer down to make room */
-	nn = kmesg.n;
-	if(nn + n >= sizeof kmesg.buf){
-		d = nn + n - sizeof kmesg.buf;
-		if(d)
-			memmove(kmesg.buf, kmesg.buf+d, sizeof kmesg.buf-d);
-		nn -= d;
+static void
+kmesgrings(void)
+{
+	char *p;
+	int i;
+
+	for(i = 1; i < conf.nmach; i++){
+		p = malloc(Kmcpusize);
+		if(p == nil)
+			panic("kmesgrings");
+		kmesg[i].size = Kmcpusize;
+		coherence();
+		kmesg[i].buf = p;
 	}
+}
 
-	/* copy the data in */
-	memmove(kmesg.buf+nn, str, n);
-	nn += n;
-	kmesg.n = nn;
-	iunlock(&kmesg.lk);
+/*
+ *  the merged rings as /dev/kmesg shows them, the newest
+ *  KMESGSIZE bytes.
+ */
+static Kmsnap*
+kmesgsnap(void)
+{
+	ulong off[MAXMACH], tot;
+	Kmsnap *k;
+	int i;
+
+	tot = 0;
+	for(i = 0; i < MAXMACH; i++){
+		off[i] = kmesg[i].tail;
+		tot += kmesg[i].size;
+	}
+	k = smalloc(sizeof(Kmsnap) + tot);
+	k->buf = (char*)&k[1];
+	if(waserror()){
+		free(k);
+		nexterror();
+	}
+	k->n = logringread(kmesg, MAXMACH, off, k->buf, tot);
+	poperror();
+	if(k->n > KMESGSIZE){
+		memmove(k->buf, k->buf + k->n - KMESGSIZE, KMESGSIZE);
+		k->n = KMESGSIZE;
+	}
+	return k;
 }
 
 /*
@@ -662,6 +713,7 @@ consinit(void)
 {
 	todinit();
 	randominit();
+	kmesgrings();
 	/*
 	 * at 115200 baud, the 1024 char buffer takes 56 ms to process,
 	 * processing it every 22 ms should be fine
@@ -736,6 +788,11 @@ consclose(Chan *c)
 			qhangup(kprintoq, nil);
 		}
 		break;
+
+	case Qkmesg:
+		free(c->aux);
+		c->aux = nil;
+		break;
 	}
 }
 
@@ -747,6 +804,7 @@ consread(Chan *c, void *buf, long n, vlong off)
 	char *b, *bp, ch;
 	char tmp[256];		/* must be >= 18*NUMSIZE (Qswap) */
 	int i, k, id, send;
+	Kmsnap *km;
 	vlong offset = off;
 	extern char configfile[];
 
@@ -821,18 +879,30 @@ consread(Chan *c, void *buf, long n, vlong off)
 
 	case Qkmesg:
 		/*
-		 * This is unlocked to avoid tying up a process
-		 * that's writing to the buffer.  kmesg.n never 
-		 * gets smaller, so worst case the reader will
-		 * see a slurred buffer.
+		 * The rings are merged into a snapshot when the
+		 * file is read from the start; later reads carry
+		 * on through the same snapshot.
 		 */
-		if(off >= kmesg.n)
+		qlock(&kmesgsnaplock);
+		if(waserror()){
+			qunlock(&kmesgsnaplock);
+			nexterror();
+		}
+		if(offset == 0 || c->aux == nil){
+			free(c->aux);
+			c->aux = nil;
+			c->aux = kmesgsnap();
+		}
+		km = c->aux;
+		if(offset >= km->n)
 			n = 0;
 		else{
-			if(off+n > kmesg.n)
-				n = kmesg.n - off;
-			memmove(buf, kmesg.buf+off, n);
+			if(offset+n > km->n)
+				n = km->n - offset;
+			memmove(buf, km->buf+offset, n);
 		}
+		poperror();
+		qunlock(&kmesgsnaplock);
 		return n;
 		
 	case Qkprint:
@@ -161,8 +161,14 @@ static	DImage*	screendimage;
 static	char	screenname[40];
 static	int	screennameid;
 
-static	Rectangle	flushrect;
-static	int		waste;
+enum
+{
+	Nflush	= 8,	/* separate damaged rectangles held until drawflush */
+};
+
+static	Rectangle	flushrect[Nflush];
+static	int		waste[Nflush];
+static	int		nflush;
 static	DScreen*	dscreen;
 extern	void		flushmemscreen(Rectangle);
 	void		drawmesg(Client*, void*, int);
@@ -359,48 +365,62 @@ drawrefresh(Memimage*, Rectangle r, void *v)
 	}
 }
 
+/*
+ * merge r into a damaged rectangle that can absorb it,
+ * or keep it apart; once the set is full the oldest is
+ * flushed to make room.
+ */
 static void
-addflush(Rectangle r)
+mergeflush(Rectangle r)
 {
-	int abb, ar, anbb;
+	int i, abb, ar, anbb, w;
 	Rectangle nbb;
 
-	if(sdraw.softscreen==0 || !rectclip(&r, screenimage->r))
+	if(!rectclip(&r, screenimage->r))
 		return;
 
-	if(flushrect.min.x >= flushrect.max.x){
-		flushrect = r;
-		waste = 0;
-		return;
-	}
-	nbb = flushrect;
-	combinerect(&nbb, r);
 	ar = Dx(r)*Dy(r);
-	abb = Dx(flushrect)*Dy(flushrect);
-	anbb = Dx(nbb)*Dy(nbb);
-	/*
-	 * Area of new waste is area of new bb minus area of old bb,
-	 * less the area of the new segment, which we assume is not waste.
-	 * This could be negative, but that's OK.
-	 */
-	waste += anbb-abb - ar;
-	if(waste < 0)
-		waste = 0;
-	/*
-	 * absorb if:
-	 *	total area is small
-	 *	waste is less than half total area
-	 * 	rectangles touch
-	 */
-	if(anbb<=1024 || waste*2<anbb || rectXrect(flushrect, r)){
-		flushrect = nbb;
-		return;
+	for(i=0; i<nflush; i++){
+		nbb = flushrect[i];
+		combinerect(&nbb, r);
+		abb = Dx(flushrect[i])*Dy(flushrect[i]);
+		anbb = Dx(nbb)*Dy(nbb);
+		/*
+		 * Area of new waste is area of new bb minus area of old bb,
+		 * less the area of the new segment, which we assume is not waste.
+		 * This could be negative, but that's OK.
+		 */
+		w = waste[i] + anbb-abb - ar;
+		if(w < 0)
+			w = 0;
+		/*
+		 * absorb if:
+		 *	total area is small
+		 *	waste is less than half total area
+		 * 	rectangles touch
+		 */
+		if(anbb<=1024 || w*2<anbb || rectXrect(flushrect[i], r)){
+			flushrect[i] = nbb;
+			waste[i] = w;
+			return;
+		}
+	}
+	if(nflush == Nflush){
+		flushmemscreen(flushrect[0]);
+		nflush--;
+		memmove(&flushrect[0], &flushrect[1], nflush*sizeof flushrect[0]);
+		memmove(&waste[0], &waste[1], nflush*sizeof waste[0]);
 	}
-	/* emit current state */
-	if(flushrect.min.x < flushrect.max.x)
-		flushmemscreen(flushrect);
-	flushrect = r;
-	waste = 0;
+	flushrect[nflush] = r;
+	waste[nflush] = 0;
+	nflush++;
+}
+
+static void
+addflush(Rectangle r)
+{
+	if(sdraw.softscreen)
+		mergeflush(r);
 }
 
 static
@@ -410,7 +430,8 @@ dstflush(int dstid, Memimage *dst, Rectangle r)
 	Memlayer *l;
 
 	if(dstid == 0){
-		combinerect(&flushrect, r);
+		/* flushmemscreen may have work even without a soft screen */
+		mergeflush(r);
 		return;
 	}
 	/* how can this happen? -rsc, dec 12 2002 */
@@ -433,9 +454,11 @@ dstflush(int dstid, Memimage *dst, Rectangle r)
 void
 drawflush(void)
 {
-	if(flushrect.min.x < flushrect.max.x)
-		flushmemscreen(flushrect);
-	flushrect = Rect(10000, 10000, -10000, -10000);
+	int i;
+
+	for(i=0; i<nflush; i++)
+		flushmemscreen(flushrect[i]);
+	nflush = 0;
 }
 
 static
@@ -1064,7 +1087,7 @@ drawopen(Chan *c, int omode)
 		if(cl->busy)
 			error(Einuse);
 		cl->busy = 1;
-		flushrect = Rect(10000, 10000, -10000, -10000);
+		nflush = 0;
 		dn = drawlookupname(strlen(screenname), screenname);
 		if(dn == 0)
 			error("draw: cannot happen 2");
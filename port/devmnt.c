@@ -798,6 +798,7 @@ mountio(Mnt *m, Mntrpc *r)
 		error(Emountrpc);
 	r->stime = fastticks(nil);
 	r->reqlen = n;
+	TRACEPT(TPmntrpc, (uintptr)m->c, r->request.tag, r->request.type);
 
 	/* Gate readers onto the mount point one at a time */
 	for(;;) {
@@ -805,8 +806,11 @@ mountio(Mnt *m, Mntrpc *r)
 		if(m->rip == 0)
 			break;
 		unlock(m);
-		sleep(&r->r, rpcattn, r);
+		sqsleep(&m->gate, &r->r, rpcattn, r, 1);
 		if(r->done){
+			/* pass on a gate wakeup we may have taken */
+			if(m->rip == 0)
+				sqwakeup(&m->gate);
 			poperror();
 			mntflushfree(m, r);
 			return;
@@ -917,16 +921,10 @@ mntrpcread(Mnt *m, Mntrpc *r)
 void
 mntgate(Mnt *m)
 {
-	Mntrpc *q;
-
 	lock(m);
 	m->rip = 0;
-	for(q = m->queue; q; q = q->list) {
-		if(q->done == 0)
-		if(wakeup(&q->r))
-			break;
-	}
 	unlock(m);
+	sqwakeup(&m->gate);
 }
 
 void
@@ -951,6 +949,7 @@ mountmux(Mnt *m, Mntrpc *r)
 			}
 			q->done = 1;
 			unlock(m);
+			TRACEPT(TPmntreply, (uintptr)m->c, r->reply.tag, r->reply.type);
 			if(mntstats != nil)
 				(*mntstats)(q->request.type,
 					m->c, q->stime,
@@ -13,6 +13,8 @@ enum
 {
 	Qdir,
 	Qtrace,
+	Qstatusall,
+	Qcpustats,
 	Qargs,
 	Qctl,
 	Qfd,
@@ -31,6 +33,7 @@ enum
 	Qwait,
 	Qprofile,
 	Qsyscall,
+	Qstats,
 };
 
 enum
@@ -70,6 +73,23 @@ enum{
 };
 
 #define	STATSIZE	(2*KNAMELEN+12+9*12)
+#define	STATRECSIZE	(2*NUMSIZE+STATSIZE)	/* record in #p/status */
+
+/*
+ * per-open state for #p/status: where the last read stopped
+ * (slot, offset of that slot's record, and file offset) so
+ * sequential reads resume without rescanning, and the
+ * generation written by the reader; only procs changed at
+ * or after it are listed.
+ */
+typedef struct Statwalk Statwalk;
+struct Statwalk
+{
+	ulong	since;
+	ulong	off;
+	ulong	offset;
+	int	slot;
+};
 /*
  * Status, fd, and ns are left fully readable (0444) because of their use in debugging,
  * particularly on shared servers.
@@ -95,6 +115,15 @@ Dirtab procdir[] =
 	"wait",		{Qwait},	0,			0400,
 	"profile",	{Qprofile},	0,			0400,
 	"syscall",	{Qsyscall},	0,			0400,	
+	"stats",	{Qstats},	sizeof(Pstats),		0444,
+};
+
+/* files in #p itself, ahead of the process directories */
+static Dirtab proctopdir[] =
+{
+	"trace",	{Qtrace},	0,			0444,
+	"status",	{Qstatusall},	0,			0666,
+	"cpustats",	{Qcpustats},	0,			0444,
 };
 
 static
@@ -176,6 +205,20 @@ profclock(Ureg *ur, Timer *)
 	}
 }
 
+static int
+proctopgen(Chan *c, Dirtab *tab, Dir *dp)
+{
+	Qid qid;
+	ulong len;
+
+	len = tab->length;
+	if(tab->qid.path == Qcpustats)
+		len = conf.nmach*sizeof(Mstats);
+	mkqid(&qid, tab->qid.path, -1, QTFILE);
+	devdir(c, qid, tab->name, len, eve, tab->perm, dp);
+	return 1;
+}
+
 static int
 procgen(Chan *c, char *name, Dirtab *tab, int, int s, Dir *dp)
 {
@@ -184,6 +227,7 @@ procgen(Chan *c, char *name, Dirtab *tab, int, int s, Dir *dp)
 	char *ename;
 	Segment *q;
 	ulong pid, path, perm, len;
+	int i;
 
 	if(s == DEVDOTDOT){
 		mkqid(&qid, Qdir, 0, QTDIR);
@@ -192,12 +236,8 @@ procgen(Chan *c, char *name, Dirtab *tab, int, int s, Dir *dp)
 	}
 
 	if(c->qid.path == Qdir){
-		if(s == 0){
-			strcpy(up->genbuf, "trace");
-			mkqid(&qid, Qtrace, -1, QTFILE);
-			devdir(c, qid, up->genbuf, 0, eve, 0444, dp);
-			return 1;
-		}
+		if(s < nelem(proctopdir))
+			return proctopgen(c, &proctopdir[s], dp);
 
 		if(name != nil){
 			/* ignore s and use name to find pid */
@@ -208,7 +248,7 @@ procgen(Chan *c, char *name, Dirtab *tab, int, int s, Dir *dp)
 			if(s < 0)
 				return -1;
 		}
-		else if(--s >= conf.nproc)
+		else if((s -= nelem(proctopdir)) >= conf.nproc)
 			return -1;
 
 		p = proctab(s);
@@ -225,12 +265,9 @@ procgen(Chan *c, char *name, Dirtab *tab, int, int s, Dir *dp)
 		devdir(c, qid, up->genbuf, 0, p->user, DMDIR|0555, dp);
 		return 1;
 	}
-	if(c->qid.path == Qtrace){
-		strcpy(up->genbuf, "trace");
-		mkqid(&qid, Qtrace, -1, QTFILE);
-		devdir(c, qid, up->genbuf, 0, eve, 0444, dp);
-		return 1;
-	}
+	for(i = 0; i < nelem(proctopdir); i++)
+		if(c->qid.path == proctopdir[i].qid.path)
+			return proctopgen(c, &proctopdir[i], dp);
 	if(s >= nelem(procdir))
 		return -1;
 	if(tab)
@@ -366,6 +403,21 @@ procopen(Chan *c, int omode)
 		c->offset = 0;
 		return c;
 	}
+	if(QID(c->qid) == Qcpustats){
+		if(omode != OREAD)
+			error(Eperm);
+		c->mode = openmode(omode);
+		c->flag |= COPEN;
+		c->offset = 0;
+		return c;
+	}
+	if(QID(c->qid) == Qstatusall){
+		c->aux = smalloc(sizeof(Statwalk));
+		c->mode = openmode(omode);
+		c->flag |= COPEN;
+		c->offset = 0;
+		return c;
+	}
 		
 	p = proctab(SLOT(c->qid));
 	qlock(&p->debug);
@@ -393,6 +445,7 @@ procopen(Chan *c, int omode)
 	case Qproc:
 	case Qkregs:
 	case Qsegment:
+	case Qstats:
 	case Qprofile:
 	case Qfd:
 		if(omode != OREAD)
@@ -468,7 +521,8 @@ procwstat(Chan *c, uchar *db, int n)
 	if(c->qid.type&QTDIR)
 		error(Eperm);
 
-	if(QID(c->qid) == Qtrace)
+	if(QID(c->qid) == Qtrace || QID(c->qid) == Qstatusall
+	|| QID(c->qid) == Qcpustats)
 		return devwstat(c, db, n);
 		
 	p = proctab(SLOT(c->qid));
@@ -617,6 +671,8 @@ procclose(Chan * c)
 	}
 	if(QID(c->qid) == Qns && c->aux != 0)
 		free(c->aux);
+	if(QID(c->qid) == Qstatusall && c->aux != 0)
+		free(c->aux);
 }
 
 static void
@@ -670,13 +726,111 @@ eventsavailable(void *)
 	return tproduced > tconsumed;
 }
 
+/*
+ *  format the STATSIZE bytes of /proc/n/status into statbuf
+ */
+static void
+procstatus(Proc *p, char *statbuf)
+{
+	int i, j;
+	long l;
+	char *sps;
+	Segment *s;
+
+	sps = p->psstate;
+	if(sps == 0)
+		sps = statename[p->state];
+	memset(statbuf, ' ', STATSIZE);
+	readstr(0, statbuf+0*KNAMELEN, KNAMELEN-1, p->text);
+	readstr(0, statbuf+1*KNAMELEN, KNAMELEN-1, p->user);
+	readstr(0, statbuf+2*KNAMELEN, 11, sps);
+	j = 2*KNAMELEN + 12;
+
+	for(i = 0; i < 6; i++) {
+		l = p->time[i];
+		if(i == TReal)
+			l = MACHP(0)->ticks - l;
+		l = TK2MS(l);
+		readnum(0, statbuf+j+NUMSIZE*i, NUMSIZE, l, NUMSIZE);
+	}
+	/* ignore stack, which is mostly non-existent */
+	l = 0;
+	for(i=1; i<NSEG; i++){
+		s = p->seg[i];
+		if(s)
+			l += s->top - s->base;
+	}
+	readnum(0, statbuf+j+NUMSIZE*6, NUMSIZE, l>>10, NUMSIZE);
+	readnum(0, statbuf+j+NUMSIZE*7, NUMSIZE, p->basepri, NUMSIZE);
+	readnum(0, statbuf+j+NUMSIZE*8, NUMSIZE, p->priority, NUMSIZE);
+}
+
+/*
+ *  #p/status holds one STATRECSIZE record per live process:
+ *  pid, generation (the tick of its last change), then the
+ *  same fields as /proc/n/status, ending in a newline.
+ *  writing "since n" restricts reads to procs whose
+ *  generation is at least n, so a poller can pass the
+ *  largest generation it has seen and skip idle procs.
+ *  exited procs are not listed; a full read shows which
+ *  pids remain.
+ */
+static long
+procstatusread(Chan *c, char *a, long n, ulong offset)
+{
+	char rec[STATRECSIZE];
+	Statwalk *sw;
+	Proc *p;
+	ulong off, pid, gen;
+	long i, m, tot;
+	int s;
+
+	sw = c->aux;
+	if(sw == nil)
+		error(Enomem);
+	if(offset == 0 || offset != sw->offset){
+		sw->off = 0;
+		sw->slot = 0;
+	}
+	off = sw->off;
+	tot = 0;
+	for(s = sw->slot; s < conf.nproc && tot < n; s++){
+		p = proctab(s);
+		pid = p->pid;
+		gen = p->statgen;
+		if(pid == 0 || (long)(gen - sw->since) < 0)
+			continue;
+		if(off+STATRECSIZE <= offset){
+			off += STATRECSIZE;
+			continue;
+		}
+		readnum(0, rec, NUMSIZE, pid, NUMSIZE);
+		readnum(0, rec+NUMSIZE, NUMSIZE, gen, NUMSIZE);
+		procstatus(p, rec+2*NUMSIZE);
+		rec[STATRECSIZE-1] = '\n';
+		i = offset - off;
+		m = STATRECSIZE - i;
+		if(m > n-tot)
+			m = n-tot;
+		memmove(a+tot, rec+i, m);
+		tot += m;
+		offset += m;
+		if(offset < off+STATRECSIZE)
+			break;		/* resume inside this record */
+		off += STATRECSIZE;
+	}
+	sw->slot = s;
+	sw->off = off;
+	sw->offset = offset;
+	return tot;
+}
+
 static long
 procread(Chan *c, void *va, long n, vlong off)
 {
 	/* NSEG*32 was too small for worst cases */
-	char *a, flag[10], *sps, *srv, statbuf[NSEG*64];
+	char *a, flag[10], *srv, statbuf[NSEG*64];
 	int i, j, m, navail, ne, pid, rsize;
-	long l;
 	uchar *rptr;
 	ulong offset;
 	Confmem *cm;
@@ -713,6 +867,19 @@ procread(Chan *c, void *va, long n, vlong off)
 		return rptr - (uchar*)va;
 	}
 
+	if(QID(c->qid) == Qstatusall)
+		return procstatusread(c, a, n, offset);
+
+	if(QID(c->qid) == Qcpustats){
+		i = conf.nmach*sizeof(Mstats);
+		if(offset >= i)
+			return 0;
+		if(offset+n > i)
+			n = i - offset;
+		memmove(a, (char*)mstats+offset, n);
+		return n;
+	}
+
 	p = proctab(SLOT(c->qid));
 	if(p->pid != PID(c->qid))
 		error(Eprocdied);
@@ -801,6 +968,14 @@ procread(Chan *c, void *va, long n, vlong off)
 		qunlock(&p->debug);
 		return n;
 
+	case Qstats:
+		if(offset >= sizeof(Pstats))
+			return 0;
+		if(offset+n > sizeof(Pstats))
+			n = sizeof(Pstats) - offset;
+		memmove(a, ((char*)&p->stats)+offset, n);
+		return n;
+
 	case Qproc:
 		if(offset >= sizeof(Proc))
 			return 0;
@@ -839,33 +1014,7 @@ procread(Chan *c, void *va, long n, vlong off)
 			return 0;
 		if(offset+n > STATSIZE)
 			n = STATSIZE - offset;
-
-		sps = p->psstate;
-		if(sps == 0)
-			sps = statename[p->state];
-		memset(statbuf, ' ', sizeof statbuf);
-		readstr(0, statbuf+0*KNAMELEN, KNAMELEN-1, p->text);
-		readstr(0, statbuf+1*KNAMELEN, KNAMELEN-1, p->user);
-		readstr(0, statbuf+2*KNAMELEN, 11, sps);
-		j = 2*KNAMELEN + 12;
-
-		for(i = 0; i < 6; i++) {
-			l = p->time[i];
-			if(i == TReal)
-				l = MACHP(0)->ticks - l;
-			l = TK2MS(l);
-			readnum(0, statbuf+j+NUMSIZE*i, NUMSIZE, l, NUMSIZE);
-		}
-		/* ignore stack, which is mostly non-existent */
-		l = 0;
-		for(i=1; i<NSEG; i++){
-			s = p->seg[i];
-			if(s)
-				l += s->top - s->base;
-		}
-		readnum(0, statbuf+j+NUMSIZE*6, NUMSIZE, l>>10, NUMSIZE);
-		readnum(0, statbuf+j+NUMSIZE*7, NUMSIZE, p->basepri, NUMSIZE);
-		readnum(0, statbuf+j+NUMSIZE*8, NUMSIZE, p->priority, NUMSIZE);
+		procstatus(p, statbuf);
 		memmove(a, statbuf+offset, n);
 		return n;
 
@@ -1011,6 +1160,30 @@ mntscan(Mntwalk *mw, Proc *p)
 	runlock(&pg->ns);
 }
 
+static void
+procstatuswrite(Chan *c, char *va, long n)
+{
+	Cmdbuf *cb;
+	Statwalk *sw;
+
+	sw = c->aux;
+	if(sw == nil)
+		error(Enomem);
+	cb = parsecmd(va, n);
+	if(waserror()){
+		free(cb);
+		nexterror();
+	}
+	if(cb->nf != 2 || strcmp(cb->f[0], "since") != 0)
+		error(Ebadctl);
+	sw->since = strtoul(cb->f[1], nil, 0);
+	sw->off = 0;
+	sw->offset = 0;
+	sw->slot = 0;
+	poperror();
+	free(cb);
+}
+
 static long
 procwrite(Chan *c, void *va, long n, vlong off)
 {
@@ -1023,6 +1196,11 @@ procwrite(Chan *c, void *va, long n, vlong off)
 	if(c->qid.type & QTDIR)
 		error(Eisdir);
 
+	if(QID(c->qid) == Qstatusall){
+		procstatuswrite(c, va, n);
+		return n;
+	}
+
 	p = proctab(SLOT(c->qid));
 
 	/* Use the remembered noteid in the channel rather
@@ -728,6 +728,22 @@ sdclose(Chan* c)
 	}
 }
 
+/*
+ * unit i/o with trace points either side
+ */
+static long
+sdunitbio(SDunit* unit, int write, void* a, long nb, uvlong bno)
+{
+	ulong id;
+	long l;
+
+	id = (ulong)write<<31 | unit->dev->idno<<8 | unit->subno;
+	TRACEPT(TPsdio, bno, id, nb);
+	l = unit->dev->ifc->bio(unit, 0, write, a, nb, bno);
+	TRACEPT(TPsddone, bno, id, l < 0? 0: l/unit->secsize);
+	return l;
+}
+
 static long
 sdbio(Chan* c, int write, char* a, long len, uvlong off)
 {
@@ -798,9 +814,20 @@ sdbio(Chan* c, int write, char* a, long len, uvlong off)
 		poperror();
 	}
 
-	b = sdmalloc(nb*unit->secsize);
-	if(b == nil)
-		error(Enomem);
+	offset = off%unit->secsize;
+	if(offset+len > nb*unit->secsize)
+		len = nb*unit->secsize - offset;
+
+	/*
+	 * Whole sectors go straight to and from the caller's
+	 * buffer if the controller can take it.
+	 */
+	b = nil;
+	if(!sdev->userbuf || offset || len != nb*unit->secsize){
+		b = sdmalloc(nb*unit->secsize);
+		if(b == nil)
+			error(Enomem);
+	}
 	if(waserror()){
 		sdfree(b);
 		if(!(unit->inquiry[1] & SDinq1removable))
@@ -808,12 +835,16 @@ sdbio(Chan* c, int write, char* a, long len, uvlong off)
 		nexterror();
 	}
 
-	offset = off%unit->secsize;
-	if(offset+len > nb*unit->secsize)
-		len = nb*unit->secsize - offset;
-	if(write){
+	if(b == nil){
+		l = sdunitbio(unit, write, a, nb, bno);
+		if(l < 0)
+			error(Eio);
+		if(len > l)
+			len = l;
+	}
+	else if(write){
 		if(offset || (len%unit->secsize)){
-			l = unit->dev->ifc->bio(unit, 0, 0, b, nb, bno);
+			l = sdunitbio(unit, 0, b, nb, bno);
 			if(l < 0)
 				error(Eio);
 			if(l < (nb*unit->secsize)){
@@ -824,7 +855,7 @@ sdbio(Chan* c, int write, char* a, long len, uvlong off)
 			}
 		}
 		memmove(b+offset, a, len);
-		l = unit->dev->ifc->bio(unit, 0, 1, b, nb, bno);
+		l = sdunitbio(unit, 1, b, nb, bno);
 		if(l < 0)
 			error(Eio);
 		if(l < offset)
@@ -833,7 +864,7 @@ sdbio(Chan* c, int write, char* a, long len, uvlong off)
 			len = l - offset;
 	}
 	else{
-		l = unit->dev->ifc->bio(unit, 0, 0, b, nb, bno);
+		l = sdunitbio(unit, 0, b, nb, bno);
 		if(l < 0)
 			error(Eio);
 		if(l < offset)
@@ -11,13 +11,6 @@ enum
 	Qsegdir,
 	Qctl,
 	Qdata,
-
-	/* commands to kproc */
-	Cnone=0,
-	Cread,
-	Cwrite,
-	Cstart,
-	Cdie,
 };
 
 #define TYPE(x) 	(int)( (c)->qid.path & 0x7 )
@@ -34,17 +27,6 @@ struct Globalseg
 	char	*uid;
 	vlong	length;
 	long	perm;
-
-	/* kproc to do reading and writing */
-	QLock	l;		/* sync kproc access */
-	Rendez	cmdwait;	/* where kproc waits */
-	Rendez	replywait;	/* where requestor waits */
-	Proc	*kproc;
-	char	*data;
-	long	off;
-	int	dlen;
-	int	cmd;	
-	char	err[64];
 };
 
 static Globalseg *globalseg[100];
@@ -53,9 +35,6 @@ static Lock globalseglock;
 
 	Segment* (*_globalsegattach)(Proc*, char*);
 static	Segment* globalsegattach(Proc *p, char *name);
-static	int	cmddone(void*);
-static	void	segmentkproc(void*);
-static	void	docmd(Globalseg *g, int cmd);
 
 /*
  *  returns with globalseg incref'd
@@ -86,8 +65,6 @@ putgseg(Globalseg *g)
 		return;
 	if(g->s != nil)
 		putseg(g->s);
-	if(g->kproc)
-		docmd(g, Cdie);
 	free(g->name);
 	free(g->uid);
 	free(g);
@@ -190,14 +167,6 @@ segmentstat(Chan *c, uchar *db, int n)
 	return devstat(c, db, n, 0, 0, segmentgen);
 }
 
-static int
-cmddone(void *arg)
-{
-	Globalseg *g = arg;
-
-	return g->cmd == Cnone;
-}
-
 static Chan*
 segmentopen(Chan *c, int omode)
 {
@@ -229,20 +198,6 @@ segmentopen(Chan *c, int omode)
 		devpermcheck(g->uid, g->perm, omode);
 		if(g->s == nil)
 			error("segment not yet allocated");
-		if(g->kproc == nil){
-			qlock(&g->l);
-			if(waserror()){
-				qunlock(&g->l);
-				nexterror();
-			}
-			if(g->kproc == nil){
-				g->cmd = Cnone;
-				kproc(g->name, segmentkproc, g);
-				docmd(g, Cstart);
-			}
-			qunlock(&g->l);
-			poperror();
-		}
 		c->aux = g;
 		poperror();
 		c->flag |= COPEN;
@@ -313,6 +268,71 @@ segmentcreate(Chan *c, char *name, int omode, ulong perm)
 	c->mode = OWRITE;
 }
 
+/*
+ *  copy between a and the segment at offset off, a page at a
+ *  time through kmap, faulting pages in as needed.  raising
+ *  the segment's steal count keeps the pager off its pages
+ *  while the copy, which can fault on a, is in progress.
+ */
+static long
+segmentio(Segment *s, void *va, long n, ulong off, int read)
+{
+	KMap *k;
+	Pte *pte;
+	Page *pg;
+	ulong addr, soff, l;
+	char *a, *b;
+	long tot;
+
+	a = va;
+	qlock(&s->lk);
+	s->steal++;
+	qunlock(&s->lk);
+	if(waserror()){
+		qlock(&s->lk);
+		s->steal--;
+		qunlock(&s->lk);
+		nexterror();
+	}
+	for(tot = 0; tot < n; tot += l){
+		addr = s->base + off + tot;
+		do
+			qlock(&s->lk);
+		while(fixfault(s, addr, read, 0) != 0);
+
+		soff = addr - s->base;
+		pte = s->map[soff/PTEMAPMEM];
+		if(pte == nil)
+			panic("segmentio");
+		pg = pte->pages[(soff&(PTEMAPMEM-1))/BY2PG];
+		if(pagedout(pg))
+			panic("segmentio1");
+
+		l = BY2PG - (addr&(BY2PG-1));
+		if(l > n - tot)
+			l = n - tot;
+
+		k = kmap(pg);
+		if(waserror()){
+			kunmap(k);
+			nexterror();
+		}
+		b = (char*)VA(k) + (addr&(BY2PG-1));
+		if(read)
+			memmove(a+tot, b, l);	/* can fault */
+		else
+			memmove(b, a+tot, l);
+		kunmap(k);
+		poperror();
+	}
+	poperror();
+	qlock(&s->lk);
+	s->steal--;
+	qunlock(&s->lk);
+
+	return n;
+}
+
 static long
 segmentread(Chan *c, void *a, long n, vlong voff)
 {
@@ -331,25 +351,11 @@ segmentread(Chan *c, void *a, long n, vlong voff)
 		return readstr(voff, a, n, buf);
 	case Qdata:
 		g = c->aux;
-		if(voff > g->s->top - g->s->base)
+		if(voff < 0 || voff > g->s->top - g->s->base)
 			error(Ebadarg);
 		if(voff + n > g->s->top - g->s->base)
 			n = g->s->top - g->s->base - voff;
-		qlock(&g->l);
-		g->off = voff + g->s->base;
-		g->data = smalloc(n);
-		if(waserror()){
-			free(g->data);
-			qunlock(&g->l);
-			nexterror();
-		}
-		g->dlen = n;
-		docmd(g, Cread);
-		memmove(a, g->data, g->dlen);
-		free(g->data);
-		qunlock(&g->l);
-		poperror();
-		return g->dlen;
+		return segmentio(g->s, a, n, voff, 1);
 	default:
 		panic("segmentread");
 	}
@@ -388,23 +394,9 @@ segmentwrite(Chan *c, void *a, long n, vlong voff)
 		break;
 	case Qdata:
 		g = c->aux;
-		if(voff + n > g->s->top - g->s->base)
+		if(voff < 0 || voff + n > g->s->top - g->s->base)
 			error(Ebadarg);
-		qlock(&g->l);
-		g->off = voff + g->s->base;
-		g->data = smalloc(n);
-		if(waserror()){
-			free(g->data);
-			qunlock(&g->l);
-			nexterror();
-		}
-		g->dlen = n;
-		memmove(g->data, a, g->dlen);
-		docmd(g, Cwrite);
-		free(g->data);
-		qunlock(&g->l);
-		poperror();
-		return g->dlen;
+		return segmentio(g->s, a, n, voff, 0);
 	default:
 		panic("segmentwrite");
 	}
@@ -494,67 +486,6 @@ globalsegattach(Proc *p, char *name)
 	return s;
 }
 
-static void
-docmd(Globalseg *g, int cmd)
-{
-	g->err[0] = 0;
-	g->cmd = cmd;
-	wakeup(&g->cmdwait);
-	sleep(&g->replywait, cmddone, g);
-	if(g->err[0])
-		error(g->err);
-}
-
-static int
-cmdready(void *arg)
-{
-	Globalseg *g = arg;
-
-	return g->cmd != Cnone;
-}
-
-static void
-segmentkproc(void *arg)
-{
-	Globalseg *g = arg;
-	int done;
-	int sno;
-
-	for(sno = 0; sno < NSEG; sno++)
-		if(up->seg[sno] == nil && sno != ESEG)
-			break;
-	if(sno == NSEG)
-		panic("segmentkproc");
-	g->kproc = up;
-
-	incref(g->s);
-	up->seg[sno] = g->s;
-
-	for(done = 0; !done;){
-		sleep(&g->cmdwait, cmdready, g);
-		if(waserror()){
-			strncpy(g->err, up->errstr, sizeof(g->err));
-		} else {
-			switch(g->cmd){
-			case Cstart:
-				break;
-			case Cdie:
-				done = 1;
-				break;
-			case Cread:
-				memmove(g->data, (char*)g->off, g->dlen);
-				break;
-			case Cwrite:
-				memmove((char*)g->off, g->data, g->dlen);
-				break;
-			}
-			poperror();
-		}
-		g->cmd = Cnone;
-		wakeup(&g->replywait);
-	}
-}
-
 Dev segmentdevtab = {
 	'g',
 	"segment",
@@ -6,45 +6,243 @@
 #include	"../port/error.h"
 
 
+enum
+{
+	Nsrvhash	= 64,
+};
+
+/*
+ *  lookups by name (walk) and by qid path (open, stat) go
+ *  through the hashes without srvlk, which only writers take.
+ *  a lookup counts itself in srvreaders, atomically and without
+ *  a lock, while it follows pointers, and
+ *  anything unlinked is parked in srvlimbo until no lookup is
+ *  in progress, so a lookup never touches freed memory.
+ *  a lookup that finds something takes a reference to it,
+ *  which keeps chan alive after a remove.
+ */
 typedef struct Srv Srv;
 struct Srv
 {
+	Ref;			/* one while posted, one per lookup */
 	char	*name;
 	char	*owner;
 	ulong	perm;
 	Chan	*chan;
-	Srv	*link;
+	Srv	*link;		/* all services, newest first */
+	Srv	*nhash;
+	Srv	*phash;
 	ulong	path;
+	int	gone;		/* removed; under its Ref's lock */
+};
+
+typedef struct Limbo Limbo;
+struct Limbo
+{
+	Limbo	*next;
+	void	*p;
 };
 
 static QLock	srvlk;
 static Srv	*srv;
+static Srv	*srvnhash[Nsrvhash];
+static Srv	*srvphash[Nsrvhash];
+static ulong	srvseq;		/* odd while an entry changes name */
+static long	srvreaders;	/* lookups in progress; _xinc/_xdec */
+static Lock	srvlimbolk;
+static Limbo	*srvlimbo;
 static int	qidpath;
 
+/* srvgen's place in srv, to make directory reads linear */
+static ulong	srvlistgen;
+static ulong	srvcursgen;
+static Srv	*srvcurs;
+static int	srvcursidx;
+
+static ulong
+srvhash(char *name)
+{
+	ulong h;
+
+	h = 0;
+	while(*name)
+		h = h*31 + *(uchar*)name++;
+	return h % Nsrvhash;
+}
+
+/*
+ *  free p once no lookup can still be looking at it.
+ */
+static void
+srvdefer(void *p)
+{
+	Limbo *l;
+
+	if(p == nil)
+		return;
+	l = smalloc(sizeof *l);
+	l->p = p;
+	lock(&srvlimbolk);
+	l->next = srvlimbo;
+	srvlimbo = l;
+	unlock(&srvlimbolk);
+}
+
+static void
+srvreap(void)
+{
+	Limbo *l, *nl;
+
+	/*
+	 *  take the list before looking at srvreaders: a lookup
+	 *  that starts after that can't reach anything on it.
+	 */
+	lock(&srvlimbolk);
+	l = srvlimbo;
+	srvlimbo = nil;
+	unlock(&srvlimbolk);
+	if(l == nil)
+		return;
+	coherence();
+	if(srvreaders != 0){
+		for(nl = l; nl->next != nil; nl = nl->next)
+			;
+		lock(&srvlimbolk);
+		nl->next = srvlimbo;
+		srvlimbo = l;
+		unlock(&srvlimbolk);
+		return;
+	}
+	for(; l != nil; l = nl){
+		nl = l->next;
+		free(l->p);
+		free(l);
+	}
+}
+
 static int
-srvgen(Chan *c, char*, Dirtab*, int, int s, Dir *dp)
+srvtake(Srv *sp)
+{
+	lock(sp);
+	if(sp->gone){
+		unlock(sp);
+		return 0;
+	}
+	sp->ref++;
+	unlock(sp);
+	return 1;
+}
+
+static void
+srvput(Srv *sp)
+{
+	if(decref(sp) != 0)
+		return;
+	if(sp->chan)
+		cclose(sp->chan);
+	srvdefer(sp->owner);
+	srvdefer(sp->name);
+	srvdefer(sp);
+	srvreap();
+}
+
+static Srv*
+srvfind(char *name, ulong path)
+{
+	Srv *sp;
+
+	if(name != nil){
+		for(sp = srvnhash[srvhash(name)]; sp != nil; sp = sp->nhash)
+			if(strcmp(sp->name, name) == 0 && srvtake(sp))
+				return sp;
+	}
+	else{
+		for(sp = srvphash[path % Nsrvhash]; sp != nil; sp = sp->phash)
+			if(sp->path == path && srvtake(sp))
+				return sp;
+	}
+	return nil;
+}
+
+/*
+ *  look up a service by name, or by path if name is nil,
+ *  returning it referenced.  a miss that raced with a rename
+ *  is tried again under srvlk.
+ */
+static Srv*
+srvget(char *name, ulong path)
 {
 	Srv *sp;
+	ulong seq;
+
+	_xinc(&srvreaders);
+	seq = srvseq;
+	coherence();
+	sp = srvfind(name, path);
+	coherence();
+	if(sp == nil && ((seq & 1) || seq != srvseq)){
+		qlock(&srvlk);
+		sp = srvfind(name, path);
+		qunlock(&srvlk);
+	}
+	_xdec(&srvreaders);
+	return sp;
+}
+
+/*
+ *  the name and owner are copied out, since a wstat
+ *  can replace them once srvreaders is dropped.
+ */
+static void
+srvdir(Chan *c, Srv *sp, Dir *dp)
+{
 	Qid q;
+	char *owner;
+
+	owner = up->genbuf + sizeof up->genbuf - KNAMELEN;
+	_xinc(&srvreaders);
+	mkqid(&q, sp->path, 0, QTFILE);
+	kstrcpy(up->genbuf, sp->name, sizeof up->genbuf - KNAMELEN);
+	kstrcpy(owner, sp->owner, KNAMELEN);
+	_xdec(&srvreaders);
+	devdir(c, q, up->genbuf, 0, owner, sp->perm, dp);
+}
+
+static int
+srvgen(Chan *c, char *name, Dirtab*, int, int s, Dir *dp)
+{
+	Srv *sp;
 
 	if(s == DEVDOTDOT){
 		devdir(c, c->qid, "#s", 0, eve, 0555, dp);
 		return 1;
 	}
 
-	qlock(&srvlk);
-	for(sp = srv; sp && s; sp = sp->link)
-		s--;
+	/* walking: go straight to it */
+	if(name != nil){
+		if(s != 0 || (sp = srvget(name, 0)) == nil)
+			return -1;
+		srvdir(c, sp, dp);
+		srvput(sp);
+		return 1;
+	}
 
-	if(sp == 0) {
+	qlock(&srvlk);
+	if(srvcursgen != srvlistgen || srvcursidx > s){
+		srvcurs = srv;
+		srvcursidx = 0;
+		srvcursgen = srvlistgen;
+	}
+	while(srvcurs != nil && srvcursidx < s){
+		srvcurs = srvcurs->link;
+		srvcursidx++;
+	}
+	sp = srvcurs;
+	if(sp == nil) {
 		qunlock(&srvlk);
 		return -1;
 	}
-
-	mkqid(&q, sp->path, 0, QTFILE);
-	/* make sure name string continues to exist after we release lock */
-	kstrcpy(up->genbuf, sp->name, sizeof up->genbuf);
-	devdir(c, q, up->genbuf, 0, sp->owner, sp->perm, dp);
+	srvdir(c, sp, dp);
 	qunlock(&srvlk);
 	return 1;
 }
@@ -67,20 +265,24 @@ srvwalk(Chan *c, Chan *nc, char **name, int nname)
 	return devwalk(c, nc, name, nname, 0, 0, srvgen);
 }
 
-static Srv*
-srvlookup(char *name, ulong qidpath)
-{
-	Srv *sp;
-	for(sp = srv; sp; sp = sp->link)
-		if(sp->path == qidpath || (name && strcmp(sp->name, name) == 0))
-			return sp;
-	return nil;
-}
-
 static int
 srvstat(Chan *c, uchar *db, int n)
 {
-	return devstat(c, db, n, 0, 0, srvgen);
+	Srv *sp;
+	Dir d;
+
+	if(c->qid.type & QTDIR)
+		return devstat(c, db, n, 0, 0, srvgen);
+	if((sp = srvget(nil, c->qid.path)) == nil)
+		error(Enonexist);
+	srvdir(c, sp, &d);
+	srvput(sp);
+	if(c->flag&CMSG)
+		d.mode |= DMMOUNT;
+	n = convD2M(&d, db, n);
+	if(n == 0)
+		error(Ebadarg);
+	return n;
 }
 
 char*
@@ -89,19 +291,24 @@ srvname(Chan *c)
 	Srv *sp;
 	char *s;
 
+	s = nil;
+	_xinc(&srvreaders);
 	for(sp = srv; sp; sp = sp->link)
 		if(sp->chan == c){
 			s = smalloc(3+strlen(sp->name)+1);
 			sprint(s, "#s/%s", sp->name);
-			return s;
+			break;
 		}
-	return nil;
+	_xdec(&srvreaders);
+	return s;
 }
 
 static Chan*
 srvopen(Chan *c, int omode)
 {
 	Srv *sp;
+	Chan *nc;
+	char owner[KNAMELEN];
 
 	if(c->qid.type == QTDIR){
 		if(omode & ORCLOSE)
@@ -113,34 +320,64 @@ srvopen(Chan *c, int omode)
 		c->offset = 0;
 		return c;
 	}
-	qlock(&srvlk);
+
+	sp = srvget(nil, c->qid.path);
+	if(sp == nil)
+		error(Eshutdown);
 	if(waserror()){
-		qunlock(&srvlk);
+		srvput(sp);
 		nexterror();
 	}
-
-	sp = srvlookup(nil, c->qid.path);
-	if(sp == 0 || sp->chan == 0)
+	nc = sp->chan;
+	if(nc == nil)
 		error(Eshutdown);
 
 	if(omode&OTRUNC)
 		error("srv file already exists");
-	if(openmode(omode)!=sp->chan->mode && sp->chan->mode!=ORDWR)
+	if(openmode(omode)!=nc->mode && nc->mode!=ORDWR)
 		error(Eperm);
-	devpermcheck(sp->owner, sp->perm, omode);
+	_xinc(&srvreaders);
+	kstrcpy(owner, sp->owner, sizeof owner);
+	_xdec(&srvreaders);
+	devpermcheck(owner, sp->perm, omode);
 
-	cclose(c);
-	incref(sp->chan);
-	qunlock(&srvlk);
+	incref(nc);
 	poperror();
-	return sp->chan;
+	srvput(sp);
+	cclose(c);
+	return nc;
+}
+
+/* call with srvlk held */
+static void
+srvlink(Srv *sp)
+{
+	ulong h;
+
+	h = srvhash(sp->name);
+	sp->nhash = srvnhash[h];
+	coherence();
+	srvnhash[h] = sp;
+}
+
+/* call with srvlk held */
+static void
+srvunlink(Srv *sp)
+{
+	Srv **l;
+
+	for(l = &srvnhash[srvhash(sp->name)]; *l != nil; l = &(*l)->nhash)
+		if(*l == sp){
+			*l = sp->nhash;
+			break;
+		}
 }
 
 static void
 srvcreate(Chan *c, char *name, int omode, ulong perm)
 {
 	char *sname;
-	Srv *sp;
+	Srv *sp, *osp;
 
 	if(openmode(omode) != OWRITE)
 		error(Eperm);
@@ -150,31 +387,38 @@ srvcreate(Chan *c, char *name, int omode, ulong perm)
 
 	sp = smalloc(sizeof *sp);
 	sname = smalloc(strlen(name)+1);
+	strcpy(sname, name);
+	sp->name = sname;
+	kstrdup(&sp->owner, up->user);
+	sp->perm = perm&0777;
+	sp->ref = 1;
 
 	qlock(&srvlk);
 	if(waserror()){
-		free(sp);
-		free(sname);
 		qunlock(&srvlk);
+		free(sp->owner);
+		free(sp->name);
+		free(sp);
 		nexterror();
 	}
-	if(sp == nil || sname == nil)
-		error(Enomem);
-	if(srvlookup(name, -1))
+	if((osp = srvfind(name, 0)) != nil){
+		srvput(osp);
 		error(Eexist);
+	}
 
 	sp->path = qidpath++;
 	sp->link = srv;
-	strcpy(sname, name);
-	sp->name = sname;
+	sp->phash = srvphash[sp->path % Nsrvhash];
 	c->qid.type = QTFILE;
 	c->qid.path = sp->path;
+	coherence();
 	srv = sp;
+	srvphash[sp->path % Nsrvhash] = sp;
+	srvlink(sp);
+	srvlistgen++;
 	qunlock(&srvlk);
 	poperror();
-
-	kstrdup(&sp->owner, up->user);
-	sp->perm = perm&0777;
+	srvreap();
 
 	c->flag |= COPEN;
 	c->mode = OWRITE;
@@ -193,13 +437,9 @@ srvremove(Chan *c)
 		qunlock(&srvlk);
 		nexterror();
 	}
-	l = &srv;
-	for(sp = *l; sp; sp = sp->link) {
+	for(sp = srvphash[c->qid.path % Nsrvhash]; sp; sp = sp->phash)
 		if(sp->path == c->qid.path)
 			break;
-
-		l = &sp->link;
-	}
 	if(sp == 0)
 		error(Enonexist);
 
@@ -218,21 +458,27 @@ srvremove(Chan *c)
 	if((sp->perm&7) != 7 && strcmp(sp->owner, up->user) && !iseve())
 		error(Eperm);
 
+	for(l = &srv; *l != sp; l = &(*l)->link)
+		;
 	*l = sp->link;
+	for(l = &srvphash[sp->path % Nsrvhash]; *l != sp; l = &(*l)->phash)
+		;
+	*l = sp->phash;
+	srvunlink(sp);
+	lock(sp);
+	sp->gone = 1;
+	unlock(sp);
+	srvlistgen++;
 	qunlock(&srvlk);
 	poperror();
 
-	if(sp->chan)
-		cclose(sp->chan);
-	free(sp->owner);
-	free(sp->name);
-	free(sp);
+	srvput(sp);
 }
 
 static int
 srvwstat(Chan *c, uchar *dp, int n)
 {
-	char *strs;
+	char *strs, *s;
 	Dir d;
 	Srv *sp;
 
@@ -240,14 +486,17 @@ srvwstat(Chan *c, uchar *dp, int n)
 		error(Eperm);
 
 	strs = nil;
+	sp = nil;
 	qlock(&srvlk);
 	if(waserror()){
 		qunlock(&srvlk);
+		if(sp != nil)
+			srvput(sp);
 		free(strs);
 		nexterror();
 	}
 
-	sp = srvlookup(nil, c->qid.path);
+	sp = srvfind(nil, c->qid.path);
 	if(sp == 0)
 		error(Enonexist);
 
@@ -258,18 +507,36 @@ srvwstat(Chan *c, uchar *dp, int n)
 	n = convM2D(dp, n, &d, strs);
 	if(n == 0)
 		error(Eshortstat);
-	if(d.mode != ~0UL)
-		sp->perm = d.mode & 0777;
-	if(d.uid && *d.uid)
-		kstrdup(&sp->owner, d.uid);
 	if(d.name && *d.name && strcmp(sp->name, d.name) != 0) {
 		if(strchr(d.name, '/') != nil)
 			error(Ebadchar);
-		kstrdup(&sp->name, d.name);
+	}
+	if(d.mode != ~0UL)
+		sp->perm = d.mode & 0777;
+
+	/* lookups may be reading the old strings; let them finish */
+	if(d.uid && *d.uid){
+		s = nil;
+		kstrdup(&s, d.uid);
+		srvdefer(sp->owner);
+		sp->owner = s;
+	}
+	if(d.name && *d.name && strcmp(sp->name, d.name) != 0) {
+		s = smalloc(strlen(d.name)+1);
+		strcpy(s, d.name);
+		srvseq++;
+		coherence();
+		srvunlink(sp);
+		srvdefer(sp->name);
+		sp->name = s;
+		srvlink(sp);
+		coherence();
+		srvseq++;
 	}
 	qunlock(&srvlk);
-	free(strs);
 	poperror();
+	srvput(sp);
+	free(strs);
 	return n;
 }
 
@@ -312,9 +579,12 @@ srvwrite(Chan *c, void *va, long n, vlong)
 
 	c1 = fdtochan(fd, -1, 0, 1);	/* error check and inc ref */
 
+	sp = nil;
 	qlock(&srvlk);
 	if(waserror()) {
 		qunlock(&srvlk);
+		if(sp != nil)
+			srvput(sp);
 		cclose(c1);
 		nexterror();
 	}
@@ -322,7 +592,7 @@ srvwrite(Chan *c, void *va, long n, vlong)
 		error("posted fd has remove-on-close or close-on-exec");
 	if(c1->qid.type & QTAUTH)
 		error("cannot post auth file in srv");
-	sp = srvlookup(nil, c->qid.path);
+	sp = srvfind(nil, c->qid.path);
 	if(sp == 0)
 		error(Enonexist);
 
@@ -332,6 +602,7 @@ srvwrite(Chan *c, void *va, long n, vlong)
 	sp->chan = c1;
 	qunlock(&srvlk);
 	poperror();
+	srvput(sp);
 	return n;
 }
 
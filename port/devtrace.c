@@ -0,0 +1,258 @@
+#include	"u.h"
+#include	"../port/lib.h"
+#include	"mem.h"
+#include	"dat.h"
+#include	"fns.h"
+#include	"../port/error.h"
+
+/*
+ *  kernel trace points.  each enabled TRACEPT drops a Tracerec
+ *  into its processor's ring; reading trace returns the records
+ *  of all processors merged by time stamp, in native byte order.
+ *  a read returns what has gathered since the last one, 0 if
+ *  nothing has.
+ */
+
+enum{
+	Tracedirqid,
+	Tracedataqid,
+	Tracectlqid,
+
+	Tracesize	= 64*1024,	/* bytes of ring per processor */
+};
+
+Dirtab tracetab[]={
+	".",		{Tracedirqid, 0, QTDIR},	0,	DMDIR|0550,
+	"trace",	{Tracedataqid},		0,	0400,
+	"tracectl",	{Tracectlqid},		0,	0600,
+};
+
+static char *tpname[NTracept] = {
+[TPqput]	"qput",
+[TPqget]	"qget",
+[TPmntrpc]	"mntrpc",
+[TPmntreply]	"mntreply",
+[TPtcpstate]	"tcpstate",
+[TPtcprexmit]	"tcprexmit",
+[TPfault]	"fault",
+[TPsdio]	"sdio",
+[TPsddone]	"sddone",
+};
+
+static struct
+{
+	QLock;
+	Logring	ring[MAXMACH];
+} trace;
+
+enum
+{
+	CMon,
+	CMoff,
+};
+
+static Cmdtab tracectlmsg[] =
+{
+	CMon,	"on",	0,
+	CMoff,	"off",	0,
+};
+
+static void
+_tracepoint(int tp, uvlong a, ulong b, ulong c)
+{
+	Tracerec r;
+	int s;
+
+	s = splhi();
+	r.ts = fastticks(nil);
+	r.a = a;
+	r.b = b;
+	r.c = c;
+	r.pid = up != nil? up->pid: 0;
+	r.tp = tp;
+	r.machno = m->machno;
+	r.pad = 0;
+	logringput(&trace.ring[m->machno], (char*)&r, sizeof r);
+	splx(s);
+}
+
+static void
+traceinit(void)
+{
+	tracepoint = _tracepoint;
+}
+
+/*
+ *  the rings are made when the first trace point is turned on
+ *  and kept; writers ignore a ring without a buffer.
+ */
+static void
+tracerings(void)
+{
+	Logring *r;
+	char *p;
+	int i;
+
+	for(i = 0; i < conf.nmach; i++){
+		r = &trace.ring[i];
+		if(r->buf != nil)
+			continue;
+		p = malloc(Tracesize);
+		if(p == nil)
+			error(Enomem);
+		r->size = Tracesize;
+		coherence();
+		r->buf = p;
+	}
+}
+
+static Chan*
+traceattach(char *spec)
+{
+	return devattach('Z', spec);
+}
+
+static Walkqid*
+tracewalk(Chan *c, Chan *nc, char **name, int nname)
+{
+	return devwalk(c, nc, name, nname, tracetab, nelem(tracetab), devgen);
+}
+
+static int
+tracestat(Chan *c, uchar *db, int n)
+{
+	return devstat(c, db, n, tracetab, nelem(tracetab), devgen);
+}
+
+static Chan*
+traceopen(Chan *c, int omode)
+{
+	ulong *off;
+	int i;
+
+	c = devopen(c, omode, tracetab, nelem(tracetab), devgen);
+	if((ulong)c->qid.path == Tracedataqid){
+		/* start at the oldest record still held */
+		off = smalloc(MAXMACH*sizeof(ulong));
+		for(i = 0; i < MAXMACH; i++)
+			off[i] = trace.ring[i].tail;
+		c->aux = off;
+	}
+	return c;
+}
+
+static void
+traceclose(Chan *c)
+{
+	if((c->flag & COPEN) && (ulong)c->qid.path == Tracedataqid){
+		free(c->aux);
+		c->aux = nil;
+	}
+}
+
+static long
+traceread(Chan *c, void *va, long n, vlong off)
+{
+	char *buf, *p, *e;
+	uvlong hz;
+	int i;
+
+	switch((ulong)c->qid.path){
+	case Tracedirqid:
+		return devdirread(c, va, n, tracetab, nelem(tracetab), devgen);
+
+	case Tracedataqid:
+		if(n < sizeof(Tracerec))
+			error(Etoosmall);
+		n -= n % sizeof(Tracerec);
+		return logringread(trace.ring, MAXMACH, c->aux, va, n);
+
+	case Tracectlqid:
+		buf = smalloc(READSTR);
+		if(waserror()){
+			free(buf);
+			nexterror();
+		}
+		e = buf + READSTR;
+		fastticks(&hz);
+		p = seprint(buf, e, "hz %llud\nrecord %d\n", hz, sizeof(Tracerec));
+		for(i = 0; i < NTracept; i++)
+			p = seprint(p, e, "%d %s %s\n", i, tpname[i],
+				(tracepts & 1<<i)? "on": "off");
+		n = readstr(off, va, n, buf);
+		poperror();
+		free(buf);
+		return n;
+	}
+	error(Egreg);
+	return 0;
+}
+
+static long
+tracewrite(Chan *c, void *a, long n, vlong)
+{
+	Cmdbuf *cb;
+	Cmdtab *ct;
+	ulong mask;
+	int i, j;
+
+	if((ulong)c->qid.path != Tracectlqid)
+		error(Ebadusefd);
+
+	cb = parsecmd(a, n);
+	qlock(&trace);
+	if(waserror()){
+		qunlock(&trace);
+		free(cb);
+		nexterror();
+	}
+	ct = lookupcmd(cb, tracectlmsg, nelem(tracectlmsg));
+
+	/* no names means all of them */
+	mask = 0;
+	if(cb->nf == 1)
+		mask = (1<<NTracept)-1;
+	for(i = 1; i < cb->nf; i++){
+		for(j = 0; j < NTracept; j++)
+			if(strcmp(cb->f[i], tpname[j]) == 0)
+				break;
+		if(j == NTracept)
+			error(Ebadctl);
+		mask |= 1<<j;
+	}
+
+	switch(ct->index){
+	case CMon:
+		tracerings();
+		tracepts |= mask;
+		break;
+	case CMoff:
+		tracepts &= ~mask;
+		break;
+	}
+	qunlock(&trace);
+	poperror();
+	free(cb);
+	return n;
+}
+
+Dev tracedevtab = {
+	'Z',
+	"trace",
+
+	devreset,
+	traceinit,
+	devshutdown,
+	traceattach,
+	tracewalk,
+	tracestat,
+	traceopen,
+	devcreate,
+	traceclose,
+	traceread,
+	devbread,
+	tracewrite,
+	devbwrite,
+	devremove,
+	devwstat,
+};
@@ -18,8 +18,6 @@ enum {
 static long	now;	/* Low order 32 bits of time in µs */
 extern ulong	delayedscheds;
 extern Schedq	runq[Nrq];
-extern int	nrdy;
-extern ulong	runvec;
 
 /* Statistics stuff */
 ulong		nilcount;
@@ -32,13 +30,28 @@ int		edfinited;
 QLock		edfschedlock;
 static Lock	thelock;
 
-enum{
-	Dl,	/* Invariant for schedulability test: Dl < Rl */
-	Rl,
+enum {
+	Uscale	= 1<<20,	/* utilisation fixed point: a whole processor */
+	Nperiod	= 64,		/* period hash, for synchronising releases */
+};
+
+/*
+ *  admitted procs are partitioned onto processors, each with
+ *  a heap of its released procs in deadline order.  a proc is
+ *  admitted if the sum of C/D over its processor stays within
+ *  1, which is enough for edf on one processor.
+ */
+typedef struct Edfq Edfq;
+struct Edfq {
+	Lock;
+	Proc	**heap;		/* 1-origin */
+	int	n;
+	ulong	util;		/* of the procs admitted here */
 };
 
-static char *testschedulability(Proc*);
-static Proc *qschedulability;
+static Edfq	edfq[MAXMACH];
+static Lock	edfperiodlock;
+static Proc	*edfperiod[Nperiod];	/* a proc admitted with each period */
 
 enum {
 	Onemicrosecond =	1,
@@ -84,6 +97,130 @@ timeconv(Fmt *f)
 
 long edfcycles;
 
+static int
+earlier(Proc *a, Proc *b)
+{
+	return a->edf->d - b->edf->d < 0;
+}
+
+static void
+heapset(Edfq *q, int i, Proc *p)
+{
+	q->heap[i] = p;
+	p->edf->heapi = i;
+}
+
+static void
+heapup(Edfq *q, int i)
+{
+	Proc *p;
+
+	p = q->heap[i];
+	while(i > 1 && earlier(p, q->heap[i/2])){
+		heapset(q, i, q->heap[i/2]);
+		i /= 2;
+	}
+	heapset(q, i, p);
+}
+
+static void
+heapdown(Edfq *q, int i)
+{
+	Proc *p;
+	int c;
+
+	p = q->heap[i];
+	for(;;){
+		c = 2*i;
+		if(c > q->n)
+			break;
+		if(c < q->n && earlier(q->heap[c+1], q->heap[c]))
+			c++;
+		if(!earlier(q->heap[c], p))
+			break;
+		heapset(q, i, q->heap[c]);
+		i = c;
+	}
+	heapset(q, i, p);
+}
+
+/* called with q locked */
+static void
+heapdel(Edfq *q, Proc *p)
+{
+	int i;
+	Proc *l;
+
+	i = p->edf->heapi;
+	p->edf->heapi = 0;
+	l = q->heap[q->n--];
+	if(l == p)
+		return;
+	heapset(q, i, l);
+	heapup(q, i);
+	heapdown(q, l->edf->heapi);
+}
+
+/*
+ *  take p off its edf queue, unless it's still
+ *  being switched out.  called splhi.
+ */
+static Proc*
+edfdequeue(Proc *p)
+{
+	Edfq *q;
+
+	q = &edfq[p->edf->mach];
+	lock(q);
+	if(p->edf->heapi == 0 || p->mach){
+		unlock(q);
+		return nil;
+	}
+	heapdel(q, p);
+	unlock(q);
+	return p;
+}
+
+/*
+ *  the released proc with the earliest deadline on this
+ *  processor, dequeued.  called splhi.
+ */
+Proc*
+edfrunproc(void)
+{
+	Edfq *q;
+	Proc *p;
+
+	q = &edfq[m->machno];
+	if(q->n == 0)
+		return nil;
+	p = nil;
+	lock(q);
+	if(q->n > 0 && q->heap[1]->mach == nil){
+		p = q->heap[1];
+		heapdel(q, p);
+	}
+	unlock(q);
+	return p;
+}
+
+int
+edfanyready(void)
+{
+	return edfq[m->machno].n != 0;
+}
+
+int
+edfnready(void)
+{
+	int i, n;
+
+	n = 0;
+	for(i = 0; i < conf.nmach; i++)
+		n += edfq[i].n;
+	return n;
+}
+
 Edf*
 edflock(Proc *p)
 {
@@ -209,7 +346,7 @@ release(Proc *p)
 static void
 releaseintr(Ureg*, Timer *t)
 {
-	Proc *p;
+	Proc *p, *pp;
 	extern int panicking;
 	Schedq *rq;
 
@@ -226,8 +363,13 @@ releaseintr(Ureg*, Timer *t)
 		return;
 	case Ready:
 		/* remove proc from current runq */
-		rq = &runq[p->priority];
-		if(dequeueproc(rq, p) != p){
+		if(p->priority == PriEdf)
+			pp = edfdequeue(p);
+		else{
+			rq = &runq[p->priority];
+			pp = dequeueproc(rq, p);
+		}
+		if(pp != p){
 			DPRINT("releaseintr: can't find proc or lock race\n");
 			release(p);	/* It'll start best effort */
 			edfunlock();
@@ -336,12 +478,62 @@ edfrun(Proc *p, int edfpri)
 	e->s = now;
 }
 
+/*
+ *  pick the least loaded processor p fits on, or the one it's
+ *  wired to, and wire it there.  called with edfschedlock held.
+ */
+static char*
+edfpartition(Proc *p)
+{
+	Edf *e;
+	Edfq *q;
+	Proc **h;
+	ulong u;
+	int i, mach, s;
+
+	e = p->edf;
+	u = ((uvlong)e->C*Uscale + e->D-1) / e->D;
+	mach = -1;
+	for(i = 0; i < conf.nmach; i++){
+		if(p->wired != nil && p->wired != MACHP(i))
+			continue;
+		if(e->heapi != 0 && i != e->mach)	/* still queued from before */
+			continue;
+		if(edfq[i].util + u > Uscale)
+			continue;
+		if(mach == -1 || edfq[i].util < edfq[mach].util)
+			mach = i;
+	}
+	if(mach == -1)
+		return "not schedulable";
+
+	q = &edfq[mach];
+	if(q->heap == nil){
+		h = malloc((conf.nproc+1)*sizeof(Proc*));
+		if(h == nil)
+			return Enomem;
+		q->heap = h;
+	}
+	s = splhi();
+	lock(q);
+	q->util += u;
+	unlock(q);
+	splx(s);
+	e->util = u;
+	e->mach = mach;
+	if(p->wired == nil){
+		p->wired = MACHP(mach);
+		p->mp = p->wired;
+		e->flags |= Pinned;
+	}
+	return nil;
+}
+
 char *
 edfadmit(Proc *p)
 {
 	char *err;
 	Edf *e;
-	int i;
 	Proc *r;
 	void (*pt)(Proc*, int, vlong);
 	long tns;
@@ -363,7 +555,7 @@ edfadmit(Proc *p)
 		return "C > D";
 
 	qlock(&edfschedlock);
-	if (err = testschedulability(p)){
+	if (err = edfpartition(p)){
 		qunlock(&edfschedlock);
 		return err;
 	}
@@ -375,17 +567,15 @@ edfadmit(Proc *p)
 		pt(p, SAdmit, 0);
 
 	/* Look for another proc with the same period to synchronize to */
-	SET(r);
-	for(i=0; i<conf.nproc; i++) {
-		r = proctab(i);
-		if(r->state == Dead || r == p)
-			continue;
-		if (r->edf == nil || (r->edf->flags & Admitted) == 0)
-			continue;
-		if (r->edf->T == e->T)
-				break;
-	}
-	if (i == conf.nproc){
+	lock(&edfperiodlock);
+	r = edfperiod[(ulong)e->T % Nperiod];
+	if(r == nil || r == p || r->edf == nil || r->edf->T != e->T)
+		r = nil;
+	else
+		e->t = r->edf->t;
+	edfperiod[(ulong)e->T % Nperiod] = p;
+	unlock(&edfperiodlock);
+	if (r == nil){
 		/* Can't synchronize to another proc, release now */
 		e->t = now;
 		e->d = 0;
@@ -407,7 +597,6 @@ edfadmit(Proc *p)
 		}
 	}else{
 		/* Release in synch to something else */
-		e->t = r->edf->t;
 		if (p == up){
 			DPRINT("%lud edfadmit self %lud[%s], release at %lud\n",
 				now, p->pid, statename[p->state], e->t);
@@ -439,6 +628,7 @@ edfstop(Proc *p)
 {
 	Edf *e;
 	void (*pt)(Proc*, int, vlong);
+	int requeue;
 
 	if(e = edflock(p)){
 		DPRINT("%lud edfstop %lud[%s]\n", now, p->pid, statename[p->state]);
@@ -447,7 +637,23 @@ edfstop(Proc *p)
 		e->flags &= ~Admitted;
 		if(e->tt)
 			timerdel(e);
+		lock(&edfq[e->mach]);
+		edfq[e->mach].util -= e->util;
+		unlock(&edfq[e->mach]);
+		e->util = 0;
+		if(e->flags & Pinned){
+			p->wired = nil;
+			e->flags &= ~Pinned;
+		}
+		lock(&edfperiodlock);
+		if(edfperiod[(ulong)e->T % Nperiod] == p)
+			edfperiod[(ulong)e->T % Nperiod] = nil;
+		unlock(&edfperiodlock);
+		/* a released proc moves to the ordinary run queues */
+		requeue = p->state == Ready && edfdequeue(p) == p;
 		edfunlock();
+		if(requeue)
+			ready(p);
 	}
 }
 
@@ -499,8 +705,7 @@ int
 edfready(Proc *p)
 {
 	Edf *e;
-	Schedq *rq;
-	Proc *l, *pp;
+	Edfq *q;
 	void (*pt)(Proc*, int, vlong);
 	long n;
 
@@ -562,118 +767,16 @@ edfready(Proc *p)
 	}
 	edfunlock();
 	DPRINT("^");
-	rq = &runq[PriEdf];
-	/* insert in queue in earliest deadline order */
-	lock(runq);
-	l = nil;
-	for(pp = rq->head; pp; pp = pp->rnext){
-		if(pp->edf->d > e->d)
-			break;
-		l = pp;
-	}
-	p->rnext = pp;
-	if (l == nil)
-		rq->head = p;
-	else
-		l->rnext = p;
-	if(pp == nil)
-		rq->tail = p;
-	rq->n++;
-	nrdy++;
-	runvec |= 1 << PriEdf;
+	/* insert in its processor's heap in earliest deadline order */
+	q = &edfq[e->mach];
+	lock(q);
 	p->priority = PriEdf;
 	p->readytime = m->ticks;
 	p->state = Ready;
-	unlock(runq);
+	q->heap[++q->n] = p;
+	heapup(q, q->n);
+	unlock(q);
 	if(p->trace && (pt = proctrace))
 		pt(p, SReady, 0);
 	return 1;
 }
-
-
-static void
-testenq(Proc *p)
-{
-	Proc *xp, **xpp;
-	Edf *e;
-
-	e = p->edf;
-	e->testnext = nil;
-	if (qschedulability == nil) {
-		qschedulability = p;
-		return;
-	}
-	SET(xp);
-	for (xpp = &qschedulability; *xpp; xpp = &xp->edf->testnext) {
-		xp = *xpp;
-		if (e->testtime - xp->edf->testtime < 0
-		|| (e->testtime == xp->edf->testtime && e->testtype < xp->edf->testtype)){
-			e->testnext = xp;
-			*xpp = p;
-			return;
-		}
-	}
-	assert(xp->edf->testnext == nil);
-	xp->edf->testnext = p;
-}
-
-static char *
-testschedulability(Proc *theproc)
-{
-	Proc *p;
-	long H, G, Cb, ticks;
-	int steps, i;
-
-	/* initialize */
-	DPRINT("schedulability test %lud\n", theproc->pid);
-	qschedulability = nil;
-	for(i=0; i<conf.nproc; i++) {
-		p = proctab(i);
-		if(p->state == Dead)
-			continue;
-		if ((p->edf == nil || (p->edf->flags & Admitted) == 0) && p != theproc)
-			continue;
-		p->edf->testtype = Rl;
-		p->edf->testtime = 0;
-		DPRINT("\tInit: edfenqueue %lud\n", p->pid);
-		testenq(p);
-	}
-	H=0;
-	G=0;
-	for(steps = 0; steps < Maxsteps; steps++){
-		p = qschedulability;
-		qschedulability = p->edf->testnext;
-		ticks = p->edf->testtime;
-		switch (p->edf->testtype){
-		case Dl:
-			H += p->edf->C;
-			Cb = 0;
-			DPRINT("\tStep %3d, Ticks %lud, pid %lud, deadline, H += %lud → %lud, Cb = %lud\n",
-				steps, ticks, p->pid, p->edf->C, H, Cb);
-			if (H+Cb>ticks){
-				DPRINT("not schedulable\n");
-				return "not schedulable";
-			}
-			p->edf->testtime += p->edf->T - p->edf->D;
-			p->edf->testtype = Rl;
-			testenq(p);
-			break;
-		case Rl:
-			DPRINT("\tStep %3d, Ticks %lud, pid %lud, release, G  %lud, C%lud\n",
-				steps, ticks, p->pid, p->edf->C, G);
-			if(ticks && G <= ticks){
-				DPRINT("schedulable\n");
-				return nil;
-			}
-			G += p->edf->C;
-			p->edf->testtime += p->edf->D;
-			p->edf->testtype = Dl;
-			testenq(p);
-			break;
-		default:
-			assert(0);
-		}
-	}
-	DPRINT("probably not schedulable\n");
-	return "probably not schedulable";
-}
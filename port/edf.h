@@ -1,6 +1,4 @@
 enum {
-	Maxsteps = 200 * 100 * 2,	/* 100 periods of 200 procs */
-
 	/* Edf.flags field */
 	Admitted		= 0x01,
 	Sporadic		= 0x02,
@@ -9,6 +7,7 @@ enum {
 	Deadline		= 0x10,
 	Yield			= 0x20,
 	Extratime		= 0x40,
+	Pinned			= 0x80,	/* wired by admission */
 
 	Infinity = ~0ULL,
 };
@@ -28,11 +27,10 @@ struct Edf {
 	long		d;		/* (this) deadline */
 	long		t;		/* Start of next period, t += T at release */
 	long		s;		/* Time at which this proc was last scheduled */
-	/* for schedulability testing */
-	long		testDelta;
-	int		testtype;	/* Release or Deadline */
-	long		testtime;
-	Proc		*testnext;
+	/* for admission and dispatch */
+	ulong		util;		/* C/D, scaled by Uscale */
+	int		mach;		/* processor it's partitioned onto */
+	int		heapi;		/* index in that one's edfq, 0 if none */
 	/* other */
 	ushort		flags;
 	Timer;
@@ -22,6 +22,9 @@ fault(ulong addr, int read)
 	spllo();
 
 	m->pfault++;
+	up->stats.faults++;
+	mstats[m->machno].faults++;
+	TRACEPT(TPfault, addr, read, 0);
 	for(tries = 200; tries > 0; tries--) {	/* TODO: reset to 20 */
 		s = seg(up, addr, 1);		/* leaves s->lk qlocked if seg != nil */
 		if(s == 0) {
@@ -46,6 +49,7 @@ fault(ulong addr, int read)
 	 */
 	if (tries <= 0)
 		panic("fault: fault stuck on va %#8.8p read %d\n", addr, read);
+	TRACEPT(TPfault, addr, read, 1);
 
 	up->psstate = sps;
 	return 0;
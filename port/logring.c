@@ -0,0 +1,195 @@
+#include	"u.h"
+#include	"../port/lib.h"
+#include	"mem.h"
+#include	"dat.h"
+#include	"fns.h"
+#include	"../port/error.h"
+
+/*
+ *  log rings.  each processor appends time-stamped records
+ *  to its own ring, at splhi and without a lock; readers
+ *  copy the rings out and merge the records by time stamp.
+ *  a writer lapping a reader shows up as a change of tail.
+ */
+typedef struct Loghdr Loghdr;
+struct Loghdr {
+	uvlong	ts;
+	ulong	n;
+};
+
+static int logringclock;	/* fastticks can be called */
+
+ulong	tracepts;		/* enabled trace points, see devtrace.c */
+
+/*
+ *  time stamps from now on
+ */
+void
+logringinit(void)
+{
+	logringclock = 1;
+}
+
+static void
+ringcopyin(Logring *r, ulong off, void *a, ulong n)
+{
+	ulong o, m;
+	char *p;
+
+	p = a;
+	o = off & (r->size-1);
+	m = r->size - o;
+	if(m > n)
+		m = n;
+	memmove(r->buf+o, p, m);
+	memmove(r->buf, p+m, n-m);
+}
+
+static void
+ringcopyout(Logring *r, ulong off, void *a, ulong n)
+{
+	ulong o, m;
+	char *p;
+
+	p = a;
+	o = off & (r->size-1);
+	m = r->size - o;
+	if(m > n)
+		m = n;
+	memmove(p, r->buf+o, m);
+	memmove(p+m, r->buf, n-m);
+}
+
+/*
+ *  append a record to r, which must be this processor's.
+ *  called splhi.
+ */
+void
+logringput(Logring *r, char *s, int n)
+{
+	Loghdr h;
+	ulong need;
+
+	if(r->buf == nil || n <= 0)
+		return;
+	/* take the tail of huge writes */
+	if(n > r->size/2){
+		s += n - r->size/2;
+		n = r->size/2;
+	}
+	need = sizeof h + n;
+	while(r->head + need - r->tail > r->size){
+		ringcopyout(r, r->tail, &h, sizeof h);
+		r->tail += sizeof h + h.n;
+	}
+	coherence();
+	h.ts = logringclock? fastticks(nil): 0;
+	h.n = n;
+	ringcopyin(r, r->head, &h, sizeof h);
+	ringcopyin(r, r->head + sizeof h, s, n);
+	coherence();
+	r->head += need;
+}
+
+/*
+ *  copy r from *off to its head into buf, all whole records.
+ *  *off moves up to the tail if the writer has passed it.
+ */
+static ulong
+ringsnap(Logring *r, ulong *off, char *buf)
+{
+	ulong h, t, o, n;
+	int tries;
+
+	for(tries = 0;; tries++){
+		t = r->tail;
+		h = r->head;
+		coherence();
+		o = *off;
+		if((long)(o - t) < 0 || (long)(h - o) < 0)
+			o = t;
+		n = h - o;
+		ringcopyout(r, o, buf, n);
+		coherence();
+		if((long)(r->tail - o) <= 0)
+			break;
+		if(tries == 3){		/* give up on a busy writer */
+			o = h;
+			n = 0;
+			break;
+		}
+	}
+	*off = o;
+	return n;
+}
+
+/*
+ *  merge the records of the nr rings in lr, from off[i] on,
+ *  by time stamp into buf: as many whole records as fit, or
+ *  what fits of the first.  off[i] moves past what was taken.
+ */
+long
+logringread(Logring *lr, int nr, ulong *off, char *buf, long len)
+{
+	char **snap;
+	ulong *n, *pos;
+	Loghdr h;
+	long tot, m;
+	int i, best;
+	uvlong ts;
+
+	if(len <= 0)
+		return 0;
+	snap = smalloc(nr*sizeof(char*));
+	n = smalloc(nr*sizeof(ulong));
+	pos = smalloc(nr*sizeof(ulong));
+	if(waserror()){
+		for(i = 0; i < nr; i++)
+			free(snap[i]);
+		free(snap);
+		free(n);
+		free(pos);
+		nexterror();
+	}
+	for(i = 0; i < nr; i++)
+		if(lr[i].buf != nil){
+			snap[i] = smalloc(lr[i].size);
+			n[i] = ringsnap(&lr[i], &off[i], snap[i]);
+		}
+
+	ts = 0;
+	tot = 0;
+	for(;;){
+		best = -1;
+		for(i = 0; i < nr; i++){
+			if(pos[i] >= n[i])
+				continue;
+			memmove(&h, snap[i]+pos[i], sizeof h);
+			if(best < 0 || h.ts < ts){
+				best = i;
+				ts = h.ts;
+			}
+		}
+		if(best < 0)
+			break;
+		memmove(&h, snap[best]+pos[best], sizeof h);
+		m = h.n;
+		if(tot + m > len){
+			if(tot > 0)
+				break;
+			m = len;
+		}
+		memmove(buf+tot, snap[best]+pos[best]+sizeof h, m);
+		tot += m;
+		pos[best] += sizeof h + h.n;
+	}
+	for(i = 0; i < nr; i++){
+		off[i] += pos[i];
+		free(snap[i]);
+	}
+	free(snap);
+	free(n);
+	free(pos);
+	poperror();
+	return tot;
+}
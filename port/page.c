@@ -141,18 +141,15 @@ newpage(int clear, Segment **s, ulong va)
 			*s = 0;
 			dontalloc = 1;
 		}
-		qlock(&palloc.pwait);	/* Hold memory requesters here */
-
 		while(waserror())	/* Ignore interrupts */
 			;
 
+		/* Hold memory requesters here, woken one at a time */
 		kickpager();
-		tsleep(&palloc.r, ispages, 0, 1000);
+		sqtsleep(&palloc.pwait, &up->sqr, ispages, 0, 1, 1000);
 
 		poperror();
 
-		qunlock(&palloc.pwait);
-
 		/*
 		 * If called from fault and we lost the segment from
 		 * underneath don't waste time allocating and freeing
@@ -232,8 +229,8 @@ putpage(Page *p)
 	else 
 		pagechainhead(p);
 
-	if(palloc.r.p != 0)
-		wakeup(&palloc.r);
+	if(palloc.pwait.head != nil)
+		sqwakeup(&palloc.pwait);
 
 	unlock(p);
 	unlock(&palloc);
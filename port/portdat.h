@@ -14,10 +14,12 @@ typedef struct DevConf	DevConf;
 typedef struct Image	Image;
 typedef struct Log	Log;
 typedef struct Logflag	Logflag;
+typedef struct Logring	Logring;
 typedef struct Mntcache Mntcache;
 typedef struct Mount	Mount;
 typedef struct Mntrpc	Mntrpc;
 typedef struct Mntwalk	Mntwalk;
+typedef struct Mstats	Mstats;
 typedef struct Mnt	Mnt;
 typedef struct Mhead	Mhead;
 typedef struct Note	Note;
@@ -30,9 +32,11 @@ typedef struct PhysUart	PhysUart;
 typedef struct Pgrp	Pgrp;
 typedef struct Physseg	Physseg;
 typedef struct Proc	Proc;
+typedef struct Pstats	Pstats;
 typedef struct Pte	Pte;
 typedef struct QLock	QLock;
 typedef struct Queue	Queue;
+typedef struct Rbpool	Rbpool;
 typedef struct Ref	Ref;
 typedef struct Rendez	Rendez;
 typedef struct Rgrp	Rgrp;
@@ -41,8 +45,11 @@ typedef struct Sargs	Sargs;
 typedef struct Schedq	Schedq;
 typedef struct Segment	Segment;
 typedef struct Sema	Sema;
+typedef struct Sleepq	Sleepq;
+typedef struct Sqent	Sqent;
 typedef struct Timer	Timer;
 typedef struct Timers	Timers;
+typedef struct Tracerec	Tracerec;
 typedef struct Uart	Uart;
 typedef struct Waitq	Waitq;
 typedef struct Walkqid	Walkqid;
@@ -102,12 +109,21 @@ struct Rendez
 	Proc	*p;
 };
 
+struct Sleepq			/* any number of sleepers; see proc.c */
+{
+	Lock;
+	Sqent	*head;		/* shared waiters first, then exclusive */
+	Sqent	*tail;
+};
+
 struct QLock
 {
 	Lock	use;		/* to access Qlock structure */
 	Proc	*head;		/* next process waiting for object */
 	Proc	*tail;		/* last process waiting for object */
 	int	locked;		/* flag */
+	Proc	*owner;		/* holder, if locked */
+	int	pi;		/* holder inherits waiters' priority */
 };
 
 struct RWlock
@@ -119,6 +135,7 @@ struct RWlock
 	Proc	*wproc;		/* writing proc */
 	int	readers;	/* number of readers */
 	int	writer;		/* number of writers */
+	int	pi;		/* writer inherits waiters' priority */
 };
 
 struct Alarms
@@ -175,6 +192,7 @@ struct Block
 	uchar*	lim;			/* 1 past the end of the buffer */
 	uchar*	base;			/* start of the buffer */
 	void	(*free)(Block*);
+	Rbpool*	pool;			/* receive pool the Block returns to */
 	ushort	flag;
 	ushort	checksum;		/* IP checksum of complete packet (minus media header) */
 };
@@ -182,6 +200,24 @@ struct Block
 #define BLEN(s)	((s)->wp - (s)->rp)
 #define BALLOC(s) ((s)->lim - (s)->base)
 
+/*
+ *  receive buffers of one size shared by network drivers; see rbpool.c
+ */
+struct Rbpool
+{
+	Lock;
+	Rbpool*	next;
+	int	size;			/* bytes, from a page boundary */
+	Block*	head;			/* shared free list */
+	int	nfree;
+	int	nblock;			/* Blocks made */
+	int	limit;			/* most Blocks to make */
+	struct {
+		Block*	head;
+		int	n;
+	} stash[MAXMACH];		/* each processor's own; used splhi */
+};
+
 struct Chan
 {
 	Ref;				/* the Lock in this Ref is also Chan's lock */
@@ -224,9 +260,8 @@ struct Path
 	char	*s;
 	Chan	**mtpt;			/* mtpt history */
 	int	len;			/* strlen(s) */
-	int	alen;			/* allocated length of s */
 	int	mlen;			/* number of path elements */
-	int	malen;			/* allocated length of mtpt */
+	int	incache;		/* slot+1 in the path cache */
 };
 
 struct Dev
@@ -254,6 +289,9 @@ struct Dev
 
 	/* not initialised */
 	int	attached;				/* debugging */
+	int	pending;		/* reset and init left to a kproc */
+	QLock	readyq;			/* one waiter at a time sleeps on ready */
+	Rendez	ready;
 };
 
 struct Dirtab
@@ -313,6 +351,7 @@ struct Mnt
 	Chan	*c;		/* Channel to file service */
 	Proc	*rip;		/* Reader in progress */
 	Mntrpc	*queue;		/* Queue of pending requests on this channel */
+	Sleepq	gate;		/* procs waiting to become rip */
 	ulong	id;		/* Multiplexer id for channel check */
 	Mnt	*list;		/* Free list */
 	int	flags;		/* cache */
@@ -540,8 +579,7 @@ struct Palloc
 	ulong	user;			/* how many user pages */
 	Page	*hash[PGHSIZE];
 	Lock	hashlock;
-	Rendez	r;			/* Sleep for free mem */
-	QLock	pwait;			/* Queue of procs waiting for memory */
+	Sleepq	pwait;			/* Queue of procs waiting for memory */
 };
 
 struct Waitq
@@ -613,6 +651,7 @@ enum
 	Stopped,
 	Rendezvous,
 	Waitrelease,
+	Nstates,
 
 	Proc_stopme = 1, 	/* devproc requests */
 	Proc_exitme,
@@ -688,6 +727,36 @@ struct Schedq
 	int	n;
 };
 
+enum
+{
+	Nstatsys	= 64,		/* syscall numbers counted in Pstats */
+	Nstatdev	= 64,		/* devtab entries counted in Mstats */
+};
+
+/*
+ *  event counters kept per process and per processor.
+ *  each is written only by its owner, the process or the
+ *  processor it runs on, without locks; #p/n/stats and
+ *  #p/cpustats return them as binary snapshots.
+ */
+struct Pstats
+{
+	ulong	vcsw;			/* context switches: blocked */
+	ulong	icsw;			/* context switches: preempted or yielded */
+	ulong	faults;
+	ulong	syscalls[Nstatsys];	/* by number */
+	uvlong	rbytes;			/* by read and pread */
+	uvlong	wbytes;			/* by write and pwrite */
+	ulong	waitticks[Nstates];	/* time blocked, by state */
+};
+
+struct Mstats
+{
+	Pstats;
+	uvlong	devrbytes[Nstatdev];	/* by devtab index */
+	uvlong	devwbytes[Nstatdev];
+};
+
 struct Proc
 {
 	Label	sched;		/* known to l.s */
@@ -702,6 +771,10 @@ struct Proc
 	QLock	*qlock;		/* addr of qlock being queued for DEBUG */
 	int	state;
 	char	*psstate;	/* What /proc/#/status reports */
+	ulong	statgen;	/* tick of last change visible in /proc/status */
+	Pstats	stats;
+	int	blockstate;	/* state blocked in, for stats.waitticks */
+	ulong	blocktime;	/* tick it blocked at */
 	Segment	*seg[NSEG];
 	QLock	seglock;	/* locked whenever seg[] changes */
 	ulong	pid;
@@ -751,6 +824,7 @@ struct Proc
 	Lock	rlock;		/* sync sleep/wakeup with postnote */
 	Rendez	*r;		/* rendezvous point slept on */
 	Rendez	sleep;		/* place for syssleep/debug */
+	Rendez	sqr;		/* place for Sleepq waits */
 	int	notepending;	/* note issued but not acted on */
 	int	kp;		/* true if a kernel process */
 	Proc	*palarm;	/* Next alarm time */
@@ -797,6 +871,8 @@ struct Proc
 	ulong	delaysched;
 	ulong	priority;	/* priority level */
 	ulong	basepri;	/* base priority level */
+	ulong	inhpri;		/* priority inherited through pi locks */
+	int	pilocks;	/* number of pi locks held */
 	uchar	fixedpri;	/* priority level deson't change */
 	ulong	cpu;		/* cpu average */
 	ulong	lastupdate;
@@ -854,6 +930,7 @@ extern	Queue*	kbdq;
 extern	Queue*	kprintoq;
 extern 	Ref	noteidalloc;
 extern	int	nsyscall;
+extern	Mstats	mstats[MAXMACH];
 extern	Palloc	palloc;
 extern	Queue*	serialoq;
 extern	char*	statename[];
@@ -861,6 +938,7 @@ extern	Image	swapimage;
 extern	char*	sysname;
 extern	uint	qiomaxatomic;
 extern	char*	sysctab[];
+extern	ulong	tracepts;
 
 	Watchdog*watchdog;
 	int	watchdogon;
@@ -894,6 +972,47 @@ struct Logflag {
 	int	mask;
 };
 
+/*
+ *  one processor's log ring; see logring.c
+ */
+struct Logring {
+	char*	buf;
+	ulong	size;		/* a power of 2 */
+	ulong	head;		/* where the next record goes */
+	ulong	tail;		/* oldest record */
+};
+
+/*
+ *  trace points; see devtrace.c.
+ *  TRACEPT costs a load and a test while tp is off.
+ */
+enum
+{
+	TPqput,			/* a queue, b bytes */
+	TPqget,			/* a queue, b bytes */
+	TPmntrpc,		/* a chan, b tag, c type */
+	TPmntreply,		/* a chan, b tag, c type */
+	TPtcpstate,		/* a tcb, b old state, c new */
+	TPtcprexmit,		/* a tcb, b seq, c bytes */
+	TPfault,		/* a va, b read, c 1 when done */
+	TPsdio,			/* a lba, b write<<31|idno<<8|subno, c sectors */
+	TPsddone,		/* a lba, b as TPsdio, c sectors done, 0 on error */
+	NTracept,
+};
+
+struct Tracerec {
+	uvlong	ts;		/* fastticks */
+	uvlong	a;
+	ulong	b;
+	ulong	c;
+	ulong	pid;
+	uchar	tp;
+	uchar	machno;
+	ushort	pad;
+};
+
+#define	TRACEPT(tp, a, b, c)	(tracepts & 1<<(tp)? tracepoint(tp, a, b, c): (void)0)
+
 enum
 {
 	NCMDFIELD = 128
@@ -71,6 +71,7 @@ Chan*		devopen(Chan*, int, Dirtab*, int, Devgen*);
 void		devpermcheck(char*, ulong, int);
 void		devpower(int);
 void		devremove(Chan*);
+void		devready(Dev*);
 void		devreset(void);
 void		devshutdown(void);
 int		devstat(Chan*, uchar*, int, Dirtab*, int, Devgen*);
@@ -84,11 +85,14 @@ void		dumpstack(void);
 Fgrp*		dupfgrp(Fgrp*);
 int		duppage(Page*);
 void		dupswap(Page*);
+int		edfanyready(void);
 void		edfinit(Proc*);
 char*		edfadmit(Proc*);
+int		edfnready(void);
 int		edfready(Proc*);
 void		edfrecord(Proc*);
 void		edfrun(Proc*, int);
+Proc*		edfrunproc(void);
 void		edfstop(Proc*);
 void		edfyield(void);
 int		emptystr(char*);
@@ -159,6 +163,9 @@ int		lock(Lock*);
 void		logopen(Log*);
 void		logclose(Log*);
 char*		logctl(Log*, int, char**, Logflag*);
+void		logringinit(void);
+void		logringput(Logring*, char*, int);
+long		logringread(Logring*, int, ulong*, char*, long);
 void		logn(Log*, int, void*, int);
 long		logread(Log*, void*, ulong, long);
 void		log(Log*, int, char*, ...);
@@ -226,7 +233,10 @@ int		preempted(void);
 void		prflush(void);
 void		printinit(void);
 ulong		procalarm(ulong);
+void		procblock(Proc*, int);
 void		procctl(Proc*);
+void		procdisinherit(Proc*);
+void		procinherit(Proc*, Proc*);
 void		procdump(void);
 int		procfdprint(Chan*, int, int, char*, int);
 int		procindex(ulong);
@@ -283,6 +293,9 @@ void		qnoblock(Queue*, int);
 int		rand(void);
 void		randominit(void);
 ulong		randomread(void*, ulong);
+Block*		rbpoolalloc(Rbpool*);
+Rbpool*		rbpoolget(int, int);
+void		rbpoolshrink(Rbpool*, int);
 void		rdb(void);
 int		readnum(ulong, char*, ulong, ulong, int);
 int		readstr(ulong, char*, ulong, char*);
@@ -327,12 +340,17 @@ void		setregisters(Ureg*, char*, char*, int);
 void		setswapchan(Chan*);
 char*		skipslash(char*);
 void		sleep(Rendez*, int(*)(void*), void*);
+void		sqsleep(Sleepq*, Rendez*, int(*)(void*), void*, int);
+void		sqtsleep(Sleepq*, Rendez*, int(*)(void*), void*, int, ulong);
+Proc*		sqwakeup(Sleepq*);
+int		sqwakeupall(Sleepq*);
 void*		smalloc(ulong);
 int		splhi(void);
 int		spllo(void);
 void		splx(int);
 void		splxpc(int);
 char*		srvname(Chan*);
+void		statsyscall(ulong);
 int		swapcount(ulong);
 int		swapfull(void);
 void		swapinit(void);
@@ -348,6 +366,7 @@ vlong		todget(vlong*);
 void		todsetfreq(vlong);
 void		todinit(void);
 void		todset(vlong, vlong, int);
+void		(*tracepoint)(int, uvlong, ulong, ulong);
 Block*		trimblock(Block*, int, int);
 void		tsleep(Rendez*, int (*)(void*), void*, ulong);
 int		uartctl(Uart*, char*);
@@ -14,6 +14,8 @@ Ref	noteidalloc;
 void updatecpu(Proc*);
 int reprioritize(Proc*);
 
+Mstats	mstats[MAXMACH];
+
 ulong	delayedscheds;	/* statistics */
 long skipscheds;
 long preempts;
@@ -24,17 +26,50 @@ static Ref	pidalloc;
 static struct Procalloc
 {
 	Lock;
-	Proc*	ht[128];
 	Proc*	arena;
 	Proc*	free;
 } procalloc;
 
+/*
+ *  pid hash, sized from conf.nproc so that
+ *  procindex is a short chain walk.
+ */
+static struct Pidtab
+{
+	Lock;
+	Proc**	ht;
+	ulong	mask;
+} pidtab;
+
 enum
 {
 	Q=10,
 	DQ=4,
 	Scaling=2,
+
+	Npcache=16,	/* free procs kept per processor */
+	Npidbatch=32,	/* pids handed to a processor at once */
+};
+
+/*
+ *  per-processor caches of free Procs, which keep their
+ *  kernel stacks, and of unused pids.  newproc and
+ *  schedinit go to procalloc only when a cache runs dry
+ *  or overflows, and then move Npcache/2 procs at once.
+ *  the lock is only contended when another processor
+ *  steals from an idle cache because procalloc is empty.
+ *  pid and npid are touched splhi by the owner only.
+ */
+typedef struct Proccache Proccache;
+struct Proccache
+{
+	Lock;
+	Proc*	free;
+	int	nfree;
+	ulong	pid;
+	ulong	npid;
 };
+static Proccache proccache[MAXMACH];
 
 Schedq	runq[Nrq];
 ulong	runvec;
@@ -58,6 +93,9 @@ char *statename[] =
 
 static void pidhash(Proc*);
 static void pidunhash(Proc*);
+static ulong pidget(void);
+static Proc* procfreeget(void);
+static void procfreeput(Proc*);
 static void rebalance(void);
 
 /*
@@ -67,9 +105,24 @@ void
 schedinit(void)		/* never returns */
 {
 	Edf *e;
+	Mstats *ms;
 
 	setlabel(&m->sched);
 	if(up) {
+		up->statgen = MACHP(0)->ticks;
+		ms = &mstats[m->machno];
+		switch(up->state){
+		case Running:
+			up->stats.icsw++;
+			ms->icsw++;
+			break;
+		case Moribund:
+			break;
+		default:
+			up->stats.vcsw++;
+			ms->vcsw++;
+			break;
+		}
 		if((e = up->edf) && (e->flags & Admitted))
 			edfrecord(up);
 		m->proc = 0;
@@ -86,16 +139,12 @@ schedinit(void)		/* never returns */
 
 			/*
 			 * Holding locks from pexit:
-			 * 	procalloc
 			 *	palloc
 			 */
 			mmurelease(up);
-
-			up->qnext = procalloc.free;
-			procalloc.free = up;
-
 			unlock(&palloc);
-			unlock(&procalloc);
+
+			procfreeput(up);
 			break;
 		}
 		up->mach = nil;
@@ -170,6 +219,8 @@ sched(void)
 	m->readied = 0;
 	up = p;
 	up->state = Running;
+	up->statgen = MACHP(0)->ticks;
+	up->blockstate = 0;
 	up->mach = MACHP(m->machno);
 	m->proc = up;
 	mmuswitch(up);
@@ -179,13 +230,14 @@ sched(void)
 int
 anyready(void)
 {
-	return runvec;
+	return runvec || edfanyready();
 }
 
 int
 anyhigher(void)
 {
-	return runvec & ~((1<<(up->priority+1))-1);
+	return runvec & ~((1<<(up->priority+1))-1)
+		|| up->priority < PriEdf && edfanyready();
 }
 
 /*
@@ -312,8 +364,11 @@ reprioritize(Proc *p)
 	int fairshare, n, load, ratio;
 
 	load = MACHP(0)->load;
-	if(load == 0)
+	if(load == 0){
+		if(p->inhpri > p->basepri)
+			return p->inhpri;
 		return p->basepri;
+	}
 
 	/*
 	 *  fairshare = 1.000 * conf.nproc * 1.000/load,
@@ -329,6 +384,8 @@ reprioritize(Proc *p)
 		ratio = p->basepri;
 	if(ratio < 0)
 		panic("reprioritize");
+	if(p->inhpri > ratio)
+		ratio = p->inhpri;
 //iprint("pid %d cpu %d load %d fair %d pri %d\n", p->pid, p->cpu, load, fairshare, ratio);
 	return ratio;
 }
@@ -402,6 +459,21 @@ dequeueproc(Schedq *rq, Proc *tp)
 	return p;
 }
 
+/*
+ *  p is about to block in state: note why and since when for
+ *  stats.waitticks, then change state.  the notes are written
+ *  before the new state can be seen, so the ready() that ends
+ *  the wait, on whatever processor, finds them.
+ */
+void
+procblock(Proc *p, int state)
+{
+	p->blockstate = state;
+	p->blocktime = MACHP(0)->ticks;
+	coherence();
+	p->state = state;
+}
+
 /*
  *  ready(p) picks a new priority for a process and sticks it in the
  *  runq for that priority.
@@ -412,8 +484,15 @@ ready(Proc *p)
 	int s, pri;
 	Schedq *rq;
 	void (*pt)(Proc*, int, vlong);
+	ulong t;
 
 	s = splhi();
+	if(p->blockstate){
+		t = MACHP(0)->ticks - p->blocktime;
+		p->stats.waitticks[p->blockstate] += t;
+		mstats[m->machno].waitticks[p->blockstate] += t;
+		p->blockstate = 0;
+	}
 	if(edfready(p)){
 		splx(s);
 		return;
@@ -433,6 +512,7 @@ ready(Proc *p)
 	p->priority = pri;
 	rq = &runq[pri];
 	p->state = Ready;
+	p->statgen = MACHP(0)->ticks;
 	queueproc(rq, p);
 	
 	/* Also add to cognitive scheduler if enabled */
@@ -522,7 +602,7 @@ runproc(void)
 
 	/* cooperative scheduling until the clock ticks */
 	if((p=m->readied) && p->mach==0 && p->state==Ready
-	&& runq[Nrq-1].head == nil && runq[Nrq-2].head == nil){
+	&& p->priority != PriEdf && !edfanyready() && runq[PriRelease].head == nil){
 		skipscheds++;
 		rq = &runq[p->priority];
 		goto found;
@@ -538,6 +618,17 @@ loop:
 	 */
 	spllo();
 	for(i = 0;; i++){
+		/*
+		 *  released edf procs partitioned onto this
+		 *  processor come first, earliest deadline first.
+		 */
+		splhi();
+		if((p = edfrunproc()) != nil){
+			rq = &runq[PriEdf];
+			goto edffound;
+		}
+		spllo();
+
 		/*
 		 *  find the highest priority target process that this
 		 *  processor can run given affinity constraints.
@@ -566,6 +657,7 @@ found:
 	if(p == nil)
 		goto loop;
 
+edffound:
 	p->state = Scheding;
 	p->mp = MACHP(m->machno);
 
@@ -603,22 +695,15 @@ newproc(void)
 	char msg[64];
 	Proc *p;
 
-	lock(&procalloc);
-	for(;;) {
-		if(p = procalloc.free)
-			break;
-
+	while((p = procfreeget()) == nil){
 		snprint(msg, sizeof msg, "no procs; %s forking",
 			up? up->text: "kernel");
-		unlock(&procalloc);
 		resrcwait(msg);
-		lock(&procalloc);
 	}
-	procalloc.free = p->qnext;
-	unlock(&procalloc);
 
 	p->state = Scheding;
 	p->psstate = "New";
+	p->statgen = MACHP(0)->ticks;
 	p->mach = 0;
 	p->qnext = 0;
 	p->nchild = 0;
@@ -648,13 +733,15 @@ newproc(void)
 	p->nlocks.ref = 0;
 	p->delaysched = 0;
 	p->trace = 0;
+	memset(&p->stats, 0, sizeof p->stats);
+	p->blockstate = 0;
 	kstrdup(&p->user, "*nouser");
 	kstrdup(&p->text, "*notext");
 	kstrdup(&p->args, "");
 	p->nargs = 0;
 	p->setargs = 0;
 	memset(p->seg, 0, sizeof p->seg);
-	p->pid = incref(&pidalloc);
+	p->pid = pidget();
 	pidhash(p);
 	p->noteid = incref(&noteidalloc);
 	if(p->pid==0 || p->noteid==0)
@@ -666,6 +753,8 @@ newproc(void)
 	p->mp = 0;
 	p->wired = 0;
 	procpriority(p, PriNormal, 0);
+	p->inhpri = 0;
+	p->pilocks = 0;
 	p->cpu = 0;
 	p->lastupdate = MACHP(0)->ticks*Scaling;
 	p->edf = nil;
@@ -736,6 +825,7 @@ procinit0(void)		/* bad planning - clashes with devproc.c */
 {
 	Proc *p;
 	int i;
+	ulong n;
 
 	procalloc.free = xalloc(conf.nproc*sizeof(Proc));
 	if(procalloc.free == nil){
@@ -748,11 +838,64 @@ procinit0(void)		/* bad planning - clashes with devproc.c */
 	for(i=0; i<conf.nproc-1; i++,p++)
 		p->qnext = p+1;
 	p->qnext = 0;
+
+	for(n = 1; n < conf.nproc; n <<= 1)
+		;
+	pidtab.ht = xalloc(n*sizeof(Proc*));
+	if(pidtab.ht == nil)
+		panic("procinit0: no memory for pid hash");
+	pidtab.mask = n-1;
 	
 	/* Initialize cognitive scheduler */
 	coginit();
 }
 
+/*
+ *  priority inheritance for QLocks and RWlocks with pi set:
+ *  while w waits for a lock p holds, p runs at no less than
+ *  w's priority (PriExtra if w is an edf proc), until p has
+ *  released all its pi locks.  reprioritize honours inhpri;
+ *  here we only move p if it is already in a run queue.
+ *  only the direct holder is boosted, not whoever it is
+ *  itself waiting for.
+ */
+void
+procinherit(Proc *p, Proc *w)
+{
+	int pri, s;
+	Schedq *rq;
+
+	if(p == nil || p->edf)
+		return;
+	pri = w->edf? PriExtra: w->priority;
+	if(pri >= Npriq)
+		pri = Npriq-1;
+	if(pri <= p->inhpri)
+		return;
+	p->inhpri = pri;
+	if(pri <= p->priority)
+		return;
+	s = splhi();
+	if(p->state == Ready){
+		rq = &runq[p->priority];
+		if(dequeueproc(rq, p) != nil)
+			queueproc(&runq[pri], p);
+	}else if(p->state != Scheding)
+		p->priority = pri;
+	splx(s);
+}
+
+/*
+ *  called when p releases its last pi lock
+ */
+void
+procdisinherit(Proc *p)
+{
+	p->inhpri = 0;
+	if(p == up && p->edf == nil)
+		p->priority = reprioritize(p);
+}
+
 /*
  *  sleep if a condition is not true.  Another process will
  *  awaken us after it sets the condition.  When we awaken
@@ -803,7 +946,7 @@ sleep(Rendez *r, int (*f)(void*), void *arg)
 		pt = proctrace;
 		if(pt)
 			pt(up, SSleep, 0);
-		up->state = Wakeme;
+		procblock(up, Wakeme);
 		up->r = r;
 
 		/* statistics */
@@ -917,6 +1060,153 @@ wakeup(Rendez *r)
 	return p;
 }
 
+/*
+ *  A Sleepq holds any number of sleepers on one event, for
+ *  places where a Rendez's single sleeper would otherwise
+ *  force waiters through a QLock first.  Each waiter sleeps
+ *  on a Rendez of its own (usually up->sqr), so code that
+ *  knows a particular waiter can still wake it directly.
+ *  Exclusive waiters queue after shared ones: sqwakeup wakes
+ *  every shared waiter and then exclusive waiters until one
+ *  that was actually asleep has been woken; sqwakeupall
+ *  wakes them all.  As with wakeup, the condition must be
+ *  made true before waking.  Only waiters wakeup found asleep
+ *  are taken off the queue: one that hasn't reached sleep yet
+ *  stays queued, so if the condition is false again by the
+ *  time it sleeps, a later wakeup still finds it.
+ *
+ *  Entries live on the waiter's stack.  Wakers touch them
+ *  only under the Sleepq's ilock, and a waiter unlinks its
+ *  own entry under the same lock before returning, so a
+ *  Sleepq lock is taken before a Rendez's, never after.
+ */
+struct Sqent
+{
+	Sqent	*next;
+	Sqent	*prev;
+	Rendez	*r;
+	int	excl;
+	int	queued;
+};
+
+static void
+squnlink(Sleepq *q, Sqent *e)
+{
+	if(e->prev != nil)
+		e->prev->next = e->next;
+	else
+		q->head = e->next;
+	if(e->next != nil)
+		e->next->prev = e->prev;
+	else
+		q->tail = e->prev;
+	e->queued = 0;
+}
+
+static void
+sqwait(Sleepq *q, Rendez *r, int (*f)(void*), void *arg, int excl, ulong ms)
+{
+	Sqent e, *x;
+
+	e.r = r;
+	e.excl = excl;
+	e.queued = 1;
+	ilock(q);
+	if(excl){
+		e.next = nil;
+		e.prev = q->tail;
+	}else{
+		/* ahead of the first exclusive waiter */
+		for(x = q->head; x != nil && !x->excl; x = x->next)
+			;
+		e.next = x;
+		e.prev = x != nil? x->prev: q->tail;
+	}
+	if(e.prev != nil)
+		e.prev->next = &e;
+	else
+		q->head = &e;
+	if(e.next != nil)
+		e.next->prev = &e;
+	else
+		q->tail = &e;
+	iunlock(q);
+
+	if(waserror()){
+		ilock(q);
+		if(e.queued)
+			squnlink(q, &e);
+		iunlock(q);
+		nexterror();
+	}
+	if(ms != 0)
+		tsleep(r, f, arg, ms);
+	else
+		sleep(r, f, arg);
+	poperror();
+
+	ilock(q);
+	if(e.queued)
+		squnlink(q, &e);
+	iunlock(q);
+}
+
+void
+sqsleep(Sleepq *q, Rendez *r, int (*f)(void*), void *arg, int excl)
+{
+	sqwait(q, r, f, arg, excl, 0);
+}
+
+void
+sqtsleep(Sleepq *q, Rendez *r, int (*f)(void*), void *arg, int excl, ulong ms)
+{
+	sqwait(q, r, f, arg, excl, ms);
+}
+
+/*
+ *  returns the first process woken, as wakeup does
+ */
+Proc*
+sqwakeup(Sleepq *q)
+{
+	Sqent *e, *n;
+	Proc *p, *first;
+
+	first = nil;
+	ilock(q);
+	for(e = q->head; e != nil; e = n){
+		n = e->next;
+		if((p = wakeup(e->r)) == nil)
+			continue;
+		squnlink(q, e);
+		if(first == nil)
+			first = p;
+		if(e->excl)
+			break;
+	}
+	iunlock(q);
+	return first;
+}
+
+int
+sqwakeupall(Sleepq *q)
+{
+	Sqent *e, *next;
+	int n;
+
+	n = 0;
+	ilock(q);
+	for(e = q->head; e != nil; e = next){
+		next = e->next;
+		if(wakeup(e->r) != nil){
+			squnlink(q, e);
+			n++;
+		}
+	}
+	iunlock(q);
+	return n;
+}
+
 /*
  *  if waking a sleeping process, this routine must hold both
  *  p->rlock and r->lock.  However, it can't know them in
@@ -1021,7 +1311,7 @@ addbroken(Proc *p)
 	qunlock(&broken);
 
 	edfstop(up);
-	p->state = Broken;
+	procblock(p, Broken);
 	p->psstate = 0;
 	sched();
 }
@@ -1196,8 +1486,7 @@ pexit(char *exitstr, int freemem)
 	}
 	qunlock(&up->debug);
 
-	/* Sched must not loop for these locks */
-	lock(&procalloc);
+	/* Sched must not loop for this lock */
 	lock(&palloc);
 
 	edfstop(up);
@@ -1360,7 +1649,7 @@ scheddump(void)
 		print("\n");
 		delay(150);
 	}
-	print("nrdy %d\n", nrdy);
+	print("nrdy %d edf %d\n", nrdy, edfnready());
 }
 
 void
@@ -1452,7 +1741,7 @@ procctl(Proc *p)
 		}
 		qunlock(&p->debug);
 		splhi();
-		p->state = Stopped;
+		procblock(p, Stopped);
 		sched();
 		p->psstate = state;
 		splx(s);
@@ -1561,6 +1850,7 @@ accounttime(void)
 	if(p) {
 		nrun++;
 		p->time[p->insyscall]++;
+		p->statgen = MACHP(0)->ticks;
 	}
 
 	/* calculate decaying duty cycles */
@@ -1592,53 +1882,177 @@ accounttime(void)
 	 */
 	n = nrun;
 	nrun = 0;
-	n = (nrdy+n)*1000;
+	n = (nrdy+edfnready()+n)*1000;
 	m->load = (m->load*(HZ-1)+n)/HZ;
 }
 
+/*
+ *  take a free proc from this processor's cache, refilling
+ *  it from procalloc in one go, or stealing from another
+ *  processor's cache when procalloc is exhausted.
+ */
+static Proc*
+procfreeget(void)
+{
+	Proc *p;
+	Proccache *pc;
+	int i, s;
+
+	s = splhi();
+	pc = &proccache[m->machno];
+	lock(pc);
+	if(pc->free == nil){
+		lock(&procalloc);
+		for(i = 0; i < Npcache/2 && (p = procalloc.free) != nil; i++){
+			procalloc.free = p->qnext;
+			p->qnext = pc->free;
+			pc->free = p;
+			pc->nfree++;
+		}
+		unlock(&procalloc);
+	}
+	if(p = pc->free){
+		pc->free = p->qnext;
+		pc->nfree--;
+	}
+	unlock(pc);
+	splx(s);
+	if(p != nil)
+		return p;
+
+	for(i = 0; i < conf.nmach; i++){
+		pc = &proccache[i];
+		if(pc->free == nil)
+			continue;
+		s = splhi();
+		lock(pc);
+		if(p = pc->free){
+			pc->free = p->qnext;
+			pc->nfree--;
+		}
+		unlock(pc);
+		splx(s);
+		if(p != nil)
+			return p;
+	}
+	return nil;
+}
+
+/*
+ *  called splhi from schedinit on the processor the
+ *  proc died on.  overflow goes back to procalloc as
+ *  a single chain.
+ */
 static void
-pidhash(Proc *p)
+procfreeput(Proc *p)
 {
-	int h;
+	Proc *h, *t;
+	Proccache *pc;
+	int i;
+
+	pc = &proccache[m->machno];
+	lock(pc);
+	p->qnext = pc->free;
+	pc->free = p;
+	if(++pc->nfree <= Npcache){
+		unlock(pc);
+		return;
+	}
+	h = t = pc->free;
+	for(i = 1; i < Npcache/2; i++)
+		t = t->qnext;
+	pc->free = t->qnext;
+	pc->nfree -= Npcache/2;
+	unlock(pc);
 
-	h = p->pid % nelem(procalloc.ht);
 	lock(&procalloc);
-	p->pidhash = procalloc.ht[h];
-	procalloc.ht[h] = p;
+	t->qnext = procalloc.free;
+	procalloc.free = h;
 	unlock(&procalloc);
 }
 
+/*
+ *  pids come from pidalloc in batches of Npidbatch
+ *  so that forks on different processors don't all
+ *  meet on its lock.
+ */
+static ulong
+pidget(void)
+{
+	Proccache *pc;
+	ulong pid;
+	int s;
+
+	s = splhi();
+	pc = &proccache[m->machno];
+	if(pc->npid == 0){
+		lock(&pidalloc);
+		pc->pid = pidalloc.ref+1;
+		pidalloc.ref += Npidbatch;
+		unlock(&pidalloc);
+		pc->npid = Npidbatch;
+	}
+	pid = pc->pid++;
+	pc->npid--;
+	splx(s);
+	return pid;
+}
+
+/*
+ *  called from each architecture's syscall()
+ */
+void
+statsyscall(ulong scallnr)
+{
+	if(scallnr < Nstatsys){
+		up->stats.syscalls[scallnr]++;
+		mstats[m->machno].syscalls[scallnr]++;
+	}
+}
+
+static void
+pidhash(Proc *p)
+{
+	ulong h;
+
+	h = p->pid & pidtab.mask;
+	lock(&pidtab);
+	p->pidhash = pidtab.ht[h];
+	pidtab.ht[h] = p;
+	unlock(&pidtab);
+}
+
 static void
 pidunhash(Proc *p)
 {
-	int h;
+	ulong h;
 	Proc **l;
 
-	h = p->pid % nelem(procalloc.ht);
-	lock(&procalloc);
-	for(l = &procalloc.ht[h]; *l != nil; l = &(*l)->pidhash)
+	h = p->pid & pidtab.mask;
+	lock(&pidtab);
+	for(l = &pidtab.ht[h]; *l != nil; l = &(*l)->pidhash)
 		if(*l == p){
 			*l = p->pidhash;
 			break;
 		}
-	unlock(&procalloc);
+	unlock(&pidtab);
 }
 
 int
 procindex(ulong pid)
 {
 	Proc *p;
-	int h;
+	ulong h;
 	int s;
 
 	s = -1;
-	h = pid % nelem(procalloc.ht);
-	lock(&procalloc);
-	for(p = procalloc.ht[h]; p != nil; p = p->pidhash)
+	h = pid & pidtab.mask;
+	lock(&pidtab);
+	for(p = pidtab.ht[h]; p != nil; p = p->pidhash)
 		if(p->pid == pid){
 			s = p - procalloc.arena;
 			break;
 		}
-	unlock(&procalloc);
+	unlock(&pidtab);
 	return s;
 }
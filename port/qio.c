@@ -44,7 +44,7 @@ struct Queue
 	QLock	rlock;		/* mutex for reading processes */
 	Rendez	rr;		/* process waiting to read */
 	QLock	wlock;		/* mutex for writing processes */
-	Rendez	wr;		/* process waiting to write */
+	Sleepq	wq;		/* flow controlled writers */
 
 	char	err[ERRMAX];
 };
@@ -422,6 +422,7 @@ qget(Queue *q)
 	q->len -= BALLOC(b);
 	q->dlen -= BLEN(b);
 	QDEBUG checkb(b, "qget");
+	TRACEPT(TPqget, (uintptr)q, BLEN(b), 0);
 
 	/* if writer flow controlled, restart */
 	if((q->state & Qflow) && q->len < q->limit/2){
@@ -433,7 +434,7 @@ qget(Queue *q)
 	iunlock(q);
 
 	if(dowakeup)
-		wakeup(&q->wr);
+		sqwakeup(&q->wq);
 
 	return b;
 }
@@ -486,7 +487,7 @@ qdiscard(Queue *q, int len)
 	iunlock(q);
 
 	if(dowakeup)
-		wakeup(&q->wr);
+		sqwakeup(&q->wq);
 
 	return sofar;
 }
@@ -531,6 +532,7 @@ qconsume(Queue *q, void *vp, int len)
 	consumecnt += n;
 	b->rp += len;
 	q->dlen -= len;
+	TRACEPT(TPqget, (uintptr)q, len, 0);
 
 	/* discard the block if we're done with it */
 	if((q->state & Qmsg) || len == n){
@@ -554,7 +556,7 @@ qconsume(Queue *q, void *vp, int len)
 	iunlock(q);
 
 	if(dowakeup)
-		wakeup(&q->wr);
+		sqwakeup(&q->wq);
 
 	if(tofree != nil)
 		freeblist(tofree);
@@ -599,6 +601,7 @@ qpass(Queue *q, Block *b)
 	q->blast = b;
 	q->len += len;
 	q->dlen += dlen;
+	TRACEPT(TPqput, (uintptr)q, dlen, 0);
 
 	if(q->len >= q->limit/2)
 		q->state |= Qflow;
@@ -647,6 +650,7 @@ qpassnolim(Queue *q, Block *b)
 	q->blast = b;
 	q->len += len;
 	q->dlen += dlen;
+	TRACEPT(TPqput, (uintptr)q, dlen, 0);
 
 	if(q->len >= q->limit/2)
 		q->state |= Qflow;
@@ -724,6 +728,7 @@ qproduce(Queue *q, void *vp, int len)
 	q->len += BALLOC(b);
 	q->dlen += BLEN(b);
 	QDEBUG checkb(b, "qproduce");
+	TRACEPT(TPqput, (uintptr)q, len, 0);
 
 	if(q->state & Qstarve){
 		q->state &= ~Qstarve;
@@ -1004,7 +1009,7 @@ qwakeup_iunlock(Queue *q)
 	if(dowakeup){
 		if(q->kick)
 			q->kick(q->arg);
-		wakeup(&q->wr);
+		sqwakeup(&q->wq);
 	}
 }
 
@@ -1053,6 +1058,7 @@ qbread(Queue *q, int len)
 		}
 		nb->wp = nb->rp + len;
 	}
+	TRACEPT(TPqget, (uintptr)q, BLEN(nb), 0);
 
 	/* restart producer */
 	qwakeup_iunlock(q);
@@ -1139,6 +1145,7 @@ again:
 		else
 			qputback(q, b);
 	}
+	TRACEPT(TPqget, (uintptr)q, n, 0);
 
 	/* restart producer */
 	qwakeup_iunlock(q);
@@ -1213,6 +1220,7 @@ qbwrite(Queue *q, Block *b)
 	q->len += BALLOC(b);
 	q->dlen += n;
 	QDEBUG checkb(b, "qbwrite");
+	TRACEPT(TPqput, (uintptr)q, n, 0);
 	b = nil;
 
 	/* make sure other end gets awakened */
@@ -1254,7 +1262,7 @@ qbwrite(Queue *q, Block *b)
 		ilock(q);
 		q->state |= Qflow;
 		iunlock(q);
-		sleep(&q->wr, qnotfull, q);
+		sqsleep(&q->wq, &up->sqr, qnotfull, q, 0);
 	}
 	USED(b);
 
@@ -1347,6 +1355,7 @@ qiwrite(Queue *q, void *vp, int len)
 		q->blast = b;
 		q->len += BALLOC(b);
 		q->dlen += n;
+		TRACEPT(TPqput, (uintptr)q, n, 0);
 
 		if(q->state & Qstarve){
 			q->state &= ~Qstarve;
@@ -1407,7 +1416,7 @@ qclose(Queue *q)
 
 	/* wake up readers/writers */
 	wakeup(&q->rr);
-	wakeup(&q->wr);
+	sqwakeup(&q->wq);
 }
 
 /*
@@ -1428,7 +1437,7 @@ qhangup(Queue *q, char *msg)
 
 	/* wake up readers/writers */
 	wakeup(&q->rr);
-	wakeup(&q->wr);
+	sqwakeup(&q->wq);
 }
 
 /*
@@ -1524,7 +1533,7 @@ qflush(Queue *q)
 	freeblist(bfirst);
 
 	/* wake up readers/writers */
-	wakeup(&q->wr);
+	sqwakeup(&q->wq);
 }
 
 int
@@ -29,6 +29,9 @@ qlock(QLock *q)
 	rwstats.qlock++;
 	if(!q->locked) {
 		q->locked = 1;
+		q->owner = up;
+		if(q->pi && up != nil)
+			up->pilocks++;
 		unlock(&q->use);
 		return;
 	}
@@ -42,12 +45,35 @@ qlock(QLock *q)
 		p->qnext = up;
 	q->tail = up;
 	up->qnext = 0;
-	up->state = Queueing;
+	if(q->pi)
+		procinherit(q->owner, up);
+	procblock(up, Queueing);
 	up->qpc = getcallerpc(&q);
 	unlock(&q->use);
 	sched();
 }
 
+/*
+ *  the holder of a pi lock is giving it up: drop what
+ *  it inherited if this was its last, and have the next
+ *  holder, if any, inherit from those still waiting.
+ *  called with q->use locked.
+ */
+static void
+pihandoff(Proc *o, Proc *p, Proc *waiters)
+{
+	if(o != nil && --o->pilocks <= 0){
+		o->pilocks = 0;
+		if(o->inhpri)
+			procdisinherit(o);
+	}
+	if(p == nil)
+		return;
+	p->pilocks++;
+	for(; waiters != nil; waiters = waiters->qnext)
+		procinherit(p, waiters);
+}
+
 int
 canqlock(QLock *q)
 {
@@ -58,6 +84,9 @@ canqlock(QLock *q)
 		return 0;
 	}
 	q->locked = 1;
+	q->owner = up;
+	if(q->pi && up != nil)
+		up->pilocks++;
 	unlock(&q->use);
 	return 1;
 }
@@ -76,10 +105,16 @@ qunlock(QLock *q)
 		q->head = p->qnext;
 		if(q->head == 0)
 			q->tail = 0;
+		if(q->pi)
+			pihandoff(q->owner, p, q->head);
+		q->owner = p;
 		unlock(&q->use);
 		ready(p);
 		return;
 	}
+	if(q->pi)
+		pihandoff(q->owner, nil, nil);
+	q->owner = nil;
 	q->locked = 0;
 	unlock(&q->use);
 }
@@ -108,7 +143,9 @@ rlock(RWlock *q)
 		p->qnext = up;
 	q->tail = up;
 	up->qnext = 0;
-	up->state = QueueingR;
+	if(q->pi && q->writer)
+		procinherit(q->wproc, up);
+	procblock(up, QueueingR);
 	unlock(&q->use);
 	sched();
 }
@@ -132,6 +169,9 @@ runlock(RWlock *q)
 	if(q->head == 0)
 		q->tail = 0;
 	q->writer = 1;
+	q->wproc = p;
+	if(q->pi)
+		pihandoff(nil, p, q->head);
 	unlock(&q->use);
 	ready(p);
 }
@@ -148,6 +188,8 @@ wlock(RWlock *q)
 		q->wpc = getcallerpc(&q);
 		q->wproc = up;
 		q->writer = 1;
+		if(q->pi && up != nil)
+			up->pilocks++;
 		unlock(&q->use);
 		return;
 	}
@@ -163,7 +205,9 @@ wlock(RWlock *q)
 		p->qnext = up;
 	q->tail = up;
 	up->qnext = 0;
-	up->state = QueueingW;
+	if(q->pi && q->writer)
+		procinherit(q->wproc, up);
+	procblock(up, QueueingW);
 	unlock(&q->use);
 	sched();
 }
@@ -176,6 +220,8 @@ wunlock(RWlock *q)
 	lock(&q->use);
 	p = q->head;
 	if(p == nil){
+		if(q->pi)
+			pihandoff(q->wproc, nil, nil);
 		q->writer = 0;
 		unlock(&q->use);
 		return;
@@ -185,6 +231,9 @@ wunlock(RWlock *q)
 		q->head = p->qnext;
 		if(q->head == nil)
 			q->tail = nil;
+		if(q->pi)
+			pihandoff(q->wproc, p, q->head);
+		q->wproc = p;
 		unlock(&q->use);
 		ready(p);
 		return;
@@ -192,6 +241,8 @@ wunlock(RWlock *q)
 
 	if(p->state != QueueingR)
 		panic("wunlock");
+	if(q->pi)
+		pihandoff(q->wproc, nil, nil);
 
 	/* waken waiting readers */
 	while(q->head != nil && q->head->state == QueueingR){
@@ -5,36 +5,92 @@
 #include	"fns.h"
 #include	"../port/error.h"
 
+/*
+ *  clock jitter is gathered into a pool and, once there's enough,
+ *  folded into a seed.  each processor runs its own chacha20
+ *  generator keyed from the latest seed, so readers never share
+ *  a lock or wait for the producer once the first seed is made.
+ */
+
+enum
+{
+	Firstseed	= 8,		/* pool bytes before the first seed */
+	Poolsize	= 64,		/* pool bytes for each later one */
+	Reseedblocks	= 256,		/* refills per processor between reseeds */
+};
 
 struct Rb
 {
-	QLock;
 	Rendez	producer;
-	Rendez	consumer;
 	ulong	randomcount;
-	uchar	buf[1024];
-	uchar	*ep;
-	uchar	*rp;
-	uchar	*wp;
 	uchar	next;
-	uchar	wakeme;
 	ushort	bits;
-	ulong	randn;
+
+	u32int	pool[Poolsize/4];
+	int	npool;
+	int	want;			/* a generator would like a new seed */
+
+	u32int	seed[8];
+	ulong	gen;			/* bumped with each new seed */
 } rb;
 
-static int
-rbnotfull(void*)
+typedef struct Crng Crng;
+struct Crng
 {
+	u32int	key[8];
+	uvlong	ctr;
+	ulong	gen;			/* rb.gen last folded into key */
+	int	nblock;			/* refills since */
+	uchar	buf[3*64];
+	int	n;			/* bytes left at the end of buf */
+};
+
+static Crng crng[MAXMACH];
+
+#define ROTL(v, c)	((v)<<(c) | (v)>>(32-(c)))
+#define QR(a, b, c, d)	{ \
+	a += b; d ^= a; d = ROTL(d, 16); \
+	c += d; b ^= c; b = ROTL(b, 12); \
+	a += b; d ^= a; d = ROTL(d, 8); \
+	c += d; b ^= c; b = ROTL(b, 7); }
+
+static void
+chachablock(u32int *out, u32int *key, uvlong ctr, u32int nonce)
+{
+	u32int s[16], x[16];
 	int i;
 
-	i = rb.rp - rb.wp;
-	return i != 1 && i != (1 - sizeof(rb.buf));
+	s[0] = 0x61707865;
+	s[1] = 0x3320646e;
+	s[2] = 0x79622d32;
+	s[3] = 0x6b206574;
+	for(i = 0; i < 8; i++)
+		s[4+i] = key[i];
+	s[12] = ctr;
+	s[13] = ctr>>32;
+	s[14] = nonce;
+	s[15] = 0;
+
+	memmove(x, s, sizeof x);
+	for(i = 0; i < 10; i++){
+		QR(x[0], x[4], x[8], x[12]);
+		QR(x[1], x[5], x[9], x[13]);
+		QR(x[2], x[6], x[10], x[14]);
+		QR(x[3], x[7], x[11], x[15]);
+		QR(x[0], x[5], x[10], x[15]);
+		QR(x[1], x[6], x[11], x[12]);
+		QR(x[2], x[7], x[8], x[13]);
+		QR(x[3], x[4], x[9], x[14]);
+	}
+	for(i = 0; i < 16; i++)
+		out[i] = x[i] + s[i];
+	memset(x, 0, sizeof x);
 }
 
 static int
-rbnotempty(void*)
+rbwanted(void*)
 {
-	return rb.wp != rb.rp;
+	return rb.want;
 }
 
 static void
@@ -49,18 +105,41 @@ genrandom(void*)
 				break;
 		if(anyhigher())
 			sched();
-		if(!rbnotfull(0))
-			sleep(&rb.producer, rbnotfull, 0);
+		if(!rbwanted(0))
+			sleep(&rb.producer, rbwanted, 0);
 	}
 }
 
 /*
- *  produce random bits in a circular buffer
+ *  fold the pool into a new seed.
+ *  the generators read rb.seed without a lock; a torn
+ *  read only mixes in some of the old seed.
+ */
+static void
+reseed(void)
+{
+	u32int b[16], k[8];
+	int i;
+
+	for(i = 0; i < 8; i++)
+		k[i] = rb.seed[i] ^ rb.pool[i];
+	chachablock(b, k, rb.gen, 0);
+	for(i = 0; i < 8; i++)
+		rb.seed[i] ^= b[i] ^ rb.pool[8+i];
+	memset(b, 0, sizeof b);
+	memset(k, 0, sizeof k);
+	memset(rb.pool, 0, sizeof rb.pool);
+	rb.npool = 0;
+	rb.gen++;
+}
+
+/*
+ *  gather random bits in the pool
  */
 static void
 randomclock(void)
 {
-	if(rb.randomcount == 0 || !rbnotfull(0))
+	if(rb.randomcount == 0 || !rb.want)
 		return;
 
 	rb.bits = (rb.bits<<2) ^ rb.randomcount;
@@ -71,14 +150,12 @@ randomclock(void)
 		return;
 	rb.next = 0;
 
-	*rb.wp ^= rb.bits;
-	if(rb.wp+1 == rb.ep)
-		rb.wp = rb.buf;
-	else
-		rb.wp = rb.wp+1;
+	((uchar*)rb.pool)[rb.npool++] ^= rb.bits;
+	if(rb.npool < (rb.gen == 0? Firstseed: Poolsize))
+		return;
 
-	if(rb.wakeme)
-		wakeup(&rb.consumer);
+	reseed();
+	rb.want = 0;
 }
 
 void
@@ -86,54 +163,88 @@ randominit(void)
 {
 	/* Frequency close but not equal to HZ */
 	addclock0link(randomclock, 13);
-	rb.ep = rb.buf + sizeof(rb.buf);
-	rb.rp = rb.wp = rb.buf;
+	rb.want = 1;
 	kproc("genrandom", genrandom, 0);
 }
 
 /*
- *  consume random bytes from a circular buffer
+ *  called splhi on the processor owning c.
+ *  the first block of each refill replaces the key, so a
+ *  later look at the state can't recover earlier output.
+ *  until the first seed, callers that can't wait get output
+ *  keyed from the time, the processor and what's in the pool.
+ */
+static void
+crngrefill(Crng *c)
+{
+	u32int b[16];
+	uvlong t;
+	int i;
+
+	if(rb.gen == 0){
+		t = fastticks(nil);
+		c->key[0] ^= t;
+		c->key[1] ^= t>>32;
+		c->key[2] ^= m->machno;
+		for(i = 3; i < 8; i++)
+			c->key[i] ^= rb.pool[i-3];
+		c->ctr ^= t;
+	}
+	if(c->gen != rb.gen){
+		for(i = 0; i < 8; i++)
+			c->key[i] ^= rb.seed[i];
+		c->ctr ^= fastticks(nil);
+		c->gen = rb.gen;
+		c->nblock = 0;
+	}
+	if(++c->nblock >= Reseedblocks)
+		rb.want = 1;
+
+	chachablock(b, c->key, c->ctr++, m->machno);
+	memmove(c->key, b, sizeof c->key);
+	for(i = 0; i < sizeof c->buf; i += 64)
+		chachablock((u32int*)(c->buf+i), c->key, c->ctr++, m->machno);
+	memset(b, 0, sizeof b);
+	c->n = sizeof c->buf;
+}
+
+/*
+ *  generate random bytes on this processor's generator.
+ *  blocks only until the first seed exists, and not at all
+ *  without a process to block.
  */
 ulong
 randomread(void *xp, ulong n)
 {
-	uchar *e, *p;
-	ulong x;
+	uchar *e, *p, tmp[64];
+	int k, s;
+	Crng *c;
 
-	p = xp;
-
-	if(waserror()){
-		qunlock(&rb);
-		nexterror();
-	}
+	while(rb.gen == 0 && up != nil)
+		tsleep(&up->sleep, return0, 0, 20);
 
-	qlock(&rb);
-	for(e = p + n; p < e; ){
-		if(rb.wp == rb.rp){
-			rb.wakeme = 1;
-			wakeup(&rb.producer);
-			sleep(&rb.consumer, rbnotempty, 0);
-			rb.wakeme = 0;
-			continue;
-		}
-
-		/*
-		 *  beating clocks will be predictable if
-		 *  they are synchronized.  Use a cheap pseudo-
-		 *  random number generator to obscure any cycles.
-		 */
-		x = rb.randn*1103515245 ^ *rb.rp;
-		*p++ = rb.randn = x;
-
-		if(rb.rp+1 == rb.ep)
-			rb.rp = rb.buf;
-		else
-			rb.rp = rb.rp+1;
+	p = xp;
+	for(e = p + n; p < e; p += k){
+		s = splhi();
+		c = &crng[m->machno];
+		if(c->n == 0 || c->gen != rb.gen)
+			crngrefill(c);
+		k = e - p;
+		if(k > c->n)
+			k = c->n;
+		if(k > sizeof tmp)
+			k = sizeof tmp;
+		memmove(tmp, c->buf + sizeof c->buf - c->n, k);
+		memset(c->buf + sizeof c->buf - c->n, 0, k);
+		c->n -= k;
+		splx(s);
+
+		memmove(p, tmp, k);
 	}
-	qunlock(&rb);
-	poperror();
+	memset(tmp, 0, sizeof tmp);
 
-	wakeup(&rb.producer);
+	if(rb.want && rb.producer.p != nil)
+		wakeup(&rb.producer);
 
 	return n;
 }
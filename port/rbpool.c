@@ -0,0 +1,244 @@
+#include	"u.h"
+#include	"../port/lib.h"
+#include	"mem.h"
+#include	"dat.h"
+#include	"fns.h"
+#include	"../port/error.h"
+
+/*
+ *  receive buffer pools.  network drivers wanting buffers of
+ *  the same size share a pool, and freeb returns a pool's Blocks
+ *  to it rather than to malloc.  each processor keeps a stash,
+ *  so the usual alloc and free take no lock; stashes spill to
+ *  and refill from the pool's shared list a batch at a time.
+ *  a Block's data starts on a page boundary.  a pool shrunk below
+ *  the Blocks it has gives the excess back to malloc as they're freed.
+ */
+
+enum
+{
+	Stashmax	= 64,		/* most Blocks in a processor's stash */
+	Stashbatch	= Stashmax/2,	/* moved to or from the shared list */
+};
+
+static struct
+{
+	Lock;
+	Rbpool	*head;
+} rbpools;
+
+static void
+rbpoolfree(Block *b)
+{
+	Rbpool *p;
+	Block *l;
+	int i, s;
+
+	p = b->pool;
+	if(p->nblock > p->limit){
+		ilock(p);
+		if(p->nblock > p->limit){
+			p->nblock--;
+			iunlock(p);
+			b->pool = nil;
+			b->free = nil;
+			_xinc(&b->ref);
+			freeb(b);
+			return;
+		}
+		iunlock(p);
+	}
+	b->rp = b->wp = (uchar*)PGROUND((uintptr)b->base);
+	/* drivers may have pulled lim in; put back allocb's */
+	b->lim = (uchar*)(((uintptr)b + msize(b)) & ~(BLOCKALIGN-1));
+	b->flag &= ~(Bipck | Budpck | Btcpck | Bpktck);
+
+	s = splhi();
+	b->next = p->stash[m->machno].head;
+	p->stash[m->machno].head = b;
+	if(++p->stash[m->machno].n > Stashmax){
+		l = b;
+		for(i = 1; i < Stashbatch; i++)
+			l = l->next;
+		p->stash[m->machno].head = l->next;
+		p->stash[m->machno].n -= Stashbatch;
+		ilock(p);
+		l->next = p->head;
+		p->head = b;
+		p->nfree += Stashbatch;
+		iunlock(p);
+	}
+	splx(s);
+}
+
+/*
+ *  only from a process, since it may allocb
+ */
+static Block*
+rbpoolnew(Rbpool *p)
+{
+	Block *b;
+
+	ilock(p);
+	if(p->nblock >= p->limit){
+		iunlock(p);
+		return nil;
+	}
+	p->nblock++;
+	iunlock(p);
+
+	b = allocb(p->size + BY2PG);
+	b->rp = b->wp = (uchar*)PGROUND((uintptr)b->base);
+	b->pool = p;
+	b->free = rbpoolfree;
+	return b;
+}
+
+Block*
+rbpoolalloc(Rbpool *p)
+{
+	Block *b, *l;
+	int n, s;
+
+	s = splhi();
+	if(p->stash[m->machno].head == nil){
+		ilock(p);
+		if((b = p->head) != nil){
+			for(n = 1, l = b; n < Stashbatch && l->next != nil; n++)
+				l = l->next;
+			p->head = l->next;
+			p->nfree -= n;
+			l->next = nil;
+			p->stash[m->machno].head = b;
+			p->stash[m->machno].n = n;
+		}
+		iunlock(p);
+	}
+	if((b = p->stash[m->machno].head) != nil){
+		p->stash[m->machno].head = b->next;
+		p->stash[m->machno].n--;
+	}
+	splx(s);
+
+	if(b == nil){
+		if(up == nil || !islo())
+			return nil;
+		return rbpoolnew(p);
+	}
+	b->next = nil;
+	_xinc(&b->ref);		/* freeb left it at 0 */
+	return b;
+}
+
+/*
+ *  the pool of size-byte buffers, made with n more Blocks
+ *  and room for as many again to be made as they're needed.
+ */
+Rbpool*
+rbpoolget(int size, int n)
+{
+	Rbpool *p;
+	Block *b;
+
+	lock(&rbpools);
+	for(p = rbpools.head; p != nil; p = p->next)
+		if(p->size == size)
+			break;
+	if(p == nil){
+		p = malloc(sizeof *p);
+		if(p == nil){
+			unlock(&rbpools);
+			error(Enomem);
+		}
+		p->size = size;
+		p->next = rbpools.head;
+		rbpools.head = p;
+	}
+	unlock(&rbpools);
+
+	ilock(p);
+	p->limit += 2*n;
+	iunlock(p);
+	while(n-- > 0){
+		if((b = rbpoolnew(p)) == nil)
+			break;
+		freeb(b);
+	}
+	return p;
+}
+
+/*
+ *  move this processor's stash to the shared list
+ */
+static void
+rbpoolspill(Rbpool *p)
+{
+	Block *b, *l;
+	int n, s;
+
+	s = splhi();
+	if((b = p->stash[m->machno].head) != nil){
+		n = p->stash[m->machno].n;
+		for(l = b; l->next != nil; l = l->next)
+			;
+		p->stash[m->machno].head = nil;
+		p->stash[m->machno].n = 0;
+		ilock(p);
+		l->next = p->head;
+		p->head = b;
+		p->nfree += n;
+		iunlock(p);
+	}
+	splx(s);
+}
+
+/*
+ *  undo rbpoolget(size, n), giving back what's free beyond
+ *  the new limit, stashes included; the rest goes as it's freed.
+ *  only from a process: it visits each processor in turn.
+ */
+void
+rbpoolshrink(Rbpool *p, int n)
+{
+	Block *b, *l;
+	Mach *wm;
+	int i;
+
+	ilock(p);
+	p->limit -= 2*n;
+	iunlock(p);
+
+	wm = up->wired;
+	for(i = 0; i < conf.nmach; i++){
+		if(m->machno != i){
+			procwired(up, i);
+			sched();
+		}
+		rbpoolspill(p);
+	}
+	if(wm != nil)
+		procwired(up, wm->machno);
+	else
+		up->wired = nil;
+	sched();
+
+	l = nil;
+	ilock(p);
+	while(p->nblock > p->limit && (b = p->head) != nil){
+		p->head = b->next;
+		p->nfree--;
+		p->nblock--;
+		b->next = l;
+		l = b;
+	}
+	iunlock(p);
+
+	for(; l != nil; l = b){
+		b = l->next;
+		l->next = nil;
+		l->pool = nil;
+		l->free = nil;
+		_xinc(&l->ref);
+		freeb(l);
+	}
+}
@@ -62,6 +62,7 @@ struct SDev {
 	QLock	unitlock;		/* `Loading' of units */
 	int*	unitflg;		/* Unit flags */
 	SDunit**unit;
+	int	userbuf;		/* bio takes the caller's buffer */
 };
 
 struct SDifc {
@@ -158,6 +159,8 @@ struct SDio {
 	int	(*cmd)(u32int, u32int, u32int*);
 	void	(*iosetup)(int, void*, int, int);
 	void	(*io)(int, uchar*, int);
+	int	autostop;		/* controller ends multi-block transfers */
+	int	userbuf;		/* io can transfer to user addresses */
 };
 
 extern SDio sdio;
@@ -138,6 +138,7 @@ mmcpnp(void)
 	sdev->ctlr = ctl;
 	ctl->dev = sdev;
 	ctl->io = &sdio;
+	sdev->userbuf = sdio.userbuf;
 	return sdev;
 }
 
@@ -281,7 +282,8 @@ mmcbio(SDunit *unit, int lun, int write, void *data, long nb, uvlong bno)
 			ctl->ocr & Ccs? b: b * len, r);
 		io->io(write, buf, nb * len);
 		poperror();
-		io->cmd(STOP_TRANSMISSION, 0, r);
+		if(!io->autostop)
+			io->cmd(STOP_TRANSMISSION, 0, r);
 		poperror();
 		b += nb;
 	}else{
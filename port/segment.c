@@ -72,6 +72,7 @@ newseg(int type, ulong base, ulong size)
 	s->size = size;
 	s->sema.prev = &s->sema;
 	s->sema.next = &s->sema;
+	s->lk.pi = 1;
 
 	mapsize = ROUND(size, PTEPERTAB)/PTEPERTAB;
 	if(mapsize > nelem(s->ssegmap)){
@@ -130,7 +130,7 @@ pager(void *junk)
 
 loop:
 	up->psstate = "Idle";
-	wakeup(&palloc.r);
+	sqwakeupall(&palloc.pwait);
 	sleep(&swapalloc.r, needpages, 0);
 
 	while(needpages(junk)) {
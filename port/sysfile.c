@@ -623,6 +623,31 @@ mountfix(Chan *c, uchar *op, long n, long maxn)
 	return e-op;
 }
 
+/*
+ *  charge n bytes of read or write on c to the
+ *  process and processor counters
+ */
+static void
+statrw(Chan *c, long n, int iswrite)
+{
+	Mstats *ms;
+
+	if(n <= 0)
+		return;
+	ms = &mstats[m->machno];
+	if(iswrite){
+		up->stats.wbytes += n;
+		ms->wbytes += n;
+		if(c->type < Nstatdev)
+			ms->devwbytes[c->type] += n;
+	}else{
+		up->stats.rbytes += n;
+		ms->rbytes += n;
+		if(c->type < Nstatdev)
+			ms->devrbytes[c->type] += n;
+	}
+}
+
 static long
 read(ulong *arg, vlong *offp)
 {
@@ -684,6 +709,7 @@ read(ulong *arg, vlong *offp)
 	c->devoffset += nn;
 	c->offset += nnn;
 	unlock(c);
+	statrw(c, nnn, 0);
 
 	poperror();
 	cclose(c);
@@ -757,6 +783,7 @@ write(ulong *arg, vlong *offp)
 		c->offset -= n - m;
 		unlock(c);
 	}
+	statrw(c, m, 1);
 
 	poperror();
 	cclose(c);
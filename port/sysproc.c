@@ -829,7 +829,7 @@ sysrendezvous(ulong *arg)
 	up->rendval = arg[1];
 	up->rendhash = *l;
 	*l = up;
-	up->state = Rendezvous;
+	procblock(up, Rendezvous);
 	unlock(up->rgrp);
 
 	sched();
@@ -36,6 +36,7 @@ typedef union Ed Ed;
 typedef struct Edpool Edpool;
 typedef struct Itd Itd;
 typedef struct Qio Qio;
+typedef struct Qreq Qreq;
 typedef struct Qtd Qtd;
 typedef struct Sitd Sitd;
 typedef struct Td Td;
@@ -193,6 +194,27 @@ struct Qio
 	char*	err;		/* error string */
 	char*	tag;		/* debug (no room in Qh for this) */
 	ulong	bw;
+	Qreq*	reqs;		/* bulk transfers; the first one runs */
+	int	nbulk;		/* processes waiting in epbulkio */
+};
+
+/*
+ * A bulk transfer.  Any number may be queued on a Qio.
+ * The first is on the controller and, when it completes,
+ * the interrupt handler puts the next one there, so the
+ * endpoint is not idle while the process that issued the
+ * first is woken and comes back for more.
+ */
+struct Qreq
+{
+	Rendez;			/* wait for completion */
+	Qreq*	next;		/* in Qio */
+	Td*	tds;		/* for this transfer */
+	uchar*	data;		/* buffer shared by all the Tds */
+	ulong	load;
+	int	started;	/* Tds given to the controller */
+	int	done;
+	char*	err;		/* error string */
 };
 
 struct Ctlio
@@ -751,30 +773,39 @@ qhcoherency(Ctlr *ctlr)
 	qunlock(&ctlr->portlck);
 }
 
+/*
+ * take qh out of the schedule; the controller may still
+ * be looking at it until qhcoherency.
+ * called with the ctlr ilocked.
+ */
 static void
-qhfree(Ctlr *ctlr, Qh *qh)
+qhunlink(Ctlr *ctlr, Qh *qh)
 {
-	Td *td, *ltd;
 	Qh *q;
 
-	if(qh == nil)
-		return;
-	ilock(ctlr);
 	if(qh->sched < 0){
 		for(q = ctlr->qhs; q != nil; q = q->next)
 			if(q->next == qh)
 				break;
 		if(q == nil)
-			panic("qhfree: nil q");
+			panic("qhunlink: nil q");
 		q->next = qh->next;
 		q->link = qh->link;
 		coherence();
 	}else
 		unschedq(ctlr, qh);
-	iunlock(ctlr);
+}
 
-	qhcoherency(ctlr);
+/*
+ * free a qh unlinked by qhunlink, once the controller is done with it
+ */
+static void
+qhfree(Qh *qh)
+{
+	Td *td, *ltd;
 
+	if(qh == nil)
+		return;
 	for(td = qh->tds; td != nil; td = ltd){
 		ltd = td->next;
 		tdfree(td);
@@ -1432,11 +1463,14 @@ isofsinterrupt(Ctlr *ctlr, Isoio *iso)
 	return 1;
 }
 
+static void qreqretire(Ctlr*, Qh*, Qreq*);
+
 static int
 qhinterrupt(Ctlr *ctlr, Qh *qh)
 {
 	Td *td;
 	int err;
+	char **errp;
 
 	if(qh->state != Qrun)
 		panic("qhinterrupt: qh state");
@@ -1445,15 +1479,19 @@ qhinterrupt(Ctlr *ctlr, Qh *qh)
 		panic("qhinterrupt: no tds");
 	if((td->csw & Tdactive) == 0)
 		ddqprint("qhinterrupt port %#p qh %#p\n", ctlr->capio, qh);
+	if(qh->io->reqs != nil)
+		errp = &qh->io->reqs->err;
+	else
+		errp = &qh->io->err;
 	for(; td != nil; td = td->next){
 		if(td->csw & Tdactive)
 			return 0;
 		err = td->csw & Tderrors;
 		if(err != 0){
-			if(qh->io->err == nil){
-				qh->io->err = errmsg(err);
+			if(*errp == nil){
+				*errp = errmsg(err);
 				dqprint("qhintr: td %#p csw %#lux error %#ux %s\n",
-					td, td->csw, err, qh->io->err);
+					td, td->csw, err, *errp);
 			}
 			break;
 		}
@@ -1470,6 +1508,10 @@ qhinterrupt(Ctlr *ctlr, Qh *qh)
 	for(; td != nil; td = td->next)
 		td->ndata = 0;
 	coherence();
+	if(qh->io->reqs != nil){
+		qreqretire(ctlr, qh, qh->io->reqs);
+		return 1;
+	}
 	qh->state = Qdone;
 	coherence();
 	wakeup(qh->io);
@@ -2410,6 +2452,265 @@ epio(Ep *ep, Qio *io, void *a, long count, int mustlock)
 	return tot;
 }
 
+/*
+ * Bulk requests.  The Tds for a request are built
+ * with provisional toggles and fixed when the request
+ * reaches the controller, since only then is it known
+ * where the previous one left the toggle.
+ * Called with the ctlr ilocked.
+ */
+static void
+qreqstart(Ctlr *ctlr, Qh *qh, Qreq *rq)
+{
+	Qio *io;
+	Td *td;
+	int toggle;
+
+	io = qh->io;
+	toggle = io->toggle;
+	for(td = rq->tds; td != nil; td = td->next){
+		td->csw = (td->csw & ~Tddata1) | toggle;
+		toggle = nexttoggle(toggle, td->ndata, qhmaxpkt(qh));
+	}
+	coherence();
+	rq->started = 1;
+	io->iotime = TK2MS(MACHP(0)->ticks);
+	qh->state = Qrun;
+	coherence();
+	qhlinktd(qh, rq->tds);
+	ctlr->nreqs++;
+	ctlr->load += rq->load;
+}
+
+/*
+ * Fail every request queued on io.
+ * Called with the ctlr ilocked.
+ */
+static void
+qreqfail(Ctlr *ctlr, Qio *io, char *err)
+{
+	Qreq *rq;
+
+	while((rq = io->reqs) != nil){
+		io->reqs = rq->next;
+		if(rq->started){
+			ctlr->load -= rq->load;
+			ctlr->nreqs--;
+			qhlinktd(io->qh, nil);
+		}
+		rq->err = err;
+		rq->done = 1;
+		wakeup(rq);
+	}
+}
+
+/*
+ * The running request rq is finished (or given up):
+ * keep the toggle where it left it and start the next.
+ * After an error the others can't succeed either.
+ * Called with the ctlr ilocked.
+ */
+static void
+qreqretire(Ctlr *ctlr, Qh *qh, Qreq *rq)
+{
+	Qio *io;
+	Td *td;
+
+	io = qh->io;
+	for(td = rq->tds; td != nil; td = td->next){
+		if(td->csw & (Tdhalt|Tdactive))
+			break;
+		io->toggle = td->csw & Tddata1;
+	}
+	io->reqs = rq->next;
+	ctlr->load -= rq->load;
+	ctlr->nreqs--;
+	qhlinktd(qh, nil);
+	if(rq->err != nil)
+		qreqfail(ctlr, io, rq->err);
+	if(io->reqs != nil)
+		qreqstart(ctlr, qh, io->reqs);
+	else
+		qh->state = Qidle;
+	coherence();
+	rq->done = 1;
+	wakeup(rq);
+}
+
+static void
+qreqfree(Qreq *rq)
+{
+	Td *td, *ntd;
+
+	for(td = rq->tds; td != nil; td = ntd){
+		ntd = td->next;
+		tdfree(td);
+	}
+	free(rq->data);
+	free(rq);
+}
+
+static int
+qreqdone(void *a)
+{
+	return ((Qreq*)a)->done;
+}
+
+/*
+ * Bulk I/O.  Unlike epio, the Qio is not held while the
+ * transfer runs: other requests for the endpoint queue
+ * behind this one and go to the controller back to back.
+ * A single buffer serves all the Tds of a request, each
+ * Td covering as much of it as its five pages allow.
+ */
+static long
+epbulkio(Ep *ep, Qio *io, void *a, long count)
+{
+	int i, tmout, timedout;
+	long n, tot;
+	ulong pa;
+	char *err;
+	Ctlr *ctlr;
+	Qh *qh;
+	Qreq *rq, **l;
+	Td *td, *ltd;
+
+	ctlr = ep->hp->aux;
+	io->debug = ep->debug;
+	tmout = ep->tmout;
+	ddeprint("epbulkio: %s ep%d.%d io %#p count %ld load %uld\n",
+		io->tok == Tdtokin ? "in" : "out",
+		ep->dev->nb, ep->nb, io, count, ctlr->load);
+	rq = smalloc(sizeof(Qreq));
+	if(count > 0)
+		rq->data = smalloc(count);
+	if(waserror()){
+		qreqfree(rq);
+		nexterror();
+	}
+	if(io->tok != Tdtokin && count > 0)
+		memmove(rq->data, a, count);
+
+	ltd = nil;
+	tot = 0;
+	do{
+		td = tdalloc();
+		if(ltd == nil)
+			rq->tds = td;
+		else
+			tdlinktd(ltd, td);
+		ltd = td;
+		if(count == 0)
+			td->data = td->sbuff;
+		else
+			td->data = rq->data + tot;
+		pa = PADDR(td->data);
+		n = Tdmaxpkt - (pa & 0xFFF);
+		n -= n % ep->maxpkt;
+		if(n > count - tot)
+			n = count - tot;
+		for(i = 0; i < nelem(td->buffer); i++){
+			td->buffer[i] = pa;
+			if(i > 0)
+				td->buffer[i] &= ~0xFFF;
+			pa += 0x1000;
+		}
+		td->ndata = n;
+		td->csw = Tdactive | io->tok | n << Tdlenshift | Tderr2 | Tderr1;
+		tot += n;
+		rq->load += ep->load;
+	}while(tot < count);
+	ltd->csw |= Tdioc;		/* the last one interrupts */
+	coherence();
+
+	qlock(io);
+	ilock(ctlr);
+	qh = io->qh;
+	if(qh == nil || qh->state == Qclose){	/* Tds released by cancelio */
+		iunlock(ctlr);
+		qunlock(io);
+		error(io->err ? io->err : Eio);
+	}
+	for(l = &io->reqs; *l != nil; l = &(*l)->next)
+		;
+	*l = rq;
+	io->nbulk++;
+	if(qh->state == Qidle)
+		qreqstart(ctlr, qh, rq);
+	iunlock(ctlr);
+	qunlock(io);
+
+	if(ctlr->poll.does)
+		wakeup(&ctlr->poll);
+
+	timedout = 0;
+	if(waserror())
+		timedout = 1;
+	else{
+		if(tmout == 0)
+			sleep(rq, qreqdone, rq);
+		else
+			tsleep(rq, qreqdone, rq, tmout);
+		poperror();
+	}
+
+	ilock(ctlr);
+	/* Are we missing interrupts? */
+	if(!rq->done && rq->started){
+		iunlock(ctlr);
+		ehciintr(ep->hp);
+		ilock(ctlr);
+		if(rq->done){
+			dqprint("ehci %#p: polling required\n", ctlr->capio);
+			ctlr->poll.must = 1;
+			pollcheck(ep->hp);
+		}
+	}
+	if(!rq->done && !timedout)
+		iprint("ehci %#p: io %#p qh %#p timed out (no intr?)\n",
+			ctlr->capio, io, qh);
+	if(!rq->done && !rq->started){
+		for(l = &io->reqs; *l != rq; l = &(*l)->next)
+			;
+		*l = rq->next;
+		rq->err = "request timed out";
+		rq->done = 1;
+	}
+	if(!rq->done){
+		aborttds(qh);
+		iunlock(ctlr);
+		if(!waserror()){
+			tsleep(&up->sleep, return0, 0, Abortdelay);
+			poperror();
+		}
+		ilock(ctlr);
+		if(!rq->done){		/* or cancelio did it */
+			rq->err = "request timed out";
+			qreqretire(ctlr, qh, rq);
+		}
+	}
+	io->nbulk--;
+	iunlock(ctlr);
+
+	tot = 0;
+	for(td = rq->tds; td != nil; td = td->next){
+		if(td->csw & (Tdhalt|Tdactive))
+			break;
+		tot += td->ndata;
+	}
+	err = rq->err;
+	if(err == nil && io->tok == Tdtokin && tot > 0)
+		memmove(a, rq->data, tot);
+	poperror();
+	qreqfree(rq);
+	ddeprint("epbulkio: io %#p: return %ld err '%s'\n", io, tot, err);
+	if(err == Estalled)
+		return 0;	/* that's our convention */
+	if(err != nil)
+		error(err);
+	return tot;
+}
+
 static long
 epread(Ep *ep, void *a, long count)
 {
@@ -2460,7 +2761,7 @@ epread(Ep *ep, void *a, long count)
 		io = ep->aux;
 		if(ep->clrhalt)
 			clrhalt(ep);
-		return epio(ep, &io[OREAD], a, count, 1);
+		return epbulkio(ep, &io[OREAD], a, count);
 	case Tintr:
 		io = ep->aux;
 		delta = TK2MS(MACHP(0)->ticks) - io[OREAD].iotime + 1;
@@ -2592,7 +2893,7 @@ epwrite(Ep *ep, void *a, long count)
 		io = ep->aux;
 		if(ep->clrhalt)
 			clrhalt(ep);
-		return epio(ep, &io[OWRITE], a, count, 1);
+		return epbulkio(ep, &io[OWRITE], a, count);
 	case Tintr:
 		io = ep->aux;
 		delta = TK2MS(MACHP(0)->ticks) - io[OWRITE].iotime + 1;
@@ -2907,17 +3208,31 @@ cancelio(Ctlr *ctlr, Qio *io)
 		qh, qhsname[qh->state]);
 	aborttds(qh);
 	qh->state = Qclose;
+	qhunlink(ctlr, qh);
 	iunlock(ctlr);
+
+	/*
+	 * the controller may be using the tds and their buffers
+	 * until it has let go of the qh: only then can the
+	 * requests fail and their owners free them.
+	 */
+	qhcoherency(ctlr);
 	if(!waserror()){
 		tsleep(&up->sleep, return0, 0, Abortdelay);
 		poperror();
 	}
+	ilock(ctlr);
+	qreqfail(ctlr, io, Eio);
+	iunlock(ctlr);
 	wakeup(io);
+	/* wait for epbulkio callers to let go of io */
+	while(io->nbulk > 0)
+		tsleep(&up->sleep, return0, 0, Abortdelay);
 	qlock(io);
 	/* wait for epio if running */
 	qunlock(io);
 
-	qhfree(ctlr, qh);
+	qhfree(qh);
 	io->qh = nil;
 }
 
@@ -702,6 +702,7 @@ syscall(Ureg* ureg)
 
 	scallnr = ureg->r3;
 	up->scallnr = ureg->r3;
+	statsyscall(ureg->r3);
 	if(scallnr == RFORK && up->fpstate == FPactive){
 		fpsave(&up->fpsave);
 		up->fpstate = FPinactive;
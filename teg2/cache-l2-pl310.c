@@ -5,6 +5,9 @@
  *
  * clean & invalidate (wbinv) is buggy, so we work around erratum 588369
  * by disabling write-back and cache line-fill before, and restoring after.
+ *
+ * the range ops take l2lock and sync once per call, and the vector
+ * versions once for a whole batch of ranges.
  */
 #include "u.h"
 #include "../port/lib.h"
@@ -21,6 +24,11 @@
 enum {
 	L2size		= 1024 * 1024,	/* according to the tegra 2 manual */
 	Wayszgran	= 16 * KiB,	/* granularity of way sizes */
+	/*
+	 * a per-line op is a device register write per 32 bytes;
+	 * past this many bytes, a background op on all ways is quicker.
+	 */
+	Wayopmin	= L2size / 4,
 };
 
 typedef struct L2pl310 L2pl310;
@@ -92,6 +100,9 @@ static ulong waysmask;
 
 static Cacheimpl l2cacheimpl;
 
+void	l2pl310wb(void);
+void	l2pl310wbinv(void);
+
 static void
 awaitbgop(void)
 {
@@ -269,55 +280,121 @@ l2pl310off(void)
 }
 
 
+/*
+ * issue a per-line op for each line of [ava, ava+len).
+ * call with l2lock held; the caller syncs once when it's done.
+ */
 static void
 applyrange(ulong *reg, void *ava, int len)
 {
 	uintptr va, endva;
 
-	if (disallowed || !l2ison)
-		return;
 	if (len < 0)
 		panic("l2cache*se called with negative length");
 	endva = (uintptr)ava + len;
 	for (va = (uintptr)ava & ~(CACHELINESZ-1); va < endva;
 	     va += CACHELINESZ)
 		*reg = PADDR(va);
-	l2pl310sync();
 }
 
-void
-l2pl310invse(void *va, int bytes)
+/*
+ * if start & end addresses are not on cache-line boundaries,
+ * flush first & last cachelines before invalidating.
+ */
+static void
+invrange(L2pl310 *l2p, void *va, int bytes)
 {
 	uintptr start, end;
-	L2pl310 *l2p = L2P;
 
-	/*
-	 * if start & end addresses are not on cache-line boundaries,
-	 * flush first & last cachelines before invalidating.
-	 */
 	start = (uintptr)va;
 	end = start + bytes;
-	getlock();
-	if (start % CACHELINESZ != 0) {
-//		iprint("l2pl310invse: unaligned start %#p from %#p\n", start,
-//			getcallerpc(&va));
+	if (start % CACHELINESZ != 0)
 		applyrange(&l2p->clean.pa, va, 1);
-	}
-	if (end % CACHELINESZ != 0) {
-//		iprint("l2pl310invse: unaligned end %#p from %#p\n", end,
-//			getcallerpc(&va));
+	if (end % CACHELINESZ != 0)
 		applyrange(&l2p->clean.pa, (char *)va + bytes, 1);
+	applyrange(&l2p->inv.pa, va, bytes);
+}
+
+static int
+vecbytes(Cachevec *v, int n)
+{
+	int bytes;
+
+	bytes = 0;
+	while (n-- > 0)
+		bytes += v++->len;
+	return bytes;
+}
+
+/*
+ * there's no invalidate-all that would spare other dirty lines,
+ * so a big invalidate becomes a write-back and invalidate of the lot.
+ */
+void
+l2pl310invse(void *va, int bytes)
+{
+	L2pl310 *l2p = L2P;
+
+	if (disallowed || !l2ison)
+		return;
+	if (bytes >= Wayopmin) {
+		l2pl310wbinv();
+		return;
 	}
+	getlock();
+	invrange(l2p, va, bytes);
+	l2pl310sync();
+	iunlock(&l2lock);
+}
 
-	applyrange(&l2p->inv.pa, va, bytes);
+void
+l2pl310invsev(Cachevec *v, int n)
+{
+	L2pl310 *l2p = L2P;
+
+	if (disallowed || !l2ison || n <= 0)
+		return;
+	if (vecbytes(v, n) >= Wayopmin) {
+		l2pl310wbinv();
+		return;
+	}
+	getlock();
+	for (; n > 0; n--, v++)
+		invrange(l2p, v->va, v->len);
+	l2pl310sync();
 	iunlock(&l2lock);
 }
 
 void
 l2pl310wbse(void *va, int bytes)
 {
+	if (disallowed || !l2ison)
+		return;
+	if (bytes >= Wayopmin) {
+		l2pl310wb();
+		return;
+	}
 	getlock();
 	applyrange(&L2P->clean.pa, va, bytes);
+	l2pl310sync();
+	iunlock(&l2lock);
+}
+
+void
+l2pl310wbsev(Cachevec *v, int n)
+{
+	L2pl310 *l2p = L2P;
+
+	if (disallowed || !l2ison || n <= 0)
+		return;
+	if (vecbytes(v, n) >= Wayopmin) {
+		l2pl310wb();
+		return;
+	}
+	getlock();
+	for (; n > 0; n--, v++)
+		applyrange(&l2p->clean.pa, v->va, v->len);
+	l2pl310sync();
 	iunlock(&l2lock);
 }
 
@@ -331,16 +408,22 @@ l2pl310wbinvse(void *va, int bytes)
 	int odb;
 	L2pl310 *l2p = L2P;
 
-	if (!l2ison)
+	if (disallowed || !l2ison)
+		return;
+	if (bytes >= Wayopmin) {
+		l2pl310wbinv();
 		return;
+	}
 	getlock();
 	applyrange(&l2p->clean.pa, va, bytes);	/* paranoia */
+	l2pl310sync();
 
 	odb = l2p->debug;
 	l2p->debug |= Wt | Nolinefill;		/* erratum workaround */
 	coherence();
 
 	applyrange(&l2p->cleaninv.pa, va, bytes);
+	l2pl310sync();
 
 	l2p->debug = odb;
 	iunlock(&l2lock);
@@ -453,4 +536,7 @@ static Cacheimpl l2cacheimpl = {
 	.invse	= l2pl310invse,
 	.wbse	= l2pl310wbse,
 	.wbinvse= l2pl310wbinvse,
+
+	.invsev	= l2pl310invsev,
+	.wbsev	= l2pl310wbsev,
 };
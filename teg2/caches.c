@@ -7,6 +7,9 @@
  * force cache contents to memory (before dma out or shutdown),
  * ignore cache contents in favour of memory (initialisation, after dma in),
  * both (update page tables and force cpu to read new contents).
+ *
+ * l1 ranges are always done by mva: those ops reach the other cpus'
+ * l1s, set/way ops don't.  the l2 picks whole-way ops for big ranges.
  */
 
 #include "u.h"
@@ -77,6 +80,29 @@ cacheswbinvse(void *va, int bytes)
 	splx(s);
 }
 
+void
+cachesinvsev(Cachevec *v, int n)
+{
+	int i, s;
+
+	s = splhi();
+	l2cache->invsev(v, n);
+	for(i = 0; i < n; i++)
+		cachedinvse(v[i].va, v[i].len);
+	splx(s);
+}
+
+void
+cacheswbsev(Cachevec *v, int n)
+{
+	int i, s;
+
+	s = splhi();
+	for(i = 0; i < n; i++)
+		cachedwbse(v[i].va, v[i].len);
+	l2cache->wbsev(v, n);
+	splx(s);
+}
 
 void
 cachesinv(void)
@@ -124,6 +150,9 @@ static Cacheimpl allcaches = {
 	.invse	= cachesinvse,
 	.wbse	= cacheswbse,
 	.wbinvse= cacheswbinvse,
+
+	.invsev	= cachesinvsev,
+	.wbsev	= cacheswbsev,
 };
 
 
@@ -154,6 +183,11 @@ nullse(void *, int)
 {
 }
 
+void
+nullsev(Cachevec *, int)
+{
+}
+
 static Cacheimpl nullcaches = {
 	.info	= nullinfo,
 	.on	= nullon,
@@ -166,6 +200,9 @@ static Cacheimpl nullcaches = {
 	.invse	= nullse,
 	.wbse	= nullse,
 	.wbinvse= nullse,
+
+	.invsev	= nullsev,
+	.wbsev	= nullsev,
 };
 
 /*
@@ -183,6 +220,20 @@ l1cacheson(void)
 	l1cache = &l1caches;
 }
 
+void
+l1cachesinvsev(Cachevec *v, int n)
+{
+	for(; n > 0; n--, v++)
+		cachedinvse(v->va, v->len);
+}
+
+void
+l1cacheswbsev(Cachevec *v, int n)
+{
+	for(; n > 0; n--, v++)
+		cachedwbse(v->va, v->len);
+}
+
 static Cacheimpl l1caches = {
 	.info	= l1cachesinfo,
 	.on	= l1cacheson,
@@ -195,4 +246,7 @@ static Cacheimpl l1caches = {
 	.invse	= cachedinvse,
 	.wbse	= cachedwbse,
 	.wbinvse= cachedwbinvse,
+
+	.invsev	= l1cachesinvsev,
+	.wbsev	= l1cacheswbsev,
 };
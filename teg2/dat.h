@@ -379,6 +379,13 @@ enum {
 	Cawa	= 1 << 28,
 };
 
+/* a range of memory for batched cache maintenance */
+typedef struct Cachevec Cachevec;
+struct Cachevec {
+	void	*va;
+	int	len;
+};
+
 /* non-architectural L2 cache */
 typedef struct Cacheimpl Cacheimpl;
 struct Cacheimpl {
@@ -393,6 +400,10 @@ struct Cacheimpl {
 	void	(*invse)(void *, int);
 	void	(*wbse)(void *, int);
 	void	(*wbinvse)(void *, int);
+
+	/* many ranges for the price of one lock and sync */
+	void	(*invsev)(Cachevec *, int);
+	void	(*wbsev)(Cachevec *, int);
 };
 /* extern */ Cacheimpl *l2cache, *allcache, *nocache, *l1cache;
 
@@ -249,6 +249,7 @@ enum {					/* Ring sizes  (<= 1024) */
 	/* at 1Gb/s, it only takes 12 ms. to fill a 1024-buffer ring */
 	Nrd		= 1024,		/* Receive Ring */
 	Nrb		= 4096,
+	Ntxbatch	= 32,		/* packets flushed from cache at once */
 
 	Mtu		= ETHERMAXTU,
 	Mps		= ROUNDUP(ETHERMAXTU+4, 128),
@@ -584,8 +585,7 @@ rtl8169ifstat(Ether* edev, void* a, long n, ulong offset)
 	}
 
 	/* copy hw statistics into ctlr->dtcc */
-	dtcc = ctlr->dtcc;
-	allcache->invse(dtcc, sizeof *dtcc);
+	dtcc = ctlr->dtcc;			/* uncached */
 	ilock(&ctlr->reglock);
 	csr32w(ctlr, Dtccr+4, 0);
 	csr32w(ctlr, Dtccr, PCIWADDR(dtcc)|Cmd);	/* initiate dma? */
@@ -909,11 +909,12 @@ pktstosend(void* v)
 static void
 tproc(void* arg)
 {
-	int x, len;
+	int i, n, x, y, added;
 	Block *bp;
 	Ctlr *ctlr;
 	D *d;
 	Ether *edev;
+	Cachevec cv[Ntxbatch];
 
 	edev = arg;
 	ctlr = edev->ctlr;
@@ -954,43 +955,54 @@ tproc(void* arg)
 
 		if (ctlr->ntq > 0)
 			csr8w(ctlr, Tppoll, Npq); /* kick xmiter to keep it going */
-		/* copy as much of my output q as possible into output ring */
+		/*
+		 * copy as much of my output q as possible into output ring,
+		 * writing each batch back from the caches in one go
+		 * before handing its descriptors to the hardware.
+		 */
+		added = 0;
 		x = ctlr->tdt;
-		while(ctlr->ntq < (ctlr->ntd-1)){
-			if((bp = qget(edev->oq)) == nil)
+		for(;;){
+			n = 0;
+			y = x;
+			while(n < Ntxbatch && ctlr->ntq+n < ctlr->ntd-1){
+				if((bp = qget(edev->oq)) == nil)
+					break;
+				cv[n].va = bp->rp;
+				cv[n].len = BLEN(bp);
+				ctlr->tb[y] = bp;
+				y = NEXT(y, ctlr->ntd);
+				n++;
+			}
+			if(n == 0)
 				break;
 
-			/* make sure the whole packet is in ram */
-			len = BLEN(bp);
-			allcache->wbse(bp->rp, len);
+			/* make sure the whole batch is in ram */
+			allcache->wbsev(cv, n);
 
-			d = &ctlr->td[x];
-			assert(d);
-			assert(!(d->control & Own));
-			d->addrhi = 0;
-			d->addrlo = PCIWADDR(bp->rp);
-			ctlr->tb[x] = bp;
-			coherence();
-			d->control = (d->control & ~TxflMASK) |
-				Own | Fs | Ls | len;
-			coherence();
+			for(i = 0; i < n; i++){
+				d = &ctlr->td[x];
+				assert(d);
+				assert(!(d->control & Own));
+				d->addrhi = 0;
+				d->addrlo = PCIWADDR(cv[i].va);
+				coherence();
+				d->control = (d->control & ~TxflMASK) |
+					Own | Fs | Ls | cv[i].len;
 
-			if(Debug > 1)
-				iprint("T%d ", len);
+				if(Debug > 1)
+					iprint("T%d ", cv[i].len);
 
-			x = NEXT(x, ctlr->ntd);
-			ctlr->ntq++;
+				x = NEXT(x, ctlr->ntd);
+			}
+			ctlr->ntq += n;
+			added += n;
 
 			ctlr->tdt = x;
 			coherence();
 			csr8w(ctlr, Tppoll, Npq);	/* kick xmiter again */
 		}
-		if(x != ctlr->tdt){		/* added new packet(s)? */
-			ctlr->tdt = x;
-			coherence();
-			csr8w(ctlr, Tppoll, Npq);
-		}
-		else if(ctlr->ntq >= (ctlr->ntd-1))
+		if(added == 0 && ctlr->ntq >= (ctlr->ntd-1))
 			ctlr->txdu++;
 	}
 }
@@ -1230,13 +1242,13 @@ rtl8169attach(Ether* edev)
 	ctlr->rb = malloc(Nrd*sizeof(Block*));
 	ctlr->nrd = Nrd;
 
-	ctlr->dtcc = mallocalign(sizeof(Dtcc), 64, 0, 0);
+	ctlr->dtcc = ucallocalign(sizeof(Dtcc), 64, 0);
 	if(waserror()){
-		free(ctlr->td);
+		ucfree(ctlr->td);
 		free(ctlr->tb);
-		free(ctlr->rd);
+		ucfree(ctlr->rd);
 		free(ctlr->rb);
-		free(ctlr->dtcc);
+		ucfree(ctlr->dtcc);
 		nexterror();
 	}
 	if(ctlr->td == nil || ctlr->tb == nil || ctlr->rd == nil ||
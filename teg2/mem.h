@@ -87,7 +87,7 @@
 /*
  * Legacy...
  */
-#define BLOCKALIGN	CACHELINESZ		/* only used in allocb.c */
+#define BLOCKALIGN	CACHELINESZ		/* allocb.c and rbpool.c */
 #define KSTACK		KSTKSIZE
 
 /*
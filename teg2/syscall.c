@@ -211,6 +211,7 @@ syscall(Ureg* ureg)
 
 	scallnr = ureg->r0;
 	up->scallnr = scallnr;
+	statsyscall(scallnr);
 	if(scallnr == RFORK)
 		fpusysrfork(ureg);
 	spllo();